@@ -37,9 +37,18 @@ static struct
 static int adapter_device[E_DEVICE_TYPE_NB][MAX_CONTROLLERS];
 static int device_adapter[E_DEVICE_TYPE_NB][MAX_DEVICES];
 
+/*
+ * These bitmaps are indexed by controller id.
+ * The active controllers are the ones that are sent to a destination, plus the first one,
+ * which is always processed. The dirty controllers have a report to send (see send_command).
+ */
+static unsigned int active = 0x01;
+static unsigned int dirty = 0x00;
+
 void adapter_init()
 {
   unsigned int i, j;
+  dirty = 0x00;
   for(i=0; i<MAX_CONTROLLERS; ++i)
   {
     adapter[i].type = C_TYPE_DEFAULT;
@@ -50,6 +59,8 @@ void adapter_init()
       adapter[i].report[j].type = BYTE_IN_REPORT;
     }
     adapter[i].status = 0;
+    adapter[i].refresh_period = -1;
+    adapter[i].report_index = -1;
   }
   for(j=0; j<E_DEVICE_TYPE_NB; ++j)
   {
@@ -86,6 +97,79 @@ int adapter_set_port(unsigned char index, char* portname)
   return 0;
 }
 
+/*
+ * Tell if the controller is sent to a destination (serial port, bluetooth, network or GPP).
+ */
+int adapter_has_output(int id)
+{
+  return adapter[id].portname || adapter[id].bdaddr_dst || adapter[id].dst_ip || adapter[id].type == C_TYPE_GPP;
+}
+
+/*
+ * Update the active controllers, once the destinations are set up.
+ */
+void adapter_update_active()
+{
+  int i;
+  active = 0x01;
+  for(i=1; i<MAX_CONTROLLERS; ++i)
+  {
+    if(adapter_has_output(i))
+    {
+      active |= 1 << i;
+    }
+  }
+}
+
+unsigned int adapter_get_active()
+{
+  return active;
+}
+
+/*
+ * Mark a controller as having a report to send.
+ */
+void adapter_set_send_command(int id)
+{
+  adapter[id].send_command = 1;
+  dirty |= 1 << id;
+}
+
+void adapter_clear_send_command(int id)
+{
+  adapter[id].send_command = 0;
+  dirty &= ~(1 << id);
+}
+
+unsigned int adapter_get_dirty()
+{
+  return dirty;
+}
+
+/*
+ * Build the report of a controller.
+ * If the axes didn't change since the last build, the last report is reused,
+ * unless the report has to change at each build (e.g. it holds a counter).
+ *
+ * Returns the index of the report.
+ */
+unsigned int adapter_build_report(int id)
+{
+  s_adapter* a = adapter + id;
+
+  if(a->report_index >= 0
+      && !controller_has_stateful_report(a->type)
+      && !memcmp(a->report_axis, a->axis, sizeof(a->axis)))
+  {
+    return a->report_index;
+  }
+
+  a->report_index = report_build(a->type, a->axis, a->report);
+  memcpy(a->report_axis, a->axis, sizeof(a->axis));
+
+  return a->report_index;
+}
+
 inline s_adapter* adapter_get(unsigned char index)
 {
   if(index < MAX_CONTROLLERS)
@@ -166,7 +250,11 @@ int adapter_network_read(int id)
     }
     // store the report (no answer)
     memcpy(adapter[id].axis, buf+2, sizeof(adapter->axis));
-    adapter[id].send_command = 1;
+    adapter_set_send_command(id);
+    if(!adapter[id].input_timestamp)
+    {
+      adapter[id].input_timestamp = GE_GetTime();
+    }
     break;
   }
   // require a report to be sent immediately, except for a Sixaxis controller working over bluetooth
@@ -62,10 +62,40 @@ static void usage()
   printf("    \"select\", \"start\", \"PS\", \"l3\", \"r3\": {0, 255}\n");
   printf("    \"up\", \"right\", \"down\", \"left\", \"triangle\", \"circle\", \"cross\", \"square\", \"l1\", \"r1\", \"l2\", \"r2\": [0,255]\n");
   printf("  --refresh n: The refresh period, in ms. Forcing the refresh period is not recommended.\n");
+  printf("    A comma-separated list sets the refresh period of each controller, in the order of declaration. Ex: --refresh 4,10\n");
   printf("  --src IP:port: Specifies a source IP+port to listen on. Ex: 127.0.0.1:51914.\n");
   printf("    This argument has to be placed before the --bdaddr and --port arguments.\n");
   printf("  --btstack: use btstack for the bluetooth connection.\n");
   printf("    Btstack is the only available connection method on Windows, and an alternative connection method on Linux.\n");
+  printf("  --catch-up: Immediately process the periods that were missed because of a scheduling delay (default: skip them).\n");
+  printf("    At most %d missed periods are processed, the others are skipped.\n", MAX_CATCH_UP);
+  printf("  --realtime priority: Run all threads with the SCHED_FIFO policy at this priority (1-99),\n");
+  printf("    pre-fault the configuration and lock the memory. Each step is reported.\n");
+  printf("  --cpus list: Pin the main thread to these CPUs (with --realtime). Ex: --cpus 2 or --cpus 2-3\n");
+  printf("  --io-cpus list: Pin the I/O threads to these CPUs (with --realtime).\n");
+  printf("  --input-thread: Read the input devices from a dedicated thread. The main thread only processes them at each refresh.\n");
+  printf("  --io-uring: Wait for the inputs and write the reports to the serial adapters with io_uring (Linux only).\n");
+  printf("  --hotplug: Add the input devices that get connected while running (Linux only).\n");
+  printf("    A device that gets reconnected, or that is in the config file but is not connected yet, gets its bindings.\n");
+  printf("  --coalesce-axes: Only process the latest motion of each joystick axis at each refresh.\n");
+  printf("    The number of merged motions is reported for each joystick on exit.\n");
+  printf("  --recursive-filter: Update the mouse motion filter incrementally at each refresh,\n");
+  printf("    instead of summing the whole buffer (same output, constant cost whatever the buffer size).\n");
+  printf("  --response-tables: Compute the response curves of the mouse axes with precomputed tables,\n");
+  printf("    instead of calling pow() for each motion.\n");
+  printf("  --response-check: Debug option. Same as --response-tables, but also compute the exact response,\n");
+  printf("    and print the maximum difference on exit.\n");
+  printf("  --fixed-point: Process the mouse motions with integer arithmetic (16.16 fixed point) instead of floating point.\n");
+  printf("    The output is the same on all platforms. See the --compare option of gimx-bench for the differences.\n");
+  printf("  --no-event-filter: Debug option. Don't drop the key, button and joystick events\n");
+  printf("    that are not used by the configuration or by the macros.\n");
+  printf("  --late-sampling margin: Wake up this many ms before each period boundary of the refresh timer,\n");
+  printf("    read the pending inputs and send right away. The margin is then adjusted to the measured processing time,\n");
+  printf("    so that the reports are sent before the boundaries. This only shifts the phase of the refreshes:\n");
+  printf("    the timer is not synchronized with the adapter or the console, and the inputs are applied as soon as they arrive,\n");
+  printf("    so the delay between an input and its report doesn't change.\n");
+  printf("  --event-queue n: The number of events the queue of the generated events (macros, keygen) can hold (default: 256).\n");
+  printf("  --latency: Measure the delay between inputs and the reports they modify, and print statistics at exit.\n");
 }
 
 /*
@@ -107,6 +137,57 @@ static int read_ip(char* optarg, in_addr_t* ip, unsigned short* port)
   return ret;
 }
 
+/*
+ * Read a refresh period (in ms) or a comma-separated list of refresh periods.
+ * A single value applies to all controllers.
+ * Controllers that are not in the list use their default refresh period.
+ */
+static int args_read_refresh_periods(char* optarg)
+{
+  double period;
+  int pos;
+  int controller = 0;
+  char* cur = optarg;
+  int single = !strchr(optarg, ',');
+
+  while(*cur)
+  {
+    if(controller >= MAX_CONTROLLERS)
+    {
+      return -1;
+    }
+    if(sscanf(cur, "%lf%n", &period, &pos) != 1 || period <= 0)
+    {
+      return -1;
+    }
+    cur += pos;
+    if(*cur == ',')
+    {
+      ++cur;
+    }
+    else if(*cur)
+    {
+      return -1;
+    }
+    adapter_get(controller++)->refresh_period = period * 1000;
+  }
+
+  if(!controller)
+  {
+    return -1;
+  }
+
+  if(single)
+  {
+    for(controller = 1; controller < MAX_CONTROLLERS; ++controller)
+    {
+      adapter_get(controller)->refresh_period = adapter_get(0)->refresh_period;
+    }
+  }
+
+  return 0;
+}
+
 int args_read(int argc, char *argv[], s_gimx_params* params)
 {
   int ret = 0;
@@ -124,15 +205,31 @@ int args_read(int argc, char *argv[], s_gimx_params* params)
     {"curses",         no_argument, &params->curses,         1},
     {"window-events",  no_argument, &params->window_events,  1},
     {"btstack",        no_argument, &params->btstack,        1},
+    {"latency",        no_argument, &params->latency,        1},
+    {"catch-up",       no_argument, &params->catch_up,       1},
+    {"input-thread",   no_argument, &params->input_thread,   1},
+    {"io-uring",       no_argument, &params->io_uring,       1},
+    {"hotplug",        no_argument, &params->hotplug,        1},
+    {"coalesce-axes",  no_argument, &params->coalesce_axes,  1},
+    {"no-event-filter", no_argument, &params->no_event_filter, 1},
+    {"recursive-filter", no_argument, &params->recursive_filter, 1},
+    {"response-tables", no_argument, &params->response_tables, 1},
+    {"response-check", no_argument, &params->response_check, 1},
+    {"fixed-point",    no_argument, &params->fixed_point,    1},
     /* These options don't set a flag. We distinguish them by their indices. */
     {"bdaddr",  required_argument, 0, 'b'},
     {"config",  required_argument, 0, 'c'},
     {"dst",     required_argument, 0, 'd'},
     {"event",   required_argument, 0, 'e'},
+    {"event-queue", required_argument, 0, 'q'},
     {"hci",     required_argument, 0, 'h'},
     {"help",    no_argument,       0, 'm'},
+    {"cpus",    required_argument, 0, 'u'},
+    {"io-cpus", required_argument, 0, 'o'},
     {"keygen",  required_argument, 0, 'k'},
+    {"late-sampling", required_argument, 0, 'l'},
     {"port",    required_argument, 0, 'p'},
+    {"realtime", required_argument, 0, 'x'},
     {"refresh", required_argument, 0, 'r'},
     {"src",     required_argument, 0, 's'},
     {"type",    required_argument, 0, 't'},
@@ -145,7 +242,7 @@ int args_read(int argc, char *argv[], s_gimx_params* params)
     /* getopt_long stores the option index here. */
     int option_index = 0;
 
-    c = getopt_long (argc, argv, "b:c:d:e:h:k:p:r:s:t:vm", long_options, &option_index);
+    c = getopt_long (argc, argv, "b:c:d:e:h:k:l:o:p:q:r:s:t:u:x:vm", long_options, &option_index);
 
     /* Detect the end of the options. */
     if (c == -1)
@@ -252,6 +349,55 @@ int args_read(int argc, char *argv[], s_gimx_params* params)
         printf(_("option -k with value `%s'\n"), optarg);
         break;
 
+      case 'l':
+        params->late_sampling = atof(optarg) * 1000;
+        if(params->late_sampling > 0)
+        {
+          printf(_("option -l with value `%s'\n"), optarg);
+        }
+        else
+        {
+          fprintf(stderr, "Bad late sampling margin: %s\n", optarg);
+          ret = -1;
+        }
+        break;
+
+      case 'x':
+        params->realtime = atoi(optarg);
+        if(params->realtime >= 1 && params->realtime <= 99)
+        {
+          printf(_("option -x with value `%s'\n"), optarg);
+        }
+        else
+        {
+          fprintf(stderr, "Bad realtime priority: %s\n", optarg);
+          ret = -1;
+        }
+        break;
+
+      case 'q':
+        params->event_queue = atoi(optarg);
+        if(params->event_queue > 0)
+        {
+          printf(_("option -q with value `%s'\n"), optarg);
+        }
+        else
+        {
+          fprintf(stderr, "Bad event queue size: %s\n", optarg);
+          ret = -1;
+        }
+        break;
+
+      case 'u':
+        params->cpus = optarg;
+        printf(_("option -u with value `%s'\n"), optarg);
+        break;
+
+      case 'o':
+        params->io_cpus = optarg;
+        printf(_("option -o with value `%s'\n"), optarg);
+        break;
+
       case 'p':
         if(strstr(optarg, DEV_HIDRAW) || !strstr(optarg, DEV_SERIAL))
         {
@@ -270,13 +416,8 @@ int args_read(int argc, char *argv[], s_gimx_params* params)
         break;
 
       case 'r':
-        params->refresh_period = atof(optarg) * 1000;
-        if(params->refresh_period)
-        {
-          params->postpone_count = 3 * DEFAULT_REFRESH_PERIOD / params->refresh_period;
-          printf(_("option -r with value `%s'\n"), optarg);
-        }
-        else
+        printf(_("option -r with value `%s'\n"), optarg);
+        if(args_read_refresh_periods(optarg) < 0)
         {
           fprintf(stderr, "Bad refresh period: %s\n", optarg);
           ret = -1;
@@ -358,6 +499,28 @@ int args_read(int argc, char *argv[], s_gimx_params* params)
     printf(_("window_events flag is set\n"));
   if(params->btstack)
     printf(_("btstack flag is set\n"));
+  if(params->latency)
+    printf(_("latency flag is set\n"));
+  if(params->catch_up)
+    printf(_("catch_up flag is set\n"));
+  if(params->input_thread)
+    printf(_("input_thread flag is set\n"));
+  if(params->io_uring)
+    printf(_("io_uring flag is set\n"));
+  if(params->hotplug)
+    printf(_("hotplug flag is set\n"));
+  if(params->coalesce_axes)
+    printf(_("coalesce_axes flag is set\n"));
+  if(params->no_event_filter)
+    printf(_("no_event_filter flag is set\n"));
+  if(params->recursive_filter)
+    printf(_("recursive_filter flag is set\n"));
+  if(params->response_tables)
+    printf(_("response_tables flag is set\n"));
+  if(params->response_check)
+    printf(_("response_check flag is set\n"));
+  if(params->fixed_point)
+    printf(_("fixed_point flag is set\n"));
 
   if(!input)
   {
@@ -0,0 +1,687 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+/*
+ * This tool replays an event trace through the mapping pipeline of gimx,
+ * without input devices and without output (the reports are built but not sent).
+ * It measures the time spent in each stage:
+ * - process_event (per event, including the events generated by macros),
+ * - cfg_process_motion (per period),
+ * - macro_process (per period),
+ * - report_build (per built report, and per period).
+ *
+ * Trace format: one event per line, the time being in microseconds.
+ *   <time> motion <mouse> <xrel> <yrel>
+ *   <time> keydown|keyup <keyboard> <keysym>
+ *   <time> buttondown|buttonup <mouse> <button>
+ *   <time> axis <joystick> <axis> <value>
+ *   <time> jbuttondown|jbuttonup <joystick> <button>
+ *   <time> hat <joystick> <hat> <value>
+ * Mice and keyboards are merged (the configuration is read in single input mode).
+ * Joysticks have to be declared with the --joystick argument, in the order of their ids.
+ *
+ * Each controller of the --refresh list is refreshed at its own period, as in gimx:
+ * the main loop runs at the greatest common divisor of the periods.
+ *
+ * The axis positions of the first controller can be recorded at each of its refreshes (--record),
+ * and compared to a previous recording (--compare), e.g. to compare the floating point
+ * and the fixed point paths (--fixed-point) on the same trace:
+ *   gimx-bench --config c.xml --trace t.txt --record float.txt
+ *   gimx-bench --config c.xml --trace t.txt --fixed-point --compare float.txt
+ * The exit status is 1 if an axis position differs by more than the tolerance (see make bench-check).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <locale.h>
+#ifndef WIN32
+#include <pwd.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#include <shlobj.h>
+#endif
+#include <libxml/parser.h>
+#include <GE.h>
+#include <report.h>
+#include "gimx.h"
+#include "config.h"
+#include "config_reader.h"
+#include "calibration.h"
+#include "macros.h"
+#include <adapter.h>
+#include <scheduler.h>
+
+#define DEFAULT_DURATION 10 //seconds
+
+s_gimx_params gimx_params =
+{
+  .homedir = NULL,
+  .grab = 0,
+  .refresh_period = -1,
+  .frequency_scale = 1,
+  .postpone_count = 3,
+};
+
+typedef struct
+{
+  const char* name;
+  unsigned long long count; //events, periods or reports
+  unsigned long long time; //ns
+} s_stage;
+
+enum
+{
+  STAGE_PROCESS_EVENT,
+  STAGE_PROCESS_MOTION,
+  STAGE_MACRO_PROCESS,
+  STAGE_REPORT_BUILD,
+  STAGE_NB
+};
+
+static s_stage stages[STAGE_NB] =
+{
+  [STAGE_PROCESS_EVENT]  = { .name = "process_event" },
+  [STAGE_PROCESS_MOTION] = { .name = "cfg_process_motion" },
+  [STAGE_MACRO_PROCESS]  = { .name = "macro_process" },
+  [STAGE_REPORT_BUILD]   = { .name = "report_build" },
+};
+
+static struct
+{
+  GE_Event* events;
+  unsigned int nb;
+  unsigned int size;
+} trace = {};
+
+static struct
+{
+  FILE* record; //the axis positions, one line per period
+  FILE* compare; //the recorded axis positions to compare with
+  int tolerance; //the maximum difference that is not reported as an error
+  unsigned long long periods; //the compared periods
+  unsigned long long differences; //the different axis positions
+  unsigned long long errors; //the axis positions that differ by more than the tolerance
+  int max_difference;
+  int truncated; //the recording has less periods than the replay
+} axes = { .tolerance = 1 };
+
+static void usage()
+{
+  printf("Usage: gimx-bench [options]\n");
+  printf("  --config file: The configuration to load (in the gimx config directory).\n");
+  printf("  --homedir dir: The directory that contains the gimx directory (default: the user directory).\n");
+  printf("  --trace file: The event trace to replay.\n");
+  printf("  --generate mouse|keys|joystick: Write a synthetic trace to the standard output and exit.\n");
+  printf("    mouse: mouse motion at 1000Hz, keys: key storm, joystick: joystick axis sweeps.\n");
+  printf("  --duration n: The duration of the generated trace, in seconds (default: %d).\n", DEFAULT_DURATION);
+  printf("  --joystick name: Declare a joystick (can be repeated).\n");
+  printf("  --type controller: The controller type (default: DS4).\n");
+  printf("  --refresh n: The refresh period, in ms (default: the controller default).\n");
+  printf("    A comma-separated list sets the refresh period of each controller. Ex: --refresh 4,1\n");
+  printf("  --repeat n: Replay the trace n times (default: 1).\n");
+  printf("  --fixed-point: Process the mouse motions in fixed point (see gimx --fixed-point).\n");
+  printf("  --record file: Record the axis positions of the first controller at each of its refreshes.\n");
+  printf("  --compare file: Compare the axis positions of the first controller to a recording.\n");
+  printf("  --tolerance n: The maximum difference of the compared axis positions (default: %d).\n", axes.tolerance);
+}
+
+static int trace_add(GE_Event* event)
+{
+  if(trace.nb == trace.size)
+  {
+    unsigned int size = trace.size ? trace.size * 2 : 1024;
+    void* ptr = realloc(trace.events, size * sizeof(*trace.events));
+    if(!ptr)
+    {
+      fprintf(stderr, "can't allocate the trace\n");
+      return -1;
+    }
+    trace.events = ptr;
+    trace.size = size;
+  }
+  trace.events[trace.nb++] = *event;
+  return 0;
+}
+
+static int trace_read(const char* file)
+{
+  char line[256];
+  char type[16];
+  unsigned long long time;
+  int which, a, b;
+  int nb;
+  unsigned int lineno = 0;
+
+  FILE* fp = fopen(file, "r");
+  if(!fp)
+  {
+    fprintf(stderr, "can't open %s\n", file);
+    return -1;
+  }
+
+  while(fgets(line, sizeof(line), fp))
+  {
+    ++lineno;
+
+    if(line[0] == '#' || line[0] == '\n')
+    {
+      continue;
+    }
+
+    b = 0;
+    nb = sscanf(line, "%llu %15s %d %d %d", &time, type, &which, &a, &b);
+
+    GE_Event event = { .timestamp = time * 1000 };
+
+    if(nb >= 5 && !strcmp(type, "motion"))
+    {
+      event.motion.type = GE_MOUSEMOTION;
+      event.motion.which = which;
+      event.motion.xrel = a;
+      event.motion.yrel = b;
+    }
+    else if(nb >= 4 && (!strcmp(type, "keydown") || !strcmp(type, "keyup")))
+    {
+      event.key.type = !strcmp(type, "keydown") ? GE_KEYDOWN : GE_KEYUP;
+      event.key.which = which;
+      event.key.keysym = a;
+    }
+    else if(nb >= 4 && (!strcmp(type, "buttondown") || !strcmp(type, "buttonup")))
+    {
+      event.button.type = !strcmp(type, "buttondown") ? GE_MOUSEBUTTONDOWN : GE_MOUSEBUTTONUP;
+      event.button.which = which;
+      event.button.button = a;
+    }
+    else if(nb >= 5 && !strcmp(type, "axis"))
+    {
+      event.jaxis.type = GE_JOYAXISMOTION;
+      event.jaxis.which = which;
+      event.jaxis.axis = a;
+      event.jaxis.value = b;
+    }
+    else if(nb >= 4 && (!strcmp(type, "jbuttondown") || !strcmp(type, "jbuttonup")))
+    {
+      event.jbutton.type = !strcmp(type, "jbuttondown") ? GE_JOYBUTTONDOWN : GE_JOYBUTTONUP;
+      event.jbutton.which = which;
+      event.jbutton.button = a;
+    }
+    else if(nb >= 5 && !strcmp(type, "hat"))
+    {
+      event.jhat.type = GE_JOYHATMOTION;
+      event.jhat.which = which;
+      event.jhat.hat = a;
+      event.jhat.value = b;
+    }
+    else
+    {
+      fprintf(stderr, "%s:%u: bad event\n", file, lineno);
+      fclose(fp);
+      return -1;
+    }
+
+    if(trace_add(&event) < 0)
+    {
+      fclose(fp);
+      return -1;
+    }
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+/*
+ * Generate a synthetic trace, with one event batch per millisecond.
+ */
+static int trace_generate(const char* scenario, unsigned int duration)
+{
+  unsigned int t;
+  unsigned int ms = duration * 1000;
+
+  if(!strcmp(scenario, "mouse"))
+  {
+    for(t = 0; t < ms; ++t)
+    {
+      double angle = 2 * M_PI * t / 1000;
+      printf("%u motion 0 %d %d\n", t * 1000, (int)lround(10 * cos(angle)), (int)lround(10 * sin(angle)));
+    }
+  }
+  else if(!strcmp(scenario, "keys"))
+  {
+    /*
+     * Each millisecond, a key is pressed and the key pressed 8ms ago is released.
+     */
+    for(t = 0; t < ms; ++t)
+    {
+      printf("%u keydown 0 %u\n", t * 1000, 1 + t % 128);
+      if(t >= 8)
+      {
+        printf("%u keyup 0 %u\n", t * 1000, 1 + (t - 8) % 128);
+      }
+    }
+  }
+  else if(!strcmp(scenario, "joystick"))
+  {
+    /*
+     * Four axes sweep the full range in opposite directions, and a button toggles every 50ms.
+     */
+    for(t = 0; t < ms; ++t)
+    {
+      int value = (int)(t % 500) * 131 - 32767;
+      if((t / 500) % 2)
+      {
+        value = -value;
+      }
+      printf("%u axis 0 0 %d\n", t * 1000, value);
+      printf("%u axis 0 1 %d\n", t * 1000, -value);
+      printf("%u axis 0 2 %d\n", t * 1000, value / 2);
+      printf("%u axis 0 3 %d\n", t * 1000, -value / 2);
+      if(!(t % 50))
+      {
+        printf("%u %s 0 0\n", t * 1000, (t / 50) % 2 ? "jbuttonup" : "jbuttondown");
+      }
+    }
+  }
+  else
+  {
+    fprintf(stderr, "unknown scenario: %s\n", scenario);
+    return -1;
+  }
+  return 0;
+}
+
+static inline void stage_add(int stage, uint64_t start, unsigned long long count)
+{
+  stages[stage].time += GE_GetTime() - start;
+  stages[stage].count += count;
+}
+
+/*
+ * Read the refresh period (in ms) of each controller.
+ * The controllers after the first one are given a dummy port, so that the scheduler refreshes them.
+ */
+static int read_refresh_periods(char* arg)
+{
+  double period;
+  int pos;
+  int controller = 0;
+
+  while(*arg)
+  {
+    if(controller >= MAX_CONTROLLERS || sscanf(arg, "%lf%n", &period, &pos) != 1 || period <= 0)
+    {
+      return -1;
+    }
+    arg += pos;
+    if(*arg == ',')
+    {
+      ++arg;
+    }
+    else if(*arg)
+    {
+      return -1;
+    }
+    if(controller)
+    {
+      adapter_get(controller)->portname = "bench";
+    }
+    adapter_get(controller++)->refresh_period = period * 1000;
+  }
+
+  return controller ? 0 : -1;
+}
+
+/*
+ * This replaces connector_send: the reports are built for each controller that has changed
+ * and that is due, but nothing is sent.
+ */
+static void null_connector_send()
+{
+  int i;
+  unsigned int pending = adapter_get_dirty();
+  uint64_t start;
+
+  while(pending)
+  {
+    i = __builtin_ctz(pending);
+    pending &= pending - 1;
+
+    if (!scheduler_is_due(i))
+    {
+      continue;
+    }
+
+    start = GE_GetTime();
+    adapter_build_report(i);
+    stage_add(STAGE_REPORT_BUILD, start, 1);
+    adapter_clear_send_command(i);
+  }
+}
+
+/*
+ * Record the axis positions of the first controller when it is refreshed, and/or compare them to the recording.
+ */
+static void axes_process()
+{
+  int* axis = adapter_get(0)->axis;
+  int i, value, difference;
+
+  if(!scheduler_is_due(0))
+  {
+    return;
+  }
+
+  if(axes.record)
+  {
+    for(i = 0; i < AXIS_MAX; ++i)
+    {
+      fprintf(axes.record, i ? " %d" : "%d", axis[i]);
+    }
+    fputc('\n', axes.record);
+  }
+
+  if(axes.compare && !axes.truncated)
+  {
+    for(i = 0; i < AXIS_MAX; ++i)
+    {
+      if(fscanf(axes.compare, "%d", &value) != 1)
+      {
+        axes.truncated = 1;
+        return;
+      }
+      difference = abs(axis[i] - value);
+      if(difference)
+      {
+        ++axes.differences;
+        if(difference > axes.tolerance)
+        {
+          ++axes.errors;
+        }
+        if(difference > axes.max_difference)
+        {
+          axes.max_difference = difference;
+        }
+      }
+    }
+    ++axes.periods;
+  }
+}
+
+static unsigned long long replay()
+{
+  GE_Event events[EVENT_BUFFER_SIZE];
+  GE_Event* event;
+  int num_evt;
+  unsigned int i = 0;
+  unsigned long long ticks = 0;
+  uint64_t start;
+  uint64_t period = (uint64_t)gimx_params.refresh_period * 1000;
+  uint64_t deadline = trace.nb ? trace.events[0].timestamp + period : 0;
+
+  scheduler_start();
+
+  while(i < trace.nb)
+  {
+    unsigned int first = i;
+
+    start = GE_GetTime();
+    while(i < trace.nb && trace.events[i].timestamp < deadline)
+    {
+      process_event(trace.events + i);
+      ++i;
+    }
+    stage_add(STAGE_PROCESS_EVENT, start, i - first);
+
+    scheduler_tick();
+
+    start = GE_GetTime();
+    cfg_process_motion();
+    stage_add(STAGE_PROCESS_MOTION, start, 1);
+
+    cfg_config_activation();
+
+    axes_process();
+
+    null_connector_send();
+
+    cfg_process_rumble();
+
+    start = GE_GetTime();
+    macro_process();
+    stage_add(STAGE_MACRO_PROCESS, start, 1);
+
+    num_evt = GE_PeepEvents(events, sizeof(events) / sizeof(events[0]));
+
+    start = GE_GetTime();
+    for (event = events; event < events + num_evt; ++event)
+    {
+      process_event(event);
+    }
+    stage_add(STAGE_PROCESS_EVENT, start, num_evt);
+
+    deadline += period;
+    ++ticks;
+  }
+
+  return ticks;
+}
+
+static void print_results(unsigned long long ticks)
+{
+  int i;
+
+  printf("%-20s %12s %12s %12s\n", "stage", "count", "ns/count", "ns/period");
+  for(i = 0; i < STAGE_NB; ++i)
+  {
+    printf("%-20s %12llu %12.1f %12.1f\n", stages[i].name, stages[i].count,
+        stages[i].count ? (double)stages[i].time / stages[i].count : 0,
+        ticks ? (double)stages[i].time / ticks : 0);
+  }
+  printf("periods: %llu, events: %u\n", ticks, trace.nb);
+  if(axes.compare)
+  {
+    printf("compared periods: %llu, different axis positions: %llu, above tolerance: %llu, max difference: %d\n",
+        axes.periods, axes.differences, axes.errors, axes.max_difference);
+    if(axes.truncated)
+    {
+      printf("the recording is shorter than the replay\n");
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  char* config = NULL;
+  char* trace_file = NULL;
+  char* scenario = NULL;
+  unsigned int duration = DEFAULT_DURATION;
+  unsigned int repeat = 1;
+  unsigned long long ticks = 0;
+  e_controller_type type = C_TYPE_DS4;
+  int ret = -1;
+  int c;
+
+  setlocale( LC_NUMERIC, "C" );
+
+#ifndef WIN32
+  gimx_params.homedir = getpwuid(getuid())->pw_dir;
+#else
+  static char path[MAX_PATH];
+  if(SHGetFolderPath( NULL, CSIDL_APPDATA , NULL, 0, path ))
+  {
+    fprintf(stderr, "Can't get the user directory.\n");
+    return -1;
+  }
+  gimx_params.homedir = path;
+#endif
+
+  adapter_init();
+
+  struct option long_options[] =
+  {
+    {"config",   required_argument, 0, 'c'},
+    {"compare",  required_argument, 0, 'a'},
+    {"duration", required_argument, 0, 'd'},
+    {"fixed-point", no_argument,    0, 'x'},
+    {"generate", required_argument, 0, 'g'},
+    {"help",     no_argument,       0, 'h'},
+    {"homedir",  required_argument, 0, 'u'},
+    {"joystick", required_argument, 0, 'j'},
+    {"repeat",   required_argument, 0, 'n'},
+    {"record",   required_argument, 0, 'o'},
+    {"refresh",  required_argument, 0, 'r'},
+    {"tolerance", required_argument, 0, 'e'},
+    {"trace",    required_argument, 0, 'f'},
+    {"type",     required_argument, 0, 't'},
+    {0, 0, 0, 0}
+  };
+
+  while((c = getopt_long(argc, argv, "a:c:d:e:g:hj:n:o:r:f:t:u:x", long_options, NULL)) != -1)
+  {
+    switch(c)
+    {
+      case 'a':
+        axes.compare = fopen(optarg, "r");
+        if(!axes.compare)
+        {
+          fprintf(stderr, "can't open %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'c':
+        config = optarg;
+        break;
+      case 'd':
+        duration = atoi(optarg);
+        break;
+      case 'e':
+        axes.tolerance = atoi(optarg);
+        break;
+      case 'g':
+        scenario = optarg;
+        break;
+      case 'j':
+        GE_RegisterJoystick(optarg, NULL);
+        break;
+      case 'n':
+        repeat = atoi(optarg);
+        break;
+      case 'o':
+        axes.record = fopen(optarg, "w");
+        if(!axes.record)
+        {
+          fprintf(stderr, "can't open %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'r':
+        if(read_refresh_periods(optarg) < 0)
+        {
+          fprintf(stderr, "bad refresh period: %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'f':
+        trace_file = optarg;
+        break;
+      case 't':
+        type = controller_get_type(optarg);
+        break;
+      case 'u':
+        gimx_params.homedir = optarg;
+        break;
+      case 'x':
+        gimx_params.fixed_point = 1;
+        break;
+      default:
+        usage();
+        return -1;
+    }
+  }
+
+  if(scenario)
+  {
+    return trace_generate(scenario, duration);
+  }
+
+  if(!config || !trace_file)
+  {
+    usage();
+    return -1;
+  }
+
+  adapter_get(0)->type = type;
+
+  gimx_params.refresh_period = scheduler_set_periods();
+  if(gimx_params.refresh_period < 0)
+  {
+    return -1;
+  }
+  gimx_params.postpone_count = 3 * DEFAULT_REFRESH_PERIOD / gimx_params.refresh_period;
+  gimx_params.frequency_scale = (double) DEFAULT_REFRESH_PERIOD / gimx_params.refresh_period;
+
+  if(trace_read(trace_file) < 0)
+  {
+    return -1;
+  }
+
+  if (!GE_initialize(GE_MKB_SOURCE_NONE))
+  {
+    fprintf(stderr, "GE_initialize failed\n");
+    goto QUIT;
+  }
+
+  GE_SetMKMode(GE_MK_MODE_SINGLE_INPUT);
+
+  cal_init();
+
+  cfg_intensity_init();
+
+  if(read_config_file(config) < 0)
+  {
+    fprintf(stderr, "read_config_file failed\n");
+    goto QUIT;
+  }
+
+  cfg_read_calibration();
+
+  macros_init();
+
+  cfg_trigger_init();
+
+  while(repeat--)
+  {
+    ticks += replay();
+  }
+
+  print_results(ticks);
+
+  ret = (axes.errors || axes.truncated) ? 1 : 0;
+
+  QUIT:
+
+  macros_clean();
+  cfg_clean();
+  GE_quit();
+  free(trace.events);
+  if(axes.record)
+  {
+    fclose(axes.record);
+  }
+  if(axes.compare)
+  {
+    fclose(axes.compare);
+  }
+
+  xmlCleanupParser();
+
+  return ret;
+}
@@ -67,6 +67,7 @@ inline s_mouse_cal* cal_get_mouse(int mouse, int conf)
 inline void cal_set_mouse(s_config_entry* entry)
 {
   mouse_cal[entry->device.id][entry->config_id].options = entry->params.mouse_options;
+  mouse_cal[entry->device.id][entry->config_id].options.fixed_filter = lround(entry->params.mouse_options.filter * 65536);
 }
 
 static double distance = 0.1; //0.1 inches
@@ -278,6 +279,11 @@ void cal_key(int device_id, int sym, int down)
   s_mouse_control* mc = cfg_get_mouse_control(current_mouse);
   e_current_cal prev = current_cal;
 
+  if(!mc)
+  {
+    return;
+  }
+
   switch (sym)
   {
     case GE_KEY_LEFTCTRL:
@@ -378,9 +384,7 @@ void cal_key(int device_id, int sym, int down)
       {
         gprintf(_("calibrating dead zone x\n"));
         current_cal = DZX;
-        mc->merge_x[mc->index] = 1;
-        mc->merge_y[mc->index] = 0;
-        mc->change = 1;
+        cfg_set_mouse_motion(mc, 1, 0);
       }
       break;
     case GE_KEY_F4:
@@ -388,9 +392,7 @@ void cal_key(int device_id, int sym, int down)
       {
         gprintf(_("calibrating dead zone y\n"));
         current_cal = DZY;
-        mc->merge_x[mc->index] = 0;
-        mc->merge_y[mc->index] = 1;
-        mc->change = 1;
+        cfg_set_mouse_motion(mc, 0, 1);
       }
       break;
     case GE_KEY_F5:
@@ -398,9 +400,7 @@ void cal_key(int device_id, int sym, int down)
       {
         gprintf(_("calibrating dead zone shape\n"));
         current_cal = DZS;
-        mc->merge_x[mc->index] = 1;
-        mc->merge_y[mc->index] = 1;
-        mc->change = 1;
+        cfg_set_mouse_motion(mc, 1, 1);
       }
       break;
     case GE_KEY_F7:
@@ -500,6 +500,11 @@ void cal_button(int which, int button)
   s_mouse_control* mc = cfg_get_mouse_control(current_mouse);
   s_mouse_cal* mcal = cal_get_mouse(current_mouse, current_conf);
 
+  if(!mc)
+  {
+    return;
+  }
+
   switch (button)
   {
     case GE_BTN_WHEELUP:
@@ -543,9 +548,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzx = controller_get_mean_unsigned(adapter_get(cal_get_controller(current_mouse))->type, rel_axis_rstick_x) / controller_get_axis_scale(adapter_get(cal_get_controller(current_mouse))->type, rel_axis_rstick_x);
             }
-            mc->merge_x[mc->index] = 1;
-            mc->merge_y[mc->index] = 0;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, 1, 0);
           }
           break;
         case DZY:
@@ -556,9 +559,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzy = controller_get_mean_unsigned(adapter_get(cal_get_controller(current_mouse))->type, rel_axis_rstick_x) / controller_get_axis_scale(adapter_get(cal_get_controller(current_mouse))->type, rel_axis_rstick_x);
             }
-            mc->merge_x[mc->index] = 0;
-            mc->merge_y[mc->index] = 1;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, 0, 1);
           }
           break;
         case DZS:
@@ -572,9 +573,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzs = E_SHAPE_CIRCLE;
             }
-            mc->merge_x[mc->index] = 1;
-            mc->merge_y[mc->index] = 1;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, 1, 1);
           }
           break;
         case RD:
@@ -652,9 +651,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzx = 0;
             }
-            mc->merge_x[mc->index] = -1;
-            mc->merge_y[mc->index] = 0;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, -1, 0);
           }
           break;
         case DZY:
@@ -665,9 +662,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzy = 0;
             }
-            mc->merge_x[mc->index] = 0;
-            mc->merge_y[mc->index] = -1;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, 0, -1);
           }
           break;
         case DZS:
@@ -681,9 +676,7 @@ void cal_button(int which, int button)
             {
               *mcal->dzs = E_SHAPE_CIRCLE;
             }
-            mc->merge_x[mc->index] = -1;
-            mc->merge_y[mc->index] = -1;
-            mc->change = 1;
+            cfg_set_mouse_motion(mc, -1, -1);
           }
           break;
         case RD:
@@ -704,12 +697,20 @@ void cal_button(int which, int button)
           if (mcal->ex)
           {
             *mcal->ex -= EXPONENT_STEP;
+            if(*mcal->ex < EXPONENT_STEP)
+            {
+              *mcal->ex = EXPONENT_STEP;
+            }
           }
           break;
         case EY:
           if (mcal->ey)
           {
             *mcal->ey -= EXPONENT_STEP;
+            if(*mcal->ey < EXPONENT_STEP)
+            {
+              *mcal->ey = EXPONENT_STEP;
+            }
           }
           break;
         case TEST:
@@ -735,6 +736,27 @@ void cal_button(int which, int button)
   }
 }
 
+/*
+ * Allow the keys and the mouse buttons that are used for calibrating, for all devices.
+ */
+void cal_filter_events()
+{
+  int keys[] =
+  {
+    GE_KEY_LEFTCTRL, GE_KEY_RIGHTCTRL, GE_KEY_LEFTSHIFT, GE_KEY_RIGHTSHIFT, GE_KEY_LEFTALT, GE_KEY_RIGHTALT,
+    GE_KEY_ESC, GE_KEY_F1, GE_KEY_F2, GE_KEY_F3, GE_KEY_F4, GE_KEY_F5, GE_KEY_F6,
+    GE_KEY_F7, GE_KEY_F8, GE_KEY_F9, GE_KEY_F10, GE_KEY_F11, GE_KEY_F12
+  };
+  unsigned int i;
+
+  for(i = 0; i < sizeof(keys) / sizeof(*keys); ++i)
+  {
+    GE_AllowEvent(GE_KEYDOWN, -1, keys[i]);
+  }
+  GE_AllowEvent(GE_MOUSEBUTTONDOWN, -1, GE_BTN_WHEELUP);
+  GE_AllowEvent(GE_MOUSEBUTTONDOWN, -1, GE_BTN_WHEELDOWN);
+}
+
 /*
  * If calibration is on, all mouse wheel events are skipped.
  */
@@ -16,6 +16,7 @@
 #include "gimx.h"
 #include "macros.h"
 #include <adapter.h>
+#include <scheduler.h>
 
 #define DEFAULT_RADIUS 512
 #define DEFAULT_VELOCITY 1
@@ -58,52 +59,187 @@ static struct
  */
 static s_intensity axis_intensity[MAX_CONTROLLERS][MAX_CONFIGURATIONS][AXIS_MAX];
 
+typedef enum
+{
+  E_MAPPER_KEYBOARD_BUTTONS,
+  E_MAPPER_MOUSE_BUTTONS,
+  E_MAPPER_MOUSE_AXES,
+  E_MAPPER_JOYSTICK_BUTTONS,
+  E_MAPPER_JOYSTICK_AXES,
+  E_MAPPER_NB
+} e_mapper_kind;
+
+/*
+ * The controls of each controller configuration for a device.
+ */
+typedef struct
+{
+  s_mapper_table tables[MAX_CONTROLLERS][MAX_CONFIGURATIONS];
+} s_device_mappers;
+
+/*
+ * A list of device ids, in increasing order.
+ */
+typedef struct
+{
+  unsigned int nb;
+  unsigned char ids[MAX_DEVICES];
+} s_device_list;
+
+/*
+ * This lists controls of each controller configuration for all keyboards, mice, and joysticks.
+ * The tables of a device are only allocated if the configuration has bindings for this device.
+ */
+static struct
+{
+  s_device_mappers* devices[MAX_DEVICES];
+  s_device_list list;
+} mappers[E_MAPPER_NB] = {};
+
+/*
+ * Returned for the devices that have no binding. It must not be modified.
+ */
+static s_mapper_table empty_table = {};
+
+/*
+ * Used to tweak mouse controls. They are allocated when the configuration is loaded,
+ * for the mice it references. The events of the other mice are ignored.
+ */
+static s_mouse_control* mouse_control[MAX_DEVICES] = {};
+/*
+ * The motion of a mouse is processed when this controller gets refreshed, so that no motion is lost
+ * between two refreshes. It is the controller with the longest refresh period the mouse is bound to.
+ */
+static int motion_controller[MAX_DEVICES] = {};
+static s_device_list mouse_list = {};
+
 /*
- * This lists controls of each controller configuration for all keyboards.
+ * The mice that have to be processed each period: the ones that moved,
+ * until their motion buffer is empty.
  */
-static s_mapper_table keyboard_buttons[MAX_DEVICES][MAX_CONTROLLERS][MAX_CONFIGURATIONS];
+static s_device_list active_mice = {};
+
+static void add_device(s_device_list* list, int device)
+{
+  unsigned int i = list->nb;
+
+  while(i > 0 && list->ids[i - 1] > device)
+  {
+    list->ids[i] = list->ids[i - 1];
+    --i;
+  }
+  list->ids[i] = device;
+  ++list->nb;
+}
+
+static inline s_mapper_table* get_table(e_mapper_kind kind, int device, int controller, int config)
+{
+  s_device_mappers* dm = mappers[kind].devices[device];
+
+  return dm ? &dm->tables[controller][config] : &empty_table;
+}
 
 /*
- * This lists controls of each controller configuration for all mice.
+ * Get a table that is going to be modified: the tables of the device are allocated if needed.
  */
-static s_mapper_table mouse_buttons[MAX_DEVICES][MAX_CONTROLLERS][MAX_CONFIGURATIONS];
+static s_mapper_table* alloc_table(e_mapper_kind kind, int device, int controller, int config)
+{
+  s_device_mappers** dm = &mappers[kind].devices[device];
+
+  if(!*dm)
+  {
+    *dm = calloc(1, sizeof(**dm));
+    if(!*dm)
+    {
+      fprintf(stderr, "%s:%d calloc failed\n", __FILE__, __LINE__);
+      return NULL;
+    }
+    add_device(&mappers[kind].list, device);
+  }
 
-static s_mapper_table mouse_axes[MAX_DEVICES][MAX_CONTROLLERS][MAX_CONFIGURATIONS];
+  return &(*dm)->tables[controller][config];
+}
 
 /*
- * Used to tweak mouse controls.
+ * Get the controls of a mouse, allocating them if needed.
+ * This is only done when loading the configuration, not when processing the events.
  */
-static s_mouse_control mouse_control[MAX_DEVICES] = {};
+static s_mouse_control* alloc_mouse_control(int id)
+{
+  if(id < 0 || id >= MAX_DEVICES)
+  {
+    return NULL;
+  }
+  if(!mouse_control[id])
+  {
+    mouse_control[id] = calloc(1, sizeof(*mouse_control[id]));
+    if(!mouse_control[id])
+    {
+      fprintf(stderr, "%s:%d calloc failed\n", __FILE__, __LINE__);
+      return NULL;
+    }
+    if(gimx_params.fixed_point)
+    {
+      mouse_control[id]->fixed = calloc(1, sizeof(*mouse_control[id]->fixed));
+      if(!mouse_control[id]->fixed)
+      {
+        fprintf(stderr, "%s:%d calloc failed\n", __FILE__, __LINE__);
+        free(mouse_control[id]);
+        mouse_control[id] = NULL;
+        return NULL;
+      }
+    }
+    add_device(&mouse_list, id);
+  }
+  return mouse_control[id];
+}
 
 /*
- * This lists controls of each controller configuration for all joysticks.
+ * Get the controls of a mouse, or NULL if the configuration doesn't reference it.
  */
-static s_mapper_table joystick_buttons[MAX_DEVICES][MAX_CONTROLLERS][MAX_CONFIGURATIONS];
-static s_mapper_table joystick_axes[MAX_DEVICES][MAX_CONTROLLERS][MAX_CONFIGURATIONS];
+static inline s_mouse_control* get_mouse_control(int id)
+{
+  if(id < 0 || id >= MAX_DEVICES)
+  {
+    return NULL;
+  }
+  return mouse_control[id];
+}
+
+static void activate_mouse(int id, s_mouse_control* mc)
+{
+  mc->idle = 0;
+  if(!mc->active)
+  {
+    mc->active = 1;
+    mc->filter.size = 0; //recompute the sums of the recursive filter
+    add_device(&active_mice, id);
+  }
+}
 
 inline s_mapper_table* cfg_get_joystick_axes(int device, int controller, int config)
 {
-  return &(joystick_axes[device][controller][config]);
+  return get_table(E_MAPPER_JOYSTICK_AXES, device, controller, config);
 }
 
 inline s_mapper_table* cfg_get_joystick_buttons(int device, int controller, int config)
 {
-  return &(joystick_buttons[device][controller][config]);
+  return get_table(E_MAPPER_JOYSTICK_BUTTONS, device, controller, config);
 }
 
 inline s_mapper_table* cfg_get_mouse_axes(int device, int controller, int config)
 {
-  return &(mouse_axes[device][controller][config]);
+  return get_table(E_MAPPER_MOUSE_AXES, device, controller, config);
 }
 
 inline s_mapper_table* cfg_get_mouse_buttons(int device, int controller, int config)
 {
-  return &(mouse_buttons[device][controller][config]);
+  return get_table(E_MAPPER_MOUSE_BUTTONS, device, controller, config);
 }
 
 inline s_mapper_table* cfg_get_keyboard_buttons(int device, int controller, int config)
 {
-  return &(keyboard_buttons[device][controller][config]);
+  return get_table(E_MAPPER_KEYBOARD_BUTTONS, device, controller, config);
 }
 
 inline void cfg_set_trigger(s_config_entry* entry)
@@ -113,6 +249,10 @@ inline void cfg_set_trigger(s_config_entry* entry)
   cfg_controllers[entry->controller_id].profiles[entry->config_id].trigger.event.device_type = entry->device.type;
   cfg_controllers[entry->controller_id].profiles[entry->config_id].trigger.switch_back = entry->params.trigger.switch_back;
   cfg_controllers[entry->controller_id].profiles[entry->config_id].trigger.delay = entry->params.trigger.delay;
+  if(entry->device.type == E_DEVICE_TYPE_MOUSE)
+  {
+    alloc_mouse_control(entry->device.id);
+  }
 }
 
 inline void cfg_set_controller_dpi(int controller, unsigned int dpi)
@@ -120,6 +260,31 @@ inline void cfg_set_controller_dpi(int controller, unsigned int dpi)
   controller_dpi[controller] = dpi;
 }
 
+/*
+ * Set the resolution of a mouse, if it differs from the one the configuration was made for
+ * (the dpi of the controller). The motion of the mouse is then scaled to the resolution of the configuration.
+ */
+void cfg_set_mouse_dpi(int mouse, int controller, unsigned int dpi)
+{
+  s_mouse_control* mc;
+
+  if(!dpi || !controller_dpi[controller])
+  {
+    printf("mouse dpi ignored: the dpi of controller %d is not set\n", controller + 1);
+    return;
+  }
+
+  mc = alloc_mouse_control(mouse);
+  if(!mc)
+  {
+    return;
+  }
+
+  mc->scale = dpi == controller_dpi[controller] ? 0 : ((uint64_t) controller_dpi[controller] << 16) / dpi;
+  mc->scale_residue_x = 0;
+  mc->scale_residue_y = 0;
+}
+
 inline s_intensity* cfg_get_axis_intensity(int controller, int config, int axis)
 {
   return &(axis_intensity[controller][config][axis]);
@@ -128,6 +293,15 @@ inline s_intensity* cfg_get_axis_intensity(int controller, int config, int axis)
 inline void cfg_set_axis_intensity(s_config_entry* entry, int axis, s_intensity* intensity)
 {
   axis_intensity[entry->controller_id][entry->config_id][axis] = *intensity;
+  axis_intensity[entry->controller_id][entry->config_id][axis].fixed_value = llround(intensity->value * 65536);
+  if(intensity->device_up_type == E_DEVICE_TYPE_MOUSE)
+  {
+    alloc_mouse_control(intensity->device_up_id);
+  }
+  if(intensity->device_down_type == E_DEVICE_TYPE_MOUSE)
+  {
+    alloc_mouse_control(intensity->device_down_id);
+  }
 }
 
 void cfg_intensity_init()
@@ -147,6 +321,7 @@ void cfg_intensity_init()
         intensity->down_button = -1;
         intensity->max_value = controller_get_max_signed(adapter_get(i)->type, k);
         intensity->value = intensity->max_value;
+        intensity->fixed_value = llround(intensity->value * 65536);
         intensity->shape = E_SHAPE_RECTANGLE;
       }
     }
@@ -155,25 +330,25 @@ void cfg_intensity_init()
 
 static s_mapper_table* get_mapper_table(s_config_entry* entry)
 {
-  s_mapper_table* table = NULL;
+  int kind = -1;
 
-  if(entry->device.id < 0) return NULL;
+  if(entry->device.id < 0 || entry->device.id >= MAX_DEVICES) return NULL;
 
   switch(entry->device.type)
   {
     case E_DEVICE_TYPE_KEYBOARD:
-      table = cfg_get_keyboard_buttons(entry->device.id, entry->controller_id, entry->config_id);
+      kind = E_MAPPER_KEYBOARD_BUTTONS;
       break;
     case E_DEVICE_TYPE_MOUSE:
       switch(entry->event.type)
       {
         case E_EVENT_TYPE_BUTTON:
-          table = cfg_get_mouse_buttons(entry->device.id, entry->controller_id, entry->config_id);
+          kind = E_MAPPER_MOUSE_BUTTONS;
           break;
         case E_EVENT_TYPE_AXIS:
         case E_EVENT_TYPE_AXIS_UP:
         case E_EVENT_TYPE_AXIS_DOWN:
-          table = cfg_get_mouse_axes(entry->device.id, entry->controller_id, entry->config_id);
+          kind = E_MAPPER_MOUSE_AXES;
           break;
         default:
           break;
@@ -183,12 +358,12 @@ static s_mapper_table* get_mapper_table(s_config_entry* entry)
       switch(entry->event.type)
       {
         case E_EVENT_TYPE_BUTTON:
-          table = cfg_get_joystick_buttons(entry->device.id, entry->controller_id, entry->config_id);
+          kind = E_MAPPER_JOYSTICK_BUTTONS;
           break;
         case E_EVENT_TYPE_AXIS:
         case E_EVENT_TYPE_AXIS_UP:
         case E_EVENT_TYPE_AXIS_DOWN:
-          table = cfg_get_joystick_axes(entry->device.id, entry->controller_id, entry->config_id);
+          kind = E_MAPPER_JOYSTICK_AXES;
           break;
         default:
           break;
@@ -197,16 +372,29 @@ static s_mapper_table* get_mapper_table(s_config_entry* entry)
     default:
       break;
   }
-  return table;
+
+  if(kind < 0)
+  {
+    return NULL;
+  }
+
+  return alloc_table(kind, entry->device.id, entry->controller_id, entry->config_id);
 }
 
 static s_mapper* allocate_mapper(s_config_entry* entry)
 {
   s_mapper* ret = NULL;
+  void* ptr;
 
   s_mapper_table* table = get_mapper_table(entry);
 
-  void* ptr = realloc(table->mappers, (table->nb_mappers+1)*sizeof(*table->mappers));
+  if(!table)
+  {
+    fprintf(stderr, "can't allocate mapper\n");
+    return NULL;
+  }
+
+  ptr = realloc(table->mappers, (table->nb_mappers+1)*sizeof(*table->mappers));
 
   if(ptr)
   {
@@ -238,6 +426,11 @@ int cfg_add_binding(s_config_entry* entry)
     ret = -1;
   }
 
+  if(entry->device.type == E_DEVICE_TYPE_MOUSE && !alloc_mouse_control(entry->device.id))
+  {
+    ret = -1;
+  }
+
   return ret;
 }
 
@@ -248,10 +441,21 @@ static struct
   unsigned long strong;
   unsigned char falling; //indicates that weak and strong were null in the last event
   unsigned char off;
+  unsigned char pending; //the joystick is in the rumble list
 } joystick_rumble[MAX_DEVICES] = {};
 
+/*
+ * The joysticks that received rumble events since the last period.
+ */
+static s_device_list rumble_list = {};
+
 inline void cfg_process_rumble_event(GE_Event* event)
 {
+  if(!joystick_rumble[event->jrumble.which].pending)
+  {
+    joystick_rumble[event->jrumble.which].pending = 1;
+    rumble_list.ids[rumble_list.nb++] = event->jrumble.which;
+  }
   joystick_rumble[event->jrumble.which].weak += event->jrumble.weak;
   joystick_rumble[event->jrumble.which].strong += event->jrumble.strong;
   joystick_rumble[event->jrumble.which].nb++;
@@ -262,11 +466,15 @@ inline void cfg_process_rumble_event(GE_Event* event)
 
 void cfg_process_rumble()
 {
+  unsigned int l;
   int i;
-  for (i = 0; i < MAX_DEVICES; ++i)
+  for (l = 0; l < rumble_list.nb; ++l)
   {
+    i = rumble_list.ids[l];
     unsigned char nb = joystick_rumble[i].nb;
 
+    joystick_rumble[i].pending = 0;
+
     if(nb)
     {
       unsigned short weak = joystick_rumble[i].weak / nb;
@@ -286,17 +494,22 @@ void cfg_process_rumble()
       joystick_rumble[i].strong = 0;
     }
   }
+  rumble_list.nb = 0;
 }
 
 int cfg_is_joystick_used(int id)
 {
   int j, k;
   int used = 0;
+  if(!mappers[E_MAPPER_JOYSTICK_BUTTONS].devices[id] && !mappers[E_MAPPER_JOYSTICK_AXES].devices[id])
+  {
+    return 0;
+  }
   for(j=0; j<MAX_CONTROLLERS && !used; ++j)
   {
     for(k=0; k<MAX_CONFIGURATIONS && !used; ++k)
     {
-      if(joystick_buttons[id][j][k].nb_mappers || joystick_axes[id][j][k].nb_mappers)
+      if(cfg_get_joystick_buttons(id, j, k)->nb_mappers || cfg_get_joystick_axes(id, j, k)->nb_mappers)
       {
         used = 1;
       }
@@ -305,197 +518,539 @@ int cfg_is_joystick_used(int id)
   return used;
 }
 
+/*
+ * Get the controls of a mouse, to modify them.
+ * The mouse is processed in the next periods.
+ */
 inline s_mouse_control* cfg_get_mouse_control(int id)
 {
-  if(id >= 0)
-  {
-    return mouse_control + id;
-  }
-  return NULL;
-}
-
-void cfg_process_motion_event(GE_Event* event)
-{
-  s_mouse_control* mc = cfg_get_mouse_control(GE_GetDeviceId(event));
+  s_mouse_control* mc = get_mouse_control(id);
   if(mc)
   {
-    mc->merge_x[mc->index] += event->motion.xrel;
-    mc->merge_y[mc->index] += event->motion.yrel;
-    mc->change = 1;
+    activate_mouse(id, mc);
   }
+  return mc;
 }
 
-void cfg_process_motion()
+/*
+ * Scale a motion with a 16.16 fixed point factor.
+ * The part that is below a count is kept in the residue, and added to the next motion.
+ */
+static inline int scale_motion(int value, int32_t scale, int32_t* residue)
 {
-  int i, j, k;
-  int weight;
-  int divider;
-  s_mouse_control* mc;
-  s_mouse_cal* mcal;
-  GE_Event mouse_evt = { };
-  /*
-   * Process a single (merged) motion event for each mouse.
-   */
-  for (i = 0; i < MAX_DEVICES; ++i)
-  {
-    mc = cfg_get_mouse_control(i);
-    mcal = cal_get_mouse(i, cfg_controllers[cal_get_controller(i)].current->index);
-    if(!mc->change && mcal->options.mode == E_MOUSE_MODE_DRIVING)
-    {
-      //no auto-center
-      continue;
-    }
-    if (mc->changed || mc->change)
-    {
-      if (gimx_params.subpositions)
-      {
-        /*
-         * Add the residual motion vector from the last iteration.
-         */
-        mc->merge_x[mc->index] += mc->residue_x;
-        mc->merge_y[mc->index] += mc->residue_y;
-        /*
-         * If no motion was received this iteration, the residual motion vector from the last iteration is reset.
-         */
-        if (!mc->change)
-        {
-          mc->residue_x = 0;
-          mc->residue_y = 0;
-        }
-      }
-
-      mc->x = 0;
-      weight = 1;
-      divider = 0;
-      for(j=0; j<mcal->options.buffer_size; ++j)
-      {
-        k = mc->index - j;
-        if (k < 0)
-        {
-          k += MAX_BUFFERSIZE;
-        }
-        mc->x += (mc->merge_x[k]*weight);
-        divider += weight;
-        weight *= mcal->options.filter;
-      }
-      mc->x /= divider;
+  int64_t scaled = (int64_t) value * scale + *residue;
+  int64_t counts = scaled / 65536;
+  *residue = scaled - counts * 65536;
+  return counts;
+}
 
-      mc->y = 0;
-      weight = 1;
-      divider = 0;
-      for(j=0; j<mcal->options.buffer_size; ++j)
-      {
-        k = mc->index - j;
-        if (k < 0)
-        {
-          k += MAX_BUFFERSIZE;
-        }
-        mc->y += (mc->merge_y[k]*weight);
-        divider += weight;
-        weight *= mcal->options.filter;
-      }
-      mc->y /= divider;
+/*
+ * The fixed point path (--fixed-point) processes the mouse motions with integer arithmetic:
+ * the motions, the residues, and the axis values are in 16.16 fixed point.
+ * The configuration values are converted when the configuration is loaded or modified.
+ */
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
 
-      mouse_evt.motion.which = i;
-      mouse_evt.type = GE_MOUSEMOTION;
-      cfg_process_event(&mouse_evt);
+/*
+ * Convert to an integer, like the double to int conversion (the fractional part is discarded).
+ */
+static inline int fixed_to_int(int64_t value)
+{
+  return value >= 0 ? value >> FIXED_SHIFT : -(-value >> FIXED_SHIFT);
+}
 
-      mouse_evt.motion.xrel = mc->x;
-      mouse_evt.motion.yrel = mc->y;
-      macro_lookup(&mouse_evt);
-    }
-    mc->index++;
-    mc->index %= MAX_BUFFERSIZE;
-    mc->merge_x[mc->index] = 0;
-    mc->merge_y[mc->index] = 0;
-    mc->changed = mc->change;
-    mc->change = 0;
-    if (i == current_mouse && (current_cal == DZX || current_cal == DZY || current_cal == DZS))
-    {
-      mc->changed = 0;
-    }
-  }
+static inline int64_t fixed_mul(int64_t a, int64_t b)
+{
+  return (a * b) / FIXED_ONE;
 }
 
 /*
- * This updates the stick according to the intensity shape.
- * It only does something for axes in {rel_axis_lstick_x, rel_axis_lstick_y, rel_axis_rstick_x, rel_axis_rstick_y}
+ * The integer square root (rounded down), with Newton's method.
  */
-static void update_stick(int c_id, int axis)
+static uint64_t isqrt(uint64_t value)
 {
-  if(axis <= rel_axis_rstick_y)
+  uint64_t n, root;
+  int shift;
+
+  if(value >= (1ULL << 62))
   {
-    if(axis & 1)
-    {
-      axis = axis - 1;
-    }
+    root = isqrt(value >> 2) << 1;
+    return (root + 1 < (1ULL << 32) && (root + 1) * (root + 1) <= value) ? root + 1 : root;
   }
-  
-  s_intensity* intensity = &axis_intensity[c_id][cfg_controllers[c_id].current->index][axis];
-  double value = intensity->value;
-
-  if(intensity->down_button == -1 && intensity->up_button == -1)
+  if(value < 2)
   {
-    return;
+    return value;
   }
 
-  if (axis <= rel_axis_rstick_y && intensity->shape == E_SHAPE_CIRCLE)
+  /*
+   * Normalize to n in [2^60, 2^62[, with an even shift, so that sqrt(n) is in [2^30, 2^31[.
+   */
+  shift = (__builtin_clzll(value) - 2) & ~1;
+  n = value << shift;
+
+  /*
+   * Start from a linear approximation (within 3%), each iteration squares the relative error.
+   */
+  root = (((n >> 30) + (1ULL << 31)) * 351) >> 10;
+  root = (root + n / root) >> 1;
+  root = (root + n / root) >> 1;
+  root = (root + n / root) >> 1;
+  while(root * root > n)
   {
-    if (adapter_get(c_id)->axis[axis] && adapter_get(c_id)->axis[axis+1])
-    {
-      value = sqrt(value * value / 2);
-    }
+    --root;
+  }
+  while((root + 1) * (root + 1) <= n)
+  {
+    ++root;
   }
 
-  if (adapter_get(c_id)->axis[axis] > 0)
+  return root >> (shift / 2);
+}
+
+/*
+ * Set the motion of a mouse for the current period.
+ */
+void cfg_set_mouse_motion(s_mouse_control* mc, int x, int y)
+{
+  mc->merge_x[mc->index] = x;
+  mc->merge_y[mc->index] = y;
+  if(mc->fixed)
   {
-    adapter_get(c_id)->axis[axis] = round(value);
-    adapter_get(c_id)->send_command = 1;
+    mc->fixed->merge_x[mc->index] = (int64_t) x * FIXED_ONE;
+    mc->fixed->merge_y[mc->index] = (int64_t) y * FIXED_ONE;
   }
-  else if (adapter_get(c_id)->axis[axis] < 0)
+  mc->change = 1;
+}
+
+void cfg_process_motion_event(GE_Event* event)
+{
+  s_mouse_control* mc = cfg_get_mouse_control(GE_GetDeviceId(event));
+  if(mc && gimx_params.fixed_point)
   {
-    adapter_get(c_id)->axis[axis] = -round(value);
-    adapter_get(c_id)->send_command = 1;
+    if(mc->scale)
+    {
+      mc->fixed->merge_x[mc->index] += (int64_t) scale_motion(event->motion.xrel, mc->scale, &mc->scale_residue_x) * FIXED_ONE;
+      mc->fixed->merge_y[mc->index] += (int64_t) scale_motion(event->motion.yrel, mc->scale, &mc->scale_residue_y) * FIXED_ONE;
+    }
+    else
+    {
+      mc->fixed->merge_x[mc->index] += (int64_t) event->motion.xrel * FIXED_ONE;
+      mc->fixed->merge_y[mc->index] += (int64_t) event->motion.yrel * FIXED_ONE;
+    }
+    if(!mc->change)
+    {
+      mc->timestamp = event->timestamp;
+    }
+    mc->change = 1;
   }
-  if (axis <= rel_axis_rstick_y)
+  else if(mc)
   {
-    if (adapter_get(c_id)->axis[axis+1] > 0)
+    if(mc->scale)
     {
-      adapter_get(c_id)->axis[axis+1] = round(value);
-      adapter_get(c_id)->send_command = 1;
+      mc->merge_x[mc->index] += scale_motion(event->motion.xrel, mc->scale, &mc->scale_residue_x);
+      mc->merge_y[mc->index] += scale_motion(event->motion.yrel, mc->scale, &mc->scale_residue_y);
     }
-    else if (adapter_get(c_id)->axis[axis+1] < 0)
+    else
+    {
+      mc->merge_x[mc->index] += event->motion.xrel;
+      mc->merge_y[mc->index] += event->motion.yrel;
+    }
+    if(!mc->change)
     {
-      adapter_get(c_id)->axis[axis+1] = -round(value);
-      adapter_get(c_id)->send_command = 1;
+      mc->timestamp = event->timestamp;
     }
+    mc->change = 1;
   }
 }
 
 /*
- * Update an axis intensity.
+ * The motion filter is a weighted average of the last buffer_size motions.
+ * The weight of the latest motion is 1, and the weight of each previous motion
+ * is the weight of the next one multiplied by the filter value (the weights are integers).
  */
-static int update_intensity(int device_type, int device_id, int button, int c_id, int axis)
+static void filter_sum(s_mouse_control* mc, s_mouse_cal* mcal)
 {
-  int ret = 0;
-  
-  s_intensity* intensity = &axis_intensity[c_id][cfg_controllers[c_id].current->index][axis];
+  int j, k;
+  int weight;
+  int divider;
 
-  if (intensity->device_up_type == device_type && device_id == intensity->device_up_id && button == intensity->up_button)
+  mc->x = 0;
+  weight = 1;
+  divider = 0;
+  for(j=0; j<mcal->options.buffer_size; ++j)
   {
-    intensity->value += intensity->step;
-    if (intensity->value > intensity->max_value)
+    k = mc->index - j;
+    if (k < 0)
     {
-      if (intensity->down_button != -1)
-      {
-        intensity->value = intensity->max_value;
-      }
-      else
-      {
-        intensity->value = (double) intensity->dead_zone + intensity->step;
-      }
+      k += MAX_BUFFERSIZE;
     }
-    ret = 1;
+    mc->x += (mc->merge_x[k]*weight);
+    divider += weight;
+    weight *= mcal->options.filter;
+  }
+  mc->x /= divider;
+
+  mc->y = 0;
+  weight = 1;
+  divider = 0;
+  for(j=0; j<mcal->options.buffer_size; ++j)
+  {
+    k = mc->index - j;
+    if (k < 0)
+    {
+      k += MAX_BUFFERSIZE;
+    }
+    mc->y += (mc->merge_y[k]*weight);
+    divider += weight;
+    weight *= mcal->options.filter;
+  }
+  mc->y /= divider;
+}
+
+static void filter_sum_fixed(s_mouse_control* mc, s_mouse_cal* mcal)
+{
+  int j, k;
+  int64_t weight = 1;
+  int64_t divider = 0;
+  int64_t x = 0;
+  int64_t y = 0;
+
+  for(j=0; j<mcal->options.buffer_size; ++j)
+  {
+    k = mc->index - j;
+    if (k < 0)
+    {
+      k += MAX_BUFFERSIZE;
+    }
+    x += mc->fixed->merge_x[k] * weight;
+    y += mc->fixed->merge_y[k] * weight;
+    divider += weight;
+    weight = weight * mcal->options.fixed_filter / FIXED_ONE;
+  }
+  mc->fixed->x = divider ? x / divider : 0;
+  mc->fixed->y = divider ? y / divider : 0;
+}
+
+/*
+ * The recursive filter computes the same weighted average when the weights are a geometric sequence:
+ * the weighted sum of the previous motions is updated at each period, instead of being recomputed.
+ * As the weights are truncated to integers, a filter value below 1 only keeps the latest motion,
+ * and a filter value below 2 gives the same weight to all motions (a moving average).
+ * Returns 0 if the weights are a geometric sequence, -1 otherwise.
+ */
+static int get_filter_params(s_mouse_cal* mcal, unsigned int* size, double* ratio)
+{
+  int weight = mcal->options.filter; //the weight of the previous motion
+
+  if(!mcal->options.buffer_size || mcal->options.buffer_size > MAX_BUFFERSIZE)
+  {
+    return -1;
+  }
+
+  if(mcal->options.buffer_size == 1 || weight == 0)
+  {
+    *size = 1;
+    *ratio = 0;
+    return 0;
+  }
+
+  if(weight == 1)
+  {
+    *size = mcal->options.buffer_size;
+    *ratio = 1;
+    return 0;
+  }
+
+  return -1;
+}
+
+/*
+ * Recompute the weighted sums of the previous motions.
+ * This is done when the filter parameters change, and each time the index wraps around,
+ * so that the rounding errors don't accumulate.
+ */
+static void filter_sync(s_mouse_control* mc, unsigned int size, double ratio)
+{
+  double weight = 1;
+  unsigned int j;
+  int k;
+
+  mc->filter.size = size;
+  mc->filter.ratio = ratio;
+  mc->filter.divider = 1;
+  mc->filter.past_x = 0;
+  mc->filter.past_y = 0;
+  for(j = 1; j < size; ++j)
+  {
+    weight *= ratio;
+    k = mc->index - j;
+    if (k < 0)
+    {
+      k += MAX_BUFFERSIZE;
+    }
+    mc->filter.past_x += mc->merge_x[k] * weight;
+    mc->filter.past_y += mc->merge_y[k] * weight;
+    mc->filter.divider += weight;
+  }
+  mc->filter.ratio_size = weight * ratio;
+}
+
+static inline void filter_recursive(s_mouse_control* mc)
+{
+  mc->x = (mc->merge_x[mc->index] + mc->filter.past_x) / mc->filter.divider;
+  mc->y = (mc->merge_y[mc->index] + mc->filter.past_y) / mc->filter.divider;
+}
+
+/*
+ * Move the window to the next index: the latest motion becomes a previous one,
+ * and the oldest motion leaves the window.
+ */
+static inline void filter_advance(s_mouse_control* mc)
+{
+  int k = mc->index - (mc->filter.size - 1);
+  if (k < 0)
+  {
+    k += MAX_BUFFERSIZE;
+  }
+  mc->filter.past_x = mc->filter.ratio * (mc->merge_x[mc->index] + mc->filter.past_x) - mc->filter.ratio_size * mc->merge_x[k];
+  mc->filter.past_y = mc->filter.ratio * (mc->merge_y[mc->index] + mc->filter.past_y) - mc->filter.ratio_size * mc->merge_y[k];
+}
+
+void cfg_process_motion()
+{
+  int i;
+  unsigned int l, nb;
+  unsigned int size;
+  double ratio;
+  int recursive;
+  unsigned int ticks;
+  s_mouse_control* mc;
+  s_mouse_cal* mcal;
+  GE_Event mouse_evt = { };
+  /*
+   * Process a single (merged) motion event for each active mouse.
+   * The mice that are not active have an empty motion buffer, and nothing to process.
+   */
+  for (l = 0, nb = 0; l < active_mice.nb; ++l)
+  {
+    i = active_mice.ids[l];
+    mc = mouse_control[i];
+    mcal = cal_get_mouse(i, cfg_controllers[cal_get_controller(i)].current->index);
+    if(!mc->change && mcal->options.mode == E_MOUSE_MODE_DRIVING)
+    {
+      //no auto-center, and nothing to do until the next motion
+      mc->active = 0;
+      continue;
+    }
+    if(!scheduler_is_due(motion_controller[i]))
+    {
+      //the motion is accumulated until the controller gets refreshed
+      active_mice.ids[nb++] = i;
+      continue;
+    }
+    ticks = scheduler_get_ticks(motion_controller[i]);
+    if(ticks != mc->ticks)
+    {
+      mc->ticks = ticks;
+      mc->frequency_scale = gimx_params.frequency_scale / ticks;
+      mc->fixed_frequency_scale = llround(mc->frequency_scale * FIXED_ONE);
+    }
+    recursive = !gimx_params.fixed_point && gimx_params.recursive_filter && get_filter_params(mcal, &size, &ratio) == 0;
+    if (recursive)
+    {
+      if (size != mc->filter.size || ratio != mc->filter.ratio || !mc->index)
+      {
+        filter_sync(mc, size, ratio);
+      }
+    }
+    else
+    {
+      mc->filter.size = 0;
+    }
+    if ((mc->changed || mc->change) && gimx_params.fixed_point)
+    {
+      if (gimx_params.subpositions)
+      {
+        mc->fixed->merge_x[mc->index] += mc->fixed->residue_x;
+        mc->fixed->merge_y[mc->index] += mc->fixed->residue_y;
+        if (!mc->change)
+        {
+          mc->fixed->residue_x = 0;
+          mc->fixed->residue_y = 0;
+        }
+      }
+
+      filter_sum_fixed(mc, mcal);
+
+      mouse_evt.motion.which = i;
+      mouse_evt.type = GE_MOUSEMOTION;
+      mouse_evt.timestamp = mc->change ? mc->timestamp : 0;
+      cfg_process_event(&mouse_evt);
+
+      mouse_evt.motion.xrel = fixed_to_int(mc->fixed->x);
+      mouse_evt.motion.yrel = fixed_to_int(mc->fixed->y);
+      macro_lookup(&mouse_evt);
+    }
+    else if (mc->changed || mc->change)
+    {
+      if (gimx_params.subpositions)
+      {
+        /*
+         * Add the residual motion vector from the last iteration.
+         */
+        mc->merge_x[mc->index] += mc->residue_x;
+        mc->merge_y[mc->index] += mc->residue_y;
+        /*
+         * If no motion was received this iteration, the residual motion vector from the last iteration is reset.
+         */
+        if (!mc->change)
+        {
+          mc->residue_x = 0;
+          mc->residue_y = 0;
+        }
+      }
+
+      if (recursive)
+      {
+        filter_recursive(mc);
+      }
+      else
+      {
+        filter_sum(mc, mcal);
+      }
+
+      mouse_evt.motion.which = i;
+      mouse_evt.type = GE_MOUSEMOTION;
+      mouse_evt.timestamp = mc->change ? mc->timestamp : 0;
+      cfg_process_event(&mouse_evt);
+
+      mouse_evt.motion.xrel = mc->x;
+      mouse_evt.motion.yrel = mc->y;
+      macro_lookup(&mouse_evt);
+    }
+    if (recursive)
+    {
+      filter_advance(mc);
+    }
+    mc->index++;
+    mc->index %= MAX_BUFFERSIZE;
+    mc->merge_x[mc->index] = 0;
+    mc->merge_y[mc->index] = 0;
+    if(mc->fixed)
+    {
+      mc->fixed->merge_x[mc->index] = 0;
+      mc->fixed->merge_y[mc->index] = 0;
+    }
+    mc->changed = mc->change;
+    mc->change = 0;
+    if (i == current_mouse && (current_cal == DZX || current_cal == DZY || current_cal == DZS))
+    {
+      mc->changed = 0;
+    }
+    /*
+     * The motion buffer is empty after MAX_BUFFERSIZE periods without motion.
+     */
+    if (!mc->changed && ++mc->idle >= MAX_BUFFERSIZE)
+    {
+      mc->active = 0;
+      continue;
+    }
+    active_mice.ids[nb++] = i;
+  }
+  active_mice.nb = nb;
+}
+
+/*
+ * This updates the stick according to the intensity shape.
+ * It only does something for axes in {rel_axis_lstick_x, rel_axis_lstick_y, rel_axis_rstick_x, rel_axis_rstick_y}
+ */
+static void update_stick(int c_id, int axis)
+{
+  if(axis <= rel_axis_rstick_y)
+  {
+    if(axis & 1)
+    {
+      axis = axis - 1;
+    }
+  }
+  
+  s_intensity* intensity = &axis_intensity[c_id][cfg_controllers[c_id].current->index][axis];
+  double value = intensity->value;
+  int64_t fixed_value = intensity->fixed_value;
+  int position;
+
+  if(intensity->down_button == -1 && intensity->up_button == -1)
+  {
+    return;
+  }
+
+  if (axis <= rel_axis_rstick_y && intensity->shape == E_SHAPE_CIRCLE)
+  {
+    if (adapter_get(c_id)->axis[axis] && adapter_get(c_id)->axis[axis+1])
+    {
+      if(gimx_params.fixed_point)
+      {
+        fixed_value = isqrt((uint64_t) fixed_value * fixed_value / 2);
+      }
+      else
+      {
+        value = sqrt(value * value / 2);
+      }
+    }
+  }
+
+  position = gimx_params.fixed_point ? (fixed_value + FIXED_ONE / 2) >> FIXED_SHIFT : round(value);
+
+  if (adapter_get(c_id)->axis[axis] > 0)
+  {
+    adapter_get(c_id)->axis[axis] = position;
+    adapter_set_send_command(c_id);
+  }
+  else if (adapter_get(c_id)->axis[axis] < 0)
+  {
+    adapter_get(c_id)->axis[axis] = -position;
+    adapter_set_send_command(c_id);
+  }
+  if (axis <= rel_axis_rstick_y)
+  {
+    if (adapter_get(c_id)->axis[axis+1] > 0)
+    {
+      adapter_get(c_id)->axis[axis+1] = position;
+      adapter_set_send_command(c_id);
+    }
+    else if (adapter_get(c_id)->axis[axis+1] < 0)
+    {
+      adapter_get(c_id)->axis[axis+1] = -position;
+      adapter_set_send_command(c_id);
+    }
+  }
+}
+
+/*
+ * Update an axis intensity.
+ */
+static int update_intensity(int device_type, int device_id, int button, int c_id, int axis)
+{
+  int ret = 0;
+  
+  s_intensity* intensity = &axis_intensity[c_id][cfg_controllers[c_id].current->index][axis];
+
+  if (intensity->device_up_type == device_type && device_id == intensity->device_up_id && button == intensity->up_button)
+  {
+    intensity->value += intensity->step;
+    if (intensity->value > intensity->max_value)
+    {
+      if (intensity->down_button != -1)
+      {
+        intensity->value = intensity->max_value;
+      }
+      else
+      {
+        intensity->value = (double) intensity->dead_zone + intensity->step;
+      }
+    }
+    ret = 1;
   }
   else if (intensity->device_down_type == device_type && device_id == intensity->device_down_id && button == intensity->down_button)
   {
@@ -514,6 +1069,11 @@ static int update_intensity(int device_type, int device_id, int button, int c_id
     ret = 1;
   }
 
+  if(ret)
+  {
+    intensity->fixed_value = llround(intensity->value * 65536);
+  }
+
   return ret;
 }
 
@@ -558,6 +1118,44 @@ void cfg_intensity_lookup(GE_Event* e)
   }
 }
 
+static void dispatch_build();
+static void response_build();
+
+/*
+ * Select the controller that paces the motion processing of each mouse.
+ */
+static void motion_controller_init()
+{
+  s_mapper_table* table;
+  unsigned int l;
+  int device, c_id, config;
+
+  for(l=0; l<mappers[E_MAPPER_MOUSE_AXES].list.nb; ++l)
+  {
+    device = mappers[E_MAPPER_MOUSE_AXES].list.ids[l];
+    motion_controller[device] = -1;
+    for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+    {
+      for(config=0; config<MAX_CONFIGURATIONS; ++config)
+      {
+        table = get_table(E_MAPPER_MOUSE_AXES, device, c_id, config);
+        if(table->nb_mappers)
+        {
+          if(motion_controller[device] < 0 || adapter_get(c_id)->refresh_period > adapter_get(motion_controller[device])->refresh_period)
+          {
+            motion_controller[device] = c_id;
+          }
+          break;
+        }
+      }
+    }
+    if(motion_controller[device] < 0)
+    {
+      motion_controller[device] = 0;
+    }
+  }
+}
+
 /*
  * Initialize next_config and prev_config tables.
  */
@@ -577,6 +1175,10 @@ void cfg_trigger_init()
       profile->state.previous = NULL;
     }
   }
+
+  motion_controller_init();
+  dispatch_build();
+  response_build();
 }
 
 static inline s_event get_event(GE_Event * event)
@@ -746,6 +1348,7 @@ void cfg_config_activation()
 {
   int i, j;
   struct timeval tv;
+  int switched = 0;
 
   for(i=0; i<MAX_CONTROLLERS; ++i)
   {
@@ -778,6 +1381,7 @@ void cfg_config_activation()
           }
 
           cfg_controllers[i].current = next;
+          switched = 1;
 
           for(j=0; j<AXIS_MAX; ++j)
           {
@@ -793,6 +1397,19 @@ void cfg_config_activation()
       }
     }
   }
+
+  if(switched)
+  {
+    dispatch_build();
+    response_build();
+    /*
+     * The mouse mode may be different in the new profiles.
+     */
+    for(i=0; i<mouse_list.nb; ++i)
+    {
+      activate_mouse(mouse_list.ids[i], mouse_control[mouse_list.ids[i]]);
+    }
+  }
 }
 
 /*
@@ -806,7 +1423,11 @@ static int postpone_event(unsigned int device, GE_Event* event)
 {
   int i;
   int ret = 0;
-  s_mouse_control* mc = mouse_control + device;
+  s_mouse_control* mc = get_mouse_control(device);
+  if (!mc)
+  {
+    return 0;
+  }
   if (event->button.button == GE_BTN_WHEELUP
    || event->button.button == GE_BTN_WHEELDOWN
    || event->button.button == GE_BTN_WHEELRIGHT
@@ -847,7 +1468,339 @@ static int postpone_event(unsigned int device, GE_Event* event)
   return ret;
 }
 
-static double mouse2axis(int device, s_adapter* controller, int which, double x, double y, s_axis_props* axis_props, double exp, double multiplier, int dead_zone, e_shape shape, e_mouse_mode mode)
+/*
+ * The power functions of the mouse to axis response curves can be computed with precomputed tables:
+ * v = m * 2^k with m in [1, 2[, so v^e = m^e * 2^(k*e),
+ * where m^e is interpolated between RESPONSE_STEPS + 1 values with a cubic Hermite spline,
+ * and 2^(k*e) is precomputed for k in [RESPONSE_MIN_EXP, RESPONSE_MAX_EXP].
+ * The values are exact on the interpolation points, which include the integers up to 2 * RESPONSE_STEPS,
+ * and the powers of 2 (if their power is a power of 2).
+ */
+#define RESPONSE_STEPS 256
+#define RESPONSE_MIN_EXP -32
+#define RESPONSE_MAX_EXP 32
+
+typedef struct
+{
+  double exponent;
+  double value[RESPONSE_STEPS + 1]; //m^e
+  double slope[RESPONSE_STEPS + 1]; //the derivative of m^e, multiplied by the step
+  double scale[RESPONSE_MAX_EXP - RESPONSE_MIN_EXP + 1]; //2^(k*e)
+} s_power;
+
+/*
+ * The same tables for the fixed point path (see --fixed-point), with integer values only,
+ * and a factor f (the multiplier of the binding, or its inverse for the motion residue):
+ * v = m * 2^k, with m the upper bits of v in 2.30 fixed point, and k = msb - 16 for the msb of v in [0, 62],
+ * so f * v^e = m^e * f * 2^(k*e) = m^e * s * 2^n, with s in [1, 2[.
+ * The values of m^e are divided by 2^ceil(e), to fit in 30 bits.
+ * The cubic Hermite spline of each step is stored as a polynomial, to be evaluated with the Horner method.
+ * Folding the factor into s keeps 30 significant bits, whatever the factor.
+ */
+#define FIXED_RESPONSE_BITS 30
+#define FIXED_RESPONSE_MSB 62
+#define FIXED_RESPONSE_MAX ((int64_t) 1 << 46) //the results are saturated to 2^30, so that the axis positions fit in an int
+
+typedef struct
+{
+  int64_t coef[RESPONSE_STEPS][4]; //the coefficients of the cubic of each step, 2.30 fixed point
+  int64_t scale[FIXED_RESPONSE_MSB + 1]; //s, 2.30 fixed point
+  int shift[FIXED_RESPONSE_MSB + 1]; //n - 14, to get a 16.16 fixed point result
+} s_fixed_power;
+
+/*
+ * The fixed point tables of a binding, with its multiplier and its dead zone,
+ * multiplied by the axis scale of the controller, in 16.16 fixed point.
+ */
+struct fixed_response
+{
+  s_fixed_power direct; //|multiplier| * v^exponent
+  s_fixed_power inverse; //(v / |multiplier|)^(1/exponent)
+  double multiplier; //the multiplier the tables were built for
+  unsigned int dead_zone; //the dead zone the tables were built for
+  int type; //the controller type the tables were built for
+  int64_t fixed_multiplier;
+  int64_t fixed_dead_zone;
+};
+
+struct response
+{
+  double exponent; //the exponent of the binding the tables were built for
+  s_power direct; //v^exponent
+  s_power inverse; //v^(1/exponent), for the motion residue
+  struct fixed_response* fixed; //only allocated for the fixed point path
+};
+
+static struct
+{
+  unsigned long long evaluations;
+  unsigned long long differences; //the evaluations that gave another axis position
+  int max_error; //the maximum difference to the exact axis position
+  double max_residue_error; //the maximum difference to the exact motion residue
+} response_check = {};
+
+static void power_init(s_power* power, double exponent)
+{
+  double m;
+  int i;
+
+  power->exponent = exponent;
+  for(i = 0; i <= RESPONSE_STEPS; ++i)
+  {
+    m = 1 + (double) i / RESPONSE_STEPS;
+    power->value[i] = pow(m, exponent);
+    power->slope[i] = exponent * pow(m, exponent - 1) / RESPONSE_STEPS;
+  }
+  for(i = RESPONSE_MIN_EXP; i <= RESPONSE_MAX_EXP; ++i)
+  {
+    power->scale[i - RESPONSE_MIN_EXP] = pow(2, i * exponent);
+  }
+}
+
+static inline double power_get(const s_power* power, double v)
+{
+  double m, t, t2, t3;
+  int k, i;
+
+  if(v <= 0)
+  {
+    return pow(v, power->exponent);
+  }
+
+  /*
+   * These ones are exact and faster than the tables.
+   */
+  if(power->exponent == 1)
+  {
+    return v;
+  }
+  else if(power->exponent == 2)
+  {
+    return v * v;
+  }
+  else if(power->exponent == 0.5)
+  {
+    return sqrt(v);
+  }
+
+  m = 2 * frexp(v, &k);
+  --k;
+  if(k < RESPONSE_MIN_EXP || k > RESPONSE_MAX_EXP)
+  {
+    return pow(v, power->exponent);
+  }
+
+  t = (m - 1) * RESPONSE_STEPS;
+  i = t;
+  if(i >= RESPONSE_STEPS)
+  {
+    i = RESPONSE_STEPS - 1;
+  }
+  t -= i;
+  t2 = t * t;
+  t3 = t2 * t;
+
+  return ((2 * t3 - 3 * t2 + 1) * power->value[i] + (t3 - 2 * t2 + t) * power->slope[i]
+      + (3 * t2 - 2 * t3) * power->value[i + 1] + (t3 - t2) * power->slope[i + 1]) * power->scale[k - RESPONSE_MIN_EXP];
+}
+
+static void fixed_power_init(s_fixed_power* power, double exponent, double factor)
+{
+  double v0, v1, s0, s1, x;
+  int i, ceiling, n;
+
+  ceiling = ceil(exponent);
+  for(i = 0; i < RESPONSE_STEPS; ++i)
+  {
+    v0 = pow(1 + (double) i / RESPONSE_STEPS, exponent);
+    v1 = pow(1 + (double) (i + 1) / RESPONSE_STEPS, exponent);
+    s0 = exponent * pow(1 + (double) i / RESPONSE_STEPS, exponent - 1) / RESPONSE_STEPS;
+    s1 = exponent * pow(1 + (double) (i + 1) / RESPONSE_STEPS, exponent - 1) / RESPONSE_STEPS;
+    power->coef[i][0] = llround(ldexp(v0, FIXED_RESPONSE_BITS - ceiling));
+    power->coef[i][1] = llround(ldexp(s0, FIXED_RESPONSE_BITS - ceiling));
+    power->coef[i][2] = llround(ldexp(3 * (v1 - v0) - 2 * s0 - s1, FIXED_RESPONSE_BITS - ceiling));
+    power->coef[i][3] = llround(ldexp(2 * (v0 - v1) + s0 + s1, FIXED_RESPONSE_BITS - ceiling));
+  }
+  for(i = 0; i <= FIXED_RESPONSE_MSB; ++i)
+  {
+    x = log2(factor) + (i - FIXED_SHIFT) * exponent + ceiling;
+    n = floor(x);
+    power->scale[i] = llround(ldexp(pow(2, x - n), FIXED_RESPONSE_BITS));
+    power->shift[i] = n - (FIXED_RESPONSE_BITS - FIXED_SHIFT);
+  }
+}
+
+/*
+ * Compute f * v^e, with v in 16.16 fixed point.
+ */
+static inline int64_t fixed_power_get(const s_fixed_power* power, int64_t v)
+{
+  int64_t m, t, r;
+  int msb, i, shift;
+
+  if(v <= 0)
+  {
+    return 0;
+  }
+
+  msb = 63 - __builtin_clzll(v);
+  m = msb >= FIXED_RESPONSE_BITS ? v >> (msb - FIXED_RESPONSE_BITS) : v << (FIXED_RESPONSE_BITS - msb);
+
+  t = (m - (1 << FIXED_RESPONSE_BITS)) * RESPONSE_STEPS;
+  i = t >> FIXED_RESPONSE_BITS;
+  t -= (int64_t) i << FIXED_RESPONSE_BITS;
+
+  r = power->coef[i][3];
+  r = ((r * t) >> FIXED_RESPONSE_BITS) + power->coef[i][2];
+  r = ((r * t) >> FIXED_RESPONSE_BITS) + power->coef[i][1];
+  r = ((r * t) >> FIXED_RESPONSE_BITS) + power->coef[i][0];
+
+  r = (r * power->scale[msb]) >> FIXED_RESPONSE_BITS;
+
+  shift = power->shift[msb];
+  if(shift < 0)
+  {
+    return shift > -63 ? (r + ((int64_t) 1 << (-shift - 1))) >> -shift : 0; //round to nearest
+  }
+  if(shift > 31 || (r << shift) > FIXED_RESPONSE_MAX) //r < 2^31
+  {
+    return FIXED_RESPONSE_MAX;
+  }
+  return r << shift;
+}
+
+/*
+ * Get the response tables of a mouse axis binding, and build them if needed.
+ * They are built when a profile gets active, and rebuilt if the exponent is changed by the calibration.
+ * Returns NULL if the exact response has to be computed.
+ */
+static struct response* get_response(s_mapper* mapper)
+{
+  if(!gimx_params.response_tables && !gimx_params.response_check && !gimx_params.fixed_point)
+  {
+    return NULL;
+  }
+
+  if(mapper->exponent <= 0)
+  {
+    return NULL;
+  }
+
+  if(!mapper->response || mapper->response->exponent != mapper->exponent)
+  {
+    if(!mapper->response)
+    {
+      mapper->response = malloc(sizeof(*mapper->response));
+      if(!mapper->response)
+      {
+        fprintf(stderr, "%s:%d malloc failed\n", __FILE__, __LINE__);
+        return NULL;
+      }
+      mapper->response->fixed = NULL;
+    }
+    mapper->response->exponent = mapper->exponent;
+    power_init(&mapper->response->direct, mapper->exponent);
+    power_init(&mapper->response->inverse, 1 / mapper->exponent);
+    if(mapper->response->fixed)
+    {
+      mapper->response->fixed->type = -1;
+    }
+  }
+
+  return mapper->response;
+}
+
+/*
+ * Get the response of a mouse axis binding for the fixed point path.
+ * The fixed point tables depend on the multiplier, and they are rebuilt if it is changed by the calibration.
+ * Returns NULL if the exact response has to be computed.
+ */
+static struct fixed_response* get_fixed_response(s_mapper* mapper, s_adapter* controller)
+{
+  struct response* response = get_response(mapper);
+  struct fixed_response* fixed;
+  double scale;
+
+  if(!response)
+  {
+    return NULL;
+  }
+
+  if(!response->fixed)
+  {
+    response->fixed = malloc(sizeof(*response->fixed));
+    if(!response->fixed)
+    {
+      fprintf(stderr, "%s:%d malloc failed\n", __FILE__, __LINE__);
+      return NULL;
+    }
+    response->fixed->type = -1;
+  }
+
+  fixed = response->fixed;
+
+  if(fixed->type != controller->type || fixed->multiplier != mapper->multiplier || fixed->dead_zone != mapper->dead_zone)
+  {
+    scale = controller_get_axis_scale(controller->type, mapper->axis_props.axis);
+    fixed->type = controller->type;
+    fixed->multiplier = mapper->multiplier;
+    fixed->dead_zone = mapper->dead_zone;
+    fixed->fixed_multiplier = llround(mapper->multiplier * scale * FIXED_ONE);
+    fixed->fixed_dead_zone = llround(mapper->dead_zone * scale * FIXED_ONE);
+    fixed_power_init(&fixed->direct, mapper->exponent, fabs(mapper->multiplier * scale));
+    fixed_power_init(&fixed->inverse, 1 / mapper->exponent, pow(fabs(mapper->multiplier * scale), -1 / mapper->exponent));
+  }
+
+  return fixed;
+}
+
+/*
+ * Build the response tables of the mouse axis bindings of the current profiles.
+ */
+static void response_build()
+{
+  s_mapper_table* table;
+  unsigned int l;
+  int c_id, control;
+
+  for(l=0; l<mappers[E_MAPPER_MOUSE_AXES].list.nb; ++l)
+  {
+    for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+    {
+      table = get_table(E_MAPPER_MOUSE_AXES, mappers[E_MAPPER_MOUSE_AXES].list.ids[l], c_id, cfg_controllers[c_id].current->index);
+      for(control=0; control<table->nb_mappers; ++control)
+      {
+        if(table->mappers[control].axis_props.axis >= 0 && table->mappers[control].multiplier)
+        {
+          if(gimx_params.fixed_point)
+          {
+            get_fixed_response(table->mappers + control, adapter_get(c_id));
+          }
+          else
+          {
+            get_response(table->mappers + control);
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+ * \brief Print the differences between the response tables and the exact response (see --response-check).
+ */
+void cfg_response_report()
+{
+  if(!gimx_params.response_check)
+  {
+    return;
+  }
+
+  printf(_("response tables: %llu evaluations, %llu different axis positions, max position error: %d, max residue error: %g\n"),
+      response_check.evaluations, response_check.differences, response_check.max_error, response_check.max_residue_error);
+}
+
+static double mouse2axis(int device, s_adapter* controller, int which, double x, double y, s_axis_props* axis_props, double exp, double multiplier, int dead_zone, e_shape shape, e_mouse_mode mode, struct response* response)
 {
   double z = 0;
   double dz = dead_zone;
@@ -873,10 +1826,10 @@ static double mouse2axis(int device, s_adapter* controller, int which, double x,
 
   if(which == AXIS_X)
   {
-    val = x * gimx_params.frequency_scale;
+    val = x * mouse_control[device]->frequency_scale;
     if(x && y && shape == E_SHAPE_CIRCLE)
     {
-      dz = dz*cos(atan(fabs(y/x)));
+      dz = response ? dz*fabs(x)/sqrt(x*x + y*y) : dz*cos(atan(fabs(y/x)));
     }
     if(device == current_mouse && (current_cal == DZX || current_cal == DZS))
     {
@@ -893,10 +1846,10 @@ static double mouse2axis(int device, s_adapter* controller, int which, double x,
   }
   else if(which == AXIS_Y)
   {
-    val = y * gimx_params.frequency_scale;
+    val = y * mouse_control[device]->frequency_scale;
     if(x && y && shape == E_SHAPE_CIRCLE)
     {
-      dz = dz*sin(atan(fabs(y/x)));
+      dz = response ? dz*fabs(y)/sqrt(x*x + y*y) : dz*sin(atan(fabs(y/x)));
     }
     if(device == current_mouse && (current_cal == DZY || current_cal == DZS))
     {
@@ -914,7 +1867,7 @@ static double mouse2axis(int device, s_adapter* controller, int which, double x,
 
   if(val != 0)
   {
-    z = multiplier * (val/fabs(val)) * pow(fabs(val), exp);
+    z = multiplier * (val/fabs(val)) * (response ? power_get(&response->direct, fabs(val)) : pow(fabs(val), exp));
     /*
      * Subtract the first position to the dead zone (useful for high multipliers).
      */
@@ -967,7 +1920,7 @@ static double mouse2axis(int device, s_adapter* controller, int which, double x,
     /*
      * Compute the motion that wasn't applied due to the double to integer conversion.
      */
-    motion_residue = (val/fabs(val)) * ( fabs(val) - pow(fabs(ztrunk)/multiplier, 1/exp) );
+    motion_residue = (val/fabs(val)) * ( fabs(val) - (response ? power_get(&response->inverse, fabs(ztrunk)/multiplier) : pow(fabs(ztrunk)/multiplier, 1/exp)) );
     if(fabs(motion_residue) < 0.0039)//allow 256 subpositions
     {
       motion_residue = 0;
@@ -978,6 +1931,151 @@ static double mouse2axis(int device, s_adapter* controller, int which, double x,
   return motion_residue;
 }
 
+/*
+ * The fixed point version of mouse2axis: x, y, and the returned residue are in 16.16 fixed point.
+ * The multiplier, the dead zone and the exponent are the ones of the response.
+ */
+static int64_t mouse2axis_fixed(int device, s_adapter* controller, int which, int64_t x, int64_t y, s_axis_props* axis_props, e_shape shape, e_mouse_mode mode, const struct fixed_response* response)
+{
+  int64_t z = 0;
+  int64_t dz = response->fixed_dead_zone;
+  int64_t multiplier = response->fixed_multiplier;
+  int64_t motion_residue = 0;
+  int64_t ztrunk = 0;
+  int64_t val = 0;
+  int64_t ax, ay, norm;
+  int min_axis, max_axis;
+  int new_state;
+  int shift;
+  int axis = axis_props->axis;
+
+  max_axis = controller_get_max_signed(controller->type, axis);
+  if(axis_props->props == AXIS_PROP_CENTERED)
+  {
+    min_axis = -max_axis;
+  }
+  else
+  {
+    min_axis = 0;
+  }
+
+  if(x && y && shape == E_SHAPE_CIRCLE)
+  {
+    ax = llabs(x);
+    ay = llabs(y);
+    /*
+     * Normalize the motion to 30 bits, for the precision of the square root.
+     */
+    shift = __builtin_clzll(ax | ay) - 34;
+    if(shift > 0)
+    {
+      ax <<= shift;
+      ay <<= shift;
+    }
+    else
+    {
+      ax >>= -shift;
+      ay >>= -shift;
+    }
+    norm = isqrt(ax * ax + ay * ay);
+    dz = dz * (which == AXIS_X ? ax : ay) / norm;
+  }
+
+  if(which == AXIS_X)
+  {
+    val = fixed_mul(x, mouse_control[device]->fixed_frequency_scale);
+    if(device == current_mouse && (current_cal == DZX || current_cal == DZS))
+    {
+      controller->axis[axis] = val > 0 ? fixed_to_int(dz) : -fixed_to_int(dz);
+      return 0;
+    }
+  }
+  else if(which == AXIS_Y)
+  {
+    val = fixed_mul(y, mouse_control[device]->fixed_frequency_scale);
+    if(device == current_mouse && (current_cal == DZY || current_cal == DZS))
+    {
+      controller->axis[axis] = val > 0 ? fixed_to_int(dz) : -fixed_to_int(dz);
+      return 0;
+    }
+  }
+
+  if(val != 0)
+  {
+    z = fixed_power_get(&response->direct, llabs(val));
+    if(z == 0 && multiplier)
+    {
+      z = 1; //a motion below the resolution still leaves the dead zone
+    }
+    if((val < 0) != (multiplier < 0))
+    {
+      z = -z;
+    }
+    /*
+     * Subtract the first position to the dead zone (useful for high multipliers).
+     */
+    dz = dz - multiplier;
+  }
+
+  if(mode == E_MOUSE_MODE_AIMING)
+  {
+    if(z > 0)
+    {
+      controller->axis[axis] = fixed_to_int(dz + z);
+      /*
+       * max axis position => no residue
+       */
+      if(controller->axis[axis] < max_axis)
+      {
+        ztrunk = ((int64_t) controller->axis[axis] * FIXED_ONE) - dz;
+      }
+    }
+    else if(z < 0)
+    {
+      controller->axis[axis] = fixed_to_int(z - dz);
+      /*
+       * max axis position => no residue
+       */
+      if(controller->axis[axis] > min_axis)
+      {
+        ztrunk = ((int64_t) controller->axis[axis] * FIXED_ONE) + dz;
+      }
+    }
+    else controller->axis[axis] = 0;
+  }
+  else //E_MOUSE_MODE_DRIVING
+  {
+    new_state = fixed_to_int(((int64_t) controller->axis[axis] * FIXED_ONE) + z);
+    if(new_state > 0 && ((int64_t) new_state * FIXED_ONE) < dz)
+    {
+      new_state = fixed_to_int(((int64_t) new_state * FIXED_ONE) - 2 * dz);
+    }
+    if(new_state < 0 && ((int64_t) new_state * FIXED_ONE) > -dz)
+    {
+      new_state = fixed_to_int(((int64_t) new_state * FIXED_ONE) + 2 * dz);
+    }
+    controller->axis[axis] = clamp(min_axis, new_state, max_axis);
+  }
+
+  if(val != 0 && ztrunk != 0 && multiplier > 0)
+  {
+    /*
+     * Compute the motion that wasn't applied due to the integer conversion.
+     */
+    motion_residue = llabs(val) - fixed_power_get(&response->inverse, llabs(ztrunk));
+    if(val < 0)
+    {
+      motion_residue = -motion_residue;
+    }
+    if(llabs(motion_residue) < 256)//allow 256 subpositions
+    {
+      motion_residue = 0;
+    }
+  }
+
+  return motion_residue;
+}
+
 void update_dbutton_axis(s_mapper* mapper, int c_id, int axis)
 {
   s_intensity* intensity = &axis_intensity[c_id][cfg_controllers[c_id].current->index][axis];
@@ -1058,346 +2156,823 @@ void update_ubutton_axis(s_mapper* mapper, int c_id, int axis)
 }
 
 /*
- * Updates the state table.
- * Too long function, but not hard to understand.
+ * Mark a controller as needing a report,
+ * and keep the time of the oldest input that modified its state.
  */
-void cfg_process_event(GE_Event* event)
+static inline void set_send_command(int c_id, GE_Event* event)
+{
+  s_adapter* controller = adapter_get(c_id);
+  adapter_set_send_command(c_id);
+  if(!controller->input_timestamp)
+  {
+    controller->input_timestamp = event->timestamp;
+  }
+}
+
+/*
+ * The bindings of the current profiles of all controllers, indexed by (event kind, device, event id),
+ * so that an event is only compared to the bindings that match it.
+ * For each (event kind, device), the bindings are sorted by event id, and first[id] is the index
+ * of the first binding of an event id (first[id + 1] is the index after the last one).
+ * The bindings of an event id are in the order of the controllers, then in the order of the mapper table.
+ * The index is rebuilt when the configuration is loaded and when a controller switches to another profile.
+ * If the index of a (event kind, device) can't be allocated, the mapper tables of this device are scanned instead.
+ */
+typedef struct
 {
+  unsigned char c_id;
   s_mapper* mapper;
-  int axis;
-  unsigned int config;
-  unsigned int c_id;
-  unsigned int control;
-  int threshold;
-  double multiplier;
+} s_binding;
+
+typedef struct
+{
+  unsigned int nb_ids; //the highest event id + 1, 0 if there is no binding
+  unsigned int* first;
+  s_binding* bindings;
+  int linear; //the index couldn't be allocated, the mapper tables are scanned
+} s_dispatch;
+
+/*
+ * Indexed by mapper kind, the mouse axes excepted (all the mouse axis bindings match a motion).
+ */
+static s_dispatch dispatch[E_MAPPER_NB][MAX_DEVICES] = {};
+
+static inline int get_binding_id(e_mapper_kind kind, s_mapper* mapper)
+{
+  return kind == E_MAPPER_JOYSTICK_AXES ? mapper->axis : mapper->button;
+}
+
+static void dispatch_clean()
+{
+  s_dispatch* d;
+  unsigned int i, j;
+  for(i=0; i<E_MAPPER_NB; ++i)
+  {
+    for(j=0; j<mappers[i].list.nb; ++j)
+    {
+      d = &dispatch[i][mappers[i].list.ids[j]];
+      free(d->first);
+      free(d->bindings);
+      memset(d, 0x00, sizeof(*d));
+    }
+  }
+}
+
+/*
+ * Build the index of a (event kind, device), with a counting sort (which keeps the binding order).
+ */
+static int dispatch_build_device(e_mapper_kind kind, int device)
+{
+  s_dispatch* d = &dispatch[kind][device];
+  s_mapper_table* table;
+  unsigned int nb_bindings = 0;
+  int c_id, control, id;
+  int max_id = -1;
+
+  for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+  {
+    table = get_table(kind, device, c_id, cfg_controllers[c_id].current->index);
+    for(control=0; control<table->nb_mappers; ++control)
+    {
+      id = get_binding_id(kind, table->mappers + control);
+      if(id > max_id)
+      {
+        max_id = id;
+      }
+      ++nb_bindings;
+    }
+  }
+
+  if(max_id < 0)
+  {
+    return 0;
+  }
+
+  d->first = calloc(max_id + 2, sizeof(*d->first));
+  d->bindings = calloc(nb_bindings, sizeof(*d->bindings));
+  if(!d->first || !d->bindings)
+  {
+    fprintf(stderr, "%s:%d calloc failed\n", __FILE__, __LINE__);
+    free(d->first);
+    free(d->bindings);
+    memset(d, 0x00, sizeof(*d));
+    return -1;
+  }
+  d->nb_ids = max_id + 1;
+
+  // count the bindings of each id
+  for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+  {
+    table = get_table(kind, device, c_id, cfg_controllers[c_id].current->index);
+    for(control=0; control<table->nb_mappers; ++control)
+    {
+      id = get_binding_id(kind, table->mappers + control);
+      if(id >= 0)
+      {
+        ++d->first[id + 1];
+      }
+    }
+  }
+  for(id=0; id<=max_id; ++id)
+  {
+    d->first[id + 1] += d->first[id];
+  }
+  // place the bindings, using first[id] as the insertion point, then restore it
+  for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+  {
+    table = get_table(kind, device, c_id, cfg_controllers[c_id].current->index);
+    for(control=0; control<table->nb_mappers; ++control)
+    {
+      id = get_binding_id(kind, table->mappers + control);
+      if(id >= 0)
+      {
+        d->bindings[d->first[id]].c_id = c_id;
+        d->bindings[d->first[id]].mapper = table->mappers + control;
+        ++d->first[id];
+      }
+    }
+  }
+  for(id=max_id; id>0; --id)
+  {
+    d->first[id] = d->first[id - 1];
+  }
+  d->first[0] = 0;
+
+  return 0;
+}
+
+static void dispatch_build()
+{
+  unsigned int i, j;
+
+  dispatch_clean();
+
+  for(i=0; i<E_MAPPER_NB; ++i)
+  {
+    if(i == E_MAPPER_MOUSE_AXES)
+    {
+      continue;
+    }
+    for(j=0; j<mappers[i].list.nb; ++j)
+    {
+      if(dispatch_build_device(i, mappers[i].list.ids[j]) < 0)
+      {
+        fprintf(stderr, _("can't index the bindings of device %d, falling back to a linear search\n"), mappers[i].list.ids[j]);
+        dispatch[i][mappers[i].list.ids[j]].linear = 1;
+      }
+    }
+  }
+}
+
+/*
+ * Apply a mouse motion binding to a controller, in 16.16 fixed point (see --fixed-point).
+ */
+static void process_motion_fixed(unsigned int c_id, s_mapper* mapper, unsigned int device, GE_Event* event, s_mouse_control* mc)
+{
+  s_adapter* controller = adapter_get(c_id);
+  struct fixed_response* response;
+  int64_t mx = 0;
+  int64_t my = 0;
+  int64_t value;
+  int64_t residue;
+  int axis, max_axis, threshold;
+  unsigned int config;
+  e_mouse_mode mode;
+
+  if(mc->change)
+  {
+    mx = mc->fixed->x;
+    my = mc->fixed->y;
+  }
+  set_send_command(c_id, event);
+  axis = mapper->axis_props.axis;
+  if(axis < 0)
+  {
+    return;
+  }
+  if(mapper->multiplier)
+  {
+    /*
+     * Axis to axis.
+     */
+    config = cfg_controllers[c_id].current->index;
+    mode = cal_get_mouse(device, config)->options.mode;
+    response = get_fixed_response(mapper, controller);
+    if(response)
+    {
+      residue = mouse2axis_fixed(device, controller, mapper->axis, mx, my, &mapper->axis_props, mapper->shape, mode, response);
+    }
+    else
+    {
+      /*
+       * No fixed point tables (e.g. the exponent isn't positive): compute the exact response.
+       */
+      residue = llround(mouse2axis(device, controller, mapper->axis, (double) mx / FIXED_ONE, (double) my / FIXED_ONE,
+          &mapper->axis_props, mapper->exponent, mapper->multiplier, mapper->dead_zone, mapper->shape, mode, NULL) * FIXED_ONE);
+    }
+    if(mapper->axis == AXIS_X)
+    {
+      mc->fixed->residue_x = residue;
+    }
+    else if(mapper->axis == AXIS_Y)
+    {
+      mc->fixed->residue_y = residue;
+    }
+  }
+  else
+  {
+    /*
+     * Axis to button.
+     */
+    value = mapper->axis == AXIS_X ? mx : my;
+    max_axis = controller_get_max_signed(controller->type, axis);
+    threshold = mapper->threshold;
+    if(threshold > 0 && value > (int64_t) threshold * FIXED_ONE)
+    {
+      controller->axis[axis] = max_axis;
+    }
+    else if(threshold < 0 && value < (int64_t) threshold * FIXED_ONE)
+    {
+      controller->axis[axis] = max_axis;
+    }
+    else
+    {
+      controller->axis[axis] = 0;
+    }
+  }
+}
+
+/*
+ * Apply a binding to a controller.
+ * Returns 1 if the event was postponed, in which case it must not be processed further, 0 otherwise.
+ */
+static int process_binding(unsigned int c_id, s_mapper* mapper, unsigned int device, GE_Event* event)
+{
+  int axis;
+  unsigned int config;
+  int threshold;
+  double multiplier;
   double exp;
   double dead_zone;
   e_shape shape;
   int value = 0;
   double fvalue = 0;
-  unsigned int nb_controls = 0;
   double mx;
   double my;
-  double residue;
+  double residue = 0;
+  double residue_table;
+  struct response* response;
+  int state, exact = 0;
   s_mouse_control* mc;
   int min_axis, max_axis;
   e_mouse_mode mode;
-  s_adapter* controller;
+  s_adapter* controller = adapter_get(c_id);
 
-  unsigned int device = GE_GetDeviceId(event);
-
-  for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+  switch(event->type)
   {
-    controller = adapter_get(c_id);
-    config = cfg_controllers[c_id].current->index;
-
-    nb_controls = 0;
-
-    switch(event->type)
-    {
-      case GE_JOYBUTTONDOWN:
-      case GE_JOYBUTTONUP:
-      nb_controls = joystick_buttons[device][c_id][config].nb_mappers;
-      break;
-      case GE_JOYAXISMOTION:
-      nb_controls = joystick_axes[device][c_id][config].nb_mappers;
-      break;
-      case GE_KEYDOWN:
-      case GE_KEYUP:
-      nb_controls = keyboard_buttons[device][c_id][config].nb_mappers;
-      break;
-      case GE_MOUSEBUTTONDOWN:
-      case GE_MOUSEBUTTONUP:
-      nb_controls = mouse_buttons[device][c_id][config].nb_mappers;
+    case GE_JOYBUTTONDOWN:
+    case GE_KEYDOWN:
+    case GE_MOUSEBUTTONDOWN:
+      set_send_command(c_id, event);
+      axis = mapper->axis_props.axis;
+      if(axis >= 0)
+      {
+        update_dbutton_axis(mapper, c_id, axis);
+      }
       break;
-      case GE_MOUSEMOTION:
-      nb_controls = mouse_axes[device][c_id][config].nb_mappers;
+    case GE_MOUSEBUTTONUP:
+      /*
+       * Check if this event needs to be postponed.
+       */
+      if(postpone_event(device, event))
+      {
+        return 1; //no need to do something more
+      }
+      //no break
+    case GE_JOYBUTTONUP:
+    case GE_KEYUP:
+      set_send_command(c_id, event);
+      axis = mapper->axis_props.axis;
+      if(axis >= 0)
+      {
+        update_ubutton_axis(mapper, c_id, axis);
+      }
       break;
-    }
-
-    for(control=0; control<nb_controls; ++control)
-    {
-      switch(event->type)
+    case GE_JOYAXISMOTION:
+      set_send_command(c_id, event);
+      axis = mapper->axis_props.axis;
+      if(axis >= 0)
       {
-        case GE_JOYBUTTONDOWN:
-          mapper = joystick_buttons[device][c_id][config].mappers+control;
+        multiplier = mapper->multiplier * controller_get_axis_scale(controller->type, axis);
+        exp = mapper->exponent;
+        dead_zone = mapper->dead_zone * controller_get_axis_scale(controller->type, axis);
+        value = event->jaxis.value;
+        max_axis = controller_get_max_signed(controller->type, axis);
+        if(mapper->axis_props.props == AXIS_PROP_CENTERED)
+        {
+          min_axis = -max_axis;
+        }
+        else
+        {
+          min_axis = 0;
+        }
+        if(multiplier)
+        {
           /*
-           * Check that it's the right button.
+           * Axis to axis.
            */
-          if(mapper->button != event->jbutton.button)
+          if(value)
           {
-            continue;
+            value = value/abs(value)*multiplier*pow(abs(value), exp);
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+          if(value > 0)
           {
-            update_dbutton_axis(mapper, c_id, axis);
+            value += dead_zone;
           }
-          break;
-        case GE_JOYBUTTONUP:
-          mapper = joystick_buttons[device][c_id][config].mappers+control;
+          else if(value < 0)
+          {
+            value -= dead_zone;
+          }
+          controller->axis[axis] = clamp(min_axis, value, max_axis);
+        }
+        else
+        {
           /*
-           * Check that it's the right button.
+           * Axis to button.
            */
-          if(mapper->button != event->jbutton.button)
+          threshold = mapper->threshold;
+          if(threshold > 0 && value > threshold)
           {
-            continue;
+            controller->axis[axis] = max_axis;
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+          else if(threshold < 0 && value < threshold)
           {
-            update_ubutton_axis(mapper, c_id, axis);
+            controller->axis[axis] = max_axis;
           }
-          break;
-        case GE_JOYAXISMOTION:
-          mapper = joystick_axes[device][c_id][config].mappers+control;
+          else
+          {
+            controller->axis[axis] = min_axis;
+          }
+        }
+      }
+      break;
+    case GE_MOUSEMOTION:
+      mc = get_mouse_control(device);
+      if(!mc)
+      {
+        break;
+      }
+      if(gimx_params.fixed_point)
+      {
+        process_motion_fixed(c_id, mapper, device, event, mc);
+        break;
+      }
+      if(mc->change)
+      {
+        mx = mc->x;
+        my = mc->y;
+      }
+      else
+      {
+        mx = 0;
+        my = 0;
+      }
+      set_send_command(c_id, event);
+      axis = mapper->axis_props.axis;
+      if(axis >= 0)
+      {
+        multiplier = mapper->multiplier;
+        if(multiplier)
+        {
           /*
-           * Check that it's the right axis.
+           * Axis to axis.
            */
-          if(mapper->axis != event->jaxis.axis)
+          exp = mapper->exponent;
+          dead_zone = mapper->dead_zone;
+          shape = mapper->shape;
+          config = cfg_controllers[c_id].current->index;
+          mode = cal_get_mouse(device, config)->options.mode;
+          response = get_response(mapper);
+          if(response && gimx_params.response_check)
           {
-            continue;
+            state = controller->axis[axis];
+            residue = mouse2axis(device, controller, mapper->axis, mx, my, &mapper->axis_props, exp, multiplier, dead_zone, shape, mode, NULL);
+            exact = controller->axis[axis];
+            controller->axis[axis] = state;
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+          residue_table = mouse2axis(device, controller, mapper->axis, mx, my, &mapper->axis_props, exp, multiplier, dead_zone, shape, mode, response);
+          if(response && gimx_params.response_check)
           {
-            multiplier = mapper->multiplier * controller_get_axis_scale(controller->type, axis);
-            exp = mapper->exponent;
-            dead_zone = mapper->dead_zone * controller_get_axis_scale(controller->type, axis);
-            value = event->jaxis.value;
-            max_axis = controller_get_max_signed(controller->type, axis);
-            if(mapper->axis_props.props == AXIS_PROP_CENTERED)
-            {
-              min_axis = -max_axis;
-            }
-            else
+            ++response_check.evaluations;
+            if(controller->axis[axis] != exact)
             {
-              min_axis = 0;
-            }
-            if(multiplier)
-            {
-              /*
-               * Axis to axis.
-               */
-              if(value)
-              {
-                value = value/abs(value)*multiplier*pow(abs(value), exp);
-              }
-              if(value > 0)
+              ++response_check.differences;
+              if(abs(controller->axis[axis] - exact) > response_check.max_error)
               {
-                value += dead_zone;
+                response_check.max_error = abs(controller->axis[axis] - exact);
               }
-              else if(value < 0)
-              {
-                value -= dead_zone;
-              }
-              controller->axis[axis] = clamp(min_axis, value, max_axis);
             }
-            else
+            if(fabs(residue_table - residue) > response_check.max_residue_error)
             {
-              /*
-               * Axis to button.
-               */
-              threshold = mapper->threshold;
-              if(threshold > 0 && value > threshold)
-              {
-                controller->axis[axis] = max_axis;
-              }
-              else if(threshold < 0 && value < threshold)
-              {
-                controller->axis[axis] = max_axis;
-              }
-              else
-              {
-                controller->axis[axis] = min_axis;
-              }
+              response_check.max_residue_error = fabs(residue_table - residue);
             }
           }
-          break;
-        case GE_KEYDOWN:
-          mapper = keyboard_buttons[device][c_id][config].mappers+control;
-          /*
-           * Check that it's the right button.
-           */
-          if(mapper->button != event->key.keysym)
-          {
-            continue;
-          }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
-          {
-            update_dbutton_axis(mapper, c_id, axis);
-          }
-          break;
-        case GE_KEYUP:
-          mapper = keyboard_buttons[device][c_id][config].mappers+control;
-          /*
-           * Check that it's the right button.
-           */
-          if(mapper->button != event->key.keysym)
+          residue = residue_table;
+          if(mapper->axis == AXIS_X)
           {
-            continue;
+            mc->residue_x = residue;
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+          else if(mapper->axis == AXIS_Y)
           {
-            update_ubutton_axis(mapper, c_id, axis);
+            mc->residue_y = residue;
           }
-          break;
-        case GE_MOUSEMOTION:
-          mapper = mouse_axes[device][c_id][config].mappers+control;
-          mc = mouse_control + device;
-          if(mc->change)
+        }
+        else
+        {
+          if (mapper->axis == AXIS_X)
           {
-            mx = mc->x;
-            my = mc->y;
+            fvalue = mx;
           }
           else
           {
-            mx = 0;
-            my = 0;
-          }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
-          {
-            multiplier = mapper->multiplier;
-            if(multiplier)
-            {
-              /*
-               * Axis to axis.
-               */
-              exp = mapper->exponent;
-              dead_zone = mapper->dead_zone;
-              shape = mapper->shape;
-              mode = cal_get_mouse(device, config)->options.mode;
-              residue = mouse2axis(device, controller, mapper->axis, mx, my, &mapper->axis_props, exp, multiplier, dead_zone, shape, mode);
-              if(mapper->axis == AXIS_X)
-              {
-                mc->residue_x = residue;
-              }
-              else if(mapper->axis == AXIS_Y)
-              {
-                mc->residue_y = residue;
-              }
-            }
-            else
-            {
-              if (mapper->axis == AXIS_X)
-              {
-                fvalue = mx;
-              }
-              else
-              {
-                fvalue = my;
-              }
-              /*
-               * Axis to button.
-               */
-              max_axis = controller_get_max_signed(controller->type, axis);
-              threshold = mapper->threshold;
-              if(threshold > 0 && fvalue > threshold)
-              {
-                controller->axis[axis] = max_axis;
-              }
-              else if(threshold < 0 && fvalue < threshold)
-              {
-                controller->axis[axis] = max_axis;
-              }
-              else
-              {
-                controller->axis[axis] = 0;
-              }
-            }
+            fvalue = my;
           }
-          break;
-        case GE_MOUSEBUTTONDOWN:
-          mapper = mouse_buttons[device][c_id][config].mappers+control;
           /*
-           * Check that it's the right button.
+           * Axis to button.
            */
-          if(mapper->button != event->button.button)
+          max_axis = controller_get_max_signed(controller->type, axis);
+          threshold = mapper->threshold;
+          if(threshold > 0 && fvalue > threshold)
           {
-            continue;
+            controller->axis[axis] = max_axis;
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+          else if(threshold < 0 && fvalue < threshold)
           {
-            update_dbutton_axis(mapper, c_id, axis);
+            controller->axis[axis] = max_axis;
           }
-          break;
-        case GE_MOUSEBUTTONUP:
-          mapper = mouse_buttons[device][c_id][config].mappers+control;
-          /*
-           * Check that it's the right button.
-           */
-          if(mapper->button != event->button.button)
+          else
           {
-            continue;
+            controller->axis[axis] = 0;
           }
-          /*
-           * Check if this event needs to be postponed.
-           */
-          if(postpone_event(device, event))
+        }
+      }
+      break;
+  }
+
+  return 0;
+}
+
+/*
+ * Updates the state table.
+ */
+void cfg_process_event(GE_Event* event)
+{
+  unsigned int c_id;
+  unsigned int control;
+  unsigned int config;
+  s_mapper_table* table;
+  s_dispatch* d;
+  e_mapper_kind kind;
+  unsigned int id;
+  unsigned int i;
+
+  unsigned int device = GE_GetDeviceId(event);
+
+  switch(event->type)
+  {
+    case GE_MOUSEMOTION:
+      /*
+       * All the mouse axis bindings match a motion.
+       */
+      for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+      {
+        config = cfg_controllers[c_id].current->index;
+        table = cfg_get_mouse_axes(device, c_id, config);
+        for(control=0; control<table->nb_mappers; ++control)
+        {
+          process_binding(c_id, table->mappers + control, device, event);
+        }
+      }
+      return;
+    case GE_JOYBUTTONDOWN:
+    case GE_JOYBUTTONUP:
+      kind = E_MAPPER_JOYSTICK_BUTTONS;
+      id = event->jbutton.button;
+      break;
+    case GE_JOYAXISMOTION:
+      kind = E_MAPPER_JOYSTICK_AXES;
+      id = event->jaxis.axis;
+      break;
+    case GE_KEYDOWN:
+    case GE_KEYUP:
+      kind = E_MAPPER_KEYBOARD_BUTTONS;
+      id = event->key.keysym;
+      break;
+    case GE_MOUSEBUTTONDOWN:
+    case GE_MOUSEBUTTONUP:
+      kind = E_MAPPER_MOUSE_BUTTONS;
+      id = event->button.button;
+      break;
+    default:
+      return;
+  }
+
+  d = &dispatch[kind][device];
+
+  if(d->linear)
+  {
+    for(c_id=0; c_id<MAX_CONTROLLERS; ++c_id)
+    {
+      config = cfg_controllers[c_id].current->index;
+      table = get_table(kind, device, c_id, config);
+      for(control=0; control<table->nb_mappers; ++control)
+      {
+        if(get_binding_id(kind, table->mappers + control) == (int) id
+            && process_binding(c_id, table->mappers + control, device, event))
+        {
+          return;
+        }
+      }
+    }
+    return;
+  }
+
+  if(id >= d->nb_ids)
+  {
+    return;
+  }
+
+  for(i=d->first[id]; i<d->first[id + 1]; ++i)
+  {
+    if(process_binding(d->bindings[i].c_id, d->bindings[i].mapper, device, event))
+    {
+      return;
+    }
+  }
+}
+
+void cfg_clean()
+{
+  s_device_mappers* dm;
+  unsigned int i, l;
+  int j, k, m;
+  dispatch_clean();
+  for(i=0; i<E_MAPPER_NB; ++i)
+  {
+    for(l=0; l<mappers[i].list.nb; ++l)
+    {
+      dm = mappers[i].devices[mappers[i].list.ids[l]];
+      for(j=0; j<MAX_CONTROLLERS; ++j)
+      {
+        for(k=0; k<MAX_CONFIGURATIONS; ++k)
+        {
+          for(m=0; m<dm->tables[j][k].nb_mappers; ++m)
+          {
+            if(dm->tables[j][k].mappers[m].response)
+            {
+              free(dm->tables[j][k].mappers[m].response->fixed);
+            }
+            free(dm->tables[j][k].mappers[m].response);
+          }
+          free(dm->tables[j][k].mappers);
+        }
+      }
+      free(dm);
+      mappers[i].devices[mappers[i].list.ids[l]] = NULL;
+    }
+    mappers[i].list.nb = 0;
+  }
+  for(l=0; l<mouse_list.nb; ++l)
+  {
+    free(mouse_control[mouse_list.ids[l]]->fixed);
+    free(mouse_control[mouse_list.ids[l]]);
+    mouse_control[mouse_list.ids[l]] = NULL;
+  }
+  mouse_list.nb = 0;
+  active_mice.nb = 0;
+}
+
+static void allow_button(int device_type, int device_id, int button)
+{
+  if(device_id < 0 || button < 0)
+  {
+    return;
+  }
+
+  switch(device_type)
+  {
+    case E_DEVICE_TYPE_KEYBOARD:
+      GE_AllowEvent(GE_KEYDOWN, device_id, button);
+      break;
+    case E_DEVICE_TYPE_MOUSE:
+      GE_AllowEvent(GE_MOUSEBUTTONDOWN, device_id, button);
+      break;
+    case E_DEVICE_TYPE_JOYSTICK:
+      GE_AllowEvent(GE_JOYBUTTONDOWN, device_id, button);
+      break;
+  }
+}
+
+/*
+ * Allow the events that are referenced by the bindings, the profile triggers,
+ * and the intensity modifiers, so that the other ones are dropped by the input devices.
+ */
+void cfg_filter_events()
+{
+  s_mapper_table* table;
+  s_intensity* intensity;
+  s_event* trigger;
+  static const unsigned char types[E_MAPPER_NB] =
+  {
+    [E_MAPPER_KEYBOARD_BUTTONS] = GE_KEYDOWN,
+    [E_MAPPER_MOUSE_BUTTONS] = GE_MOUSEBUTTONDOWN,
+    [E_MAPPER_JOYSTICK_BUTTONS] = GE_JOYBUTTONDOWN,
+    [E_MAPPER_JOYSTICK_AXES] = GE_JOYAXISMOTION,
+  };
+  unsigned int i, m;
+  int device, j, k, l;
+  for(i=0; i<E_MAPPER_NB; ++i)
+  {
+    if(i == E_MAPPER_MOUSE_AXES)
+    {
+      continue;
+    }
+    for(m=0; m<mappers[i].list.nb; ++m)
+    {
+      device = mappers[i].list.ids[m];
+      for(j=0; j<MAX_CONTROLLERS; ++j)
+      {
+        for(k=0; k<MAX_CONFIGURATIONS; ++k)
+        {
+          table = get_table(i, device, j, k);
+          for(l=0; l<table->nb_mappers; ++l)
           {
-            return; //no need to do something more
+            GE_AllowEvent(types[i], device, get_binding_id(i, table->mappers + l));
           }
-          controller->send_command = 1;
-          axis = mapper->axis_props.axis;
-          if(axis >= 0)
+        }
+      }
+    }
+  }
+  for(j=0; j<MAX_CONTROLLERS; ++j)
+  {
+    for(k=0; k<MAX_CONFIGURATIONS; ++k)
+    {
+      trigger = &cfg_controllers[j].profiles[k].trigger.event;
+      allow_button(trigger->device_type, trigger->device_id, trigger->button);
+      for(l=0; l<AXIS_MAX; ++l)
+      {
+        intensity = cfg_get_axis_intensity(j, k, l);
+        allow_button(intensity->device_up_type, intensity->device_up_id, intensity->up_button);
+        allow_button(intensity->device_down_type, intensity->device_down_id, intensity->down_button);
+      }
+    }
+  }
+}
+
+/*
+ * The smallest page size.
+ */
+#define PREFAULT_STEP 4096
+
+/*
+ * Touch each page of a memory area, so that it is mapped before it is used.
+ */
+static unsigned int prefault(void* ptr, size_t size)
+{
+  volatile char* p = ptr;
+  size_t i;
+
+  for(i = 0; i < size; i += PREFAULT_STEP)
+  {
+    p[i] = p[i];
+  }
+  if(size)
+  {
+    p[size - 1] = p[size - 1];
+  }
+
+  return size;
+}
+
+static unsigned int prefault_mappers(s_device_mappers* dm)
+{
+  unsigned int size = prefault(dm, sizeof(*dm));
+  int j, k, m;
+
+  for(j = 0; j < MAX_CONTROLLERS; ++j)
+  {
+    for(k = 0; k < MAX_CONFIGURATIONS; ++k)
+    {
+      size += prefault(dm->tables[j][k].mappers, dm->tables[j][k].nb_mappers * sizeof(*dm->tables[j][k].mappers));
+      for(m = 0; m < dm->tables[j][k].nb_mappers; ++m)
+      {
+        if(dm->tables[j][k].mappers[m].response)
+        {
+          size += prefault(dm->tables[j][k].mappers[m].response, sizeof(struct response));
+          if(dm->tables[j][k].mappers[m].response->fixed)
           {
-            update_ubutton_axis(mapper, c_id, axis);
+            size += prefault(dm->tables[j][k].mappers[m].response->fixed, sizeof(struct fixed_response));
           }
-          break;
+        }
       }
     }
   }
+
+  return size;
 }
 
-void cfg_clean()
+/*
+ * \brief Pre-fault the mapping tables and the bindings of the configuration,
+ *        so that the first events don't trigger page faults.
+ *
+ * \return the number of bytes that were touched.
+ */
+unsigned int cfg_prefault()
 {
-  s_mapper_table* table;
-  int i, j, k;
-  for(i=0; i<MAX_DEVICES; ++i)
+  unsigned int size = 0;
+  unsigned int i, l;
+
+  size += prefault(cfg_controllers, sizeof(cfg_controllers));
+  size += prefault(axis_intensity, sizeof(axis_intensity));
+
+  for(l = 0; l < mouse_list.nb; ++l)
   {
-    for(j=0; j<MAX_CONTROLLERS; ++j)
+    size += prefault(mouse_control[mouse_list.ids[l]], sizeof(*mouse_control[mouse_list.ids[l]]));
+    if(mouse_control[mouse_list.ids[l]]->fixed)
     {
-      for(k=0; k<MAX_CONFIGURATIONS; ++k)
+      size += prefault(mouse_control[mouse_list.ids[l]]->fixed, sizeof(*mouse_control[mouse_list.ids[l]]->fixed));
+    }
+  }
+
+  for(i = 0; i < E_MAPPER_NB; ++i)
+  {
+    for(l = 0; l < mappers[i].list.nb; ++l)
+    {
+      size += prefault_mappers(mappers[i].devices[mappers[i].list.ids[l]]);
+    }
+  }
+
+  return size;
+}
+
+/*
+ * \brief Print the memory that is used by the mapping tables, the bindings, and the mouse controls.
+ */
+void cfg_memory_report()
+{
+  static const char* names[E_MAPPER_NB] =
+  {
+    [E_MAPPER_KEYBOARD_BUTTONS] = "keyboard buttons",
+    [E_MAPPER_MOUSE_BUTTONS] = "mouse buttons",
+    [E_MAPPER_MOUSE_AXES] = "mouse axes",
+    [E_MAPPER_JOYSTICK_BUTTONS] = "joystick buttons",
+    [E_MAPPER_JOYSTICK_AXES] = "joystick axes",
+  };
+  s_device_mappers* dm;
+  unsigned int i, l;
+  unsigned int nb_mappers;
+  size_t size;
+  size_t total = 0;
+  int j, k;
+
+  gprintf(_("configuration memory:\n"));
+
+  for(i = 0; i < E_MAPPER_NB; ++i)
+  {
+    nb_mappers = 0;
+    size = 0;
+    for(l = 0; l < mappers[i].list.nb; ++l)
+    {
+      dm = mappers[i].devices[mappers[i].list.ids[l]];
+      size += sizeof(*dm);
+      for(j = 0; j < MAX_CONTROLLERS; ++j)
       {
-        table = cfg_get_keyboard_buttons(i, j, k);
-        free(table->mappers);
-        table->mappers = NULL;
-        table->nb_mappers = 0;
-        table = cfg_get_mouse_buttons(i, j, k);
-        free(table->mappers);
-        table->mappers = NULL;
-        table->nb_mappers = 0;
-        table = cfg_get_mouse_axes(i, j, k);
-        free(table->mappers);
-        table->mappers = NULL;
-        table->nb_mappers = 0;
-        table = cfg_get_joystick_buttons(i, j, k);
-        free(table->mappers);
-        table->mappers = NULL;
-        table->nb_mappers = 0;
-        table = cfg_get_joystick_axes(i, j, k);
-        free(table->mappers);
-        table->mappers = NULL;
-        table->nb_mappers = 0;
+        for(k = 0; k < MAX_CONFIGURATIONS; ++k)
+        {
+          nb_mappers += dm->tables[j][k].nb_mappers;
+        }
       }
     }
+    size += nb_mappers * sizeof(s_mapper);
+    gprintf(_("  %s: %u device(s), %u binding(s), %zu bytes\n"), names[i], mappers[i].list.nb, nb_mappers, size);
+    total += size;
+  }
+
+  size = mouse_list.nb * sizeof(s_mouse_control);
+  if(gimx_params.fixed_point)
+  {
+    size += mouse_list.nb * sizeof(s_mouse_fixed);
   }
+  gprintf(_("  mouse controls: %u mouse(s), %zu bytes\n"), mouse_list.nb, size);
+  total += size;
+
+  gprintf(_("  total: %zu kB\n"), (total + 1023) / 1024);
 }
 
 void cfg_read_calibration()
 {
   int i, j, k;
+  unsigned int l;
   s_mapper_table* table;
   s_mapper* p_mapper;
   s_mouse_cal* mcal;
@@ -1405,8 +2980,9 @@ void cfg_read_calibration()
 
   current_mouse = -1;
 
-  for(i=0; i<MAX_DEVICES; ++i)
+  for(l=0; l<mappers[E_MAPPER_MOUSE_AXES].list.nb; ++l)
   {
+    i = mappers[E_MAPPER_MOUSE_AXES].list.ids[l];
     found = 0;
     for(j=0; j<MAX_CONTROLLERS && !found; ++j)
     {
@@ -101,8 +101,16 @@ static int GetDeviceId(xmlNode* a_node)
       }
       if(i == MAX_DEVICES || !GE_JoystickName(i))
       {
-        gprintf(_("joystick not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
-        ret = 1;
+        // With hotplug, the binding applies once the device gets connected.
+        if((i = GE_ReserveDevice(GE_DEVICE_JOYSTICK, r_device_name, entry.device.id)) >= 0)
+        {
+          entry.device.id = i;
+        }
+        else
+        {
+          gprintf(_("joystick not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
+          ret = 1;
+        }
       }
     }
     else if(GE_GetMKMode() == GE_MK_MODE_SINGLE_INPUT)
@@ -134,8 +142,16 @@ static int GetDeviceId(xmlNode* a_node)
         }
         if(i == MAX_DEVICES || !GE_MouseName(i))
         {
-          gprintf(_("mouse not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
-          ret = 1;
+          // With hotplug, the binding applies once the device gets connected.
+          if((i = GE_ReserveDevice(GE_DEVICE_MOUSE, r_device_name, entry.device.id)) >= 0)
+          {
+            entry.device.id = i;
+          }
+          else
+          {
+            gprintf(_("mouse not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
+            ret = 1;
+          }
         }
       }
       else if(entry.device.type == E_DEVICE_TYPE_KEYBOARD)
@@ -153,8 +169,16 @@ static int GetDeviceId(xmlNode* a_node)
         }
         if(i == MAX_DEVICES || !GE_KeyboardName(i))
         {
-          gprintf(_("keyboard not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
-          ret = 1;
+          // With hotplug, the binding applies once the device gets connected.
+          if((i = GE_ReserveDevice(GE_DEVICE_KEYBOARD, r_device_name, entry.device.id)) >= 0)
+          {
+            entry.device.id = i;
+          }
+          else
+          {
+            gprintf(_("keyboard not found: %s %d\n"), _UTF8_to_8BIT(r_device_name), entry.device.id);
+            ret = 1;
+          }
         }
       }
     }
@@ -852,6 +876,13 @@ static int ProcessMouseOptionsListElement(xmlNode * a_node)
                 if(ret != -1)
                 {
                   cal_set_mouse(&entry);
+
+                  unsigned int dpi;
+                  /* optional */
+                  if(entry.device.id >= 0 && GetUnsignedIntProp(cur_node, X_ATTR_DPI, &dpi) != -1)
+                  {
+                    cfg_set_mouse_dpi(entry.device.id, entry.controller_id, dpi);
+                  }
                 }
               }
             }
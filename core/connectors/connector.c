@@ -16,6 +16,8 @@
 #include <report.h>
 #include "display.h"
 #include "stats.h"
+#include "latency.h"
+#include "scheduler.h"
 #include "connectors/sixaxis.h"
 #ifndef WIN32
 #include "connectors/btds4.h"
@@ -259,6 +261,7 @@ int connector_init()
       }
     }
   }
+  adapter_update_active();
   return ret;
 }
 
@@ -313,116 +316,140 @@ void connector_clean()
   }
 }
 
+/*
+ * Send a report for each controller that changed, or for each active controller if updates are forced.
+ * A controller that is not due yet stays dirty until its next period.
+ */
 int connector_send()
 {
   int ret = 0;
   int i;
   s_adapter* adapter;
+  unsigned int pending = adapter_get_dirty();
 
-  for(i=0; i<MAX_CONTROLLERS; ++i)
+  if (gimx_params.force_updates)
+  {
+    pending |= adapter_get_active();
+  }
+
+  while(pending)
   {
+    i = __builtin_ctz(pending);
+    pending &= pending - 1;
+
     adapter = adapter_get(i);
 
-    if (gimx_params.force_updates || adapter->send_command)
+    if (!scheduler_is_due(i))
     {
-      if(adapter->dst_fd >= 0)
-      {
-        static unsigned char report[sizeof(adapter->axis)+2] = { BYTE_IN_REPORT, sizeof(adapter->axis) };
-        memcpy(report+2, adapter->axis, sizeof(adapter->axis));
-        ret = udp_send(adapter->dst_fd, report, sizeof(report));
-      }
-      else
-      {
-        unsigned int index = report_build(adapter->type, adapter->axis, adapter->report);
+      continue;
+    }
+
+    if(adapter->dst_fd >= 0)
+    {
+      static unsigned char report[sizeof(adapter->axis)+2] = { BYTE_IN_REPORT, sizeof(adapter->axis) };
+      memcpy(report+2, adapter->axis, sizeof(adapter->axis));
+      ret = udp_send(adapter->dst_fd, report, sizeof(report));
+    }
+    else
+    {
+      unsigned int index = adapter_build_report(i);
 
-        s_report_packet* report = adapter->report+index;
+      s_report_packet* report = adapter->report+index;
 
-        switch(adapter->type)
+      switch(adapter->type)
+      {
+      case C_TYPE_DEFAULT:
+        if(adapter->bdaddr_dst)
         {
-        case C_TYPE_DEFAULT:
-          if(adapter->bdaddr_dst)
-          {
-            ret = sixaxis_send_interrupt(i, &report->value.ds3);
-          }
-          break;
-        case C_TYPE_SIXAXIS:
-          if(adapter->portname)
-          {
-            ret = serial_send(i, report, 2+report->length);
-          }
-          else if(adapter->bdaddr_dst)
-          {
-            ret = sixaxis_send_interrupt(i, &report->value.ds3);
-          }
-          break;
-        case C_TYPE_DS4:
-          if(adapter->portname)
-          {
-            report->value.ds4.report_id = DS4_USB_HID_IN_REPORT_ID;
-            report->length = DS4_USB_INTERRUPT_PACKET_SIZE;
-            ret = serial_send(i, report, HEADER_SIZE+report->length);
-          }
+          ret = sixaxis_send_interrupt(i, &report->value.ds3);
+        }
+        break;
+      case C_TYPE_SIXAXIS:
+        if(adapter->portname)
+        {
+          ret = serial_send_async(i, report, 2+report->length);
+        }
+        else if(adapter->bdaddr_dst)
+        {
+          ret = sixaxis_send_interrupt(i, &report->value.ds3);
+        }
+        break;
+      case C_TYPE_DS4:
+        if(adapter->portname)
+        {
+          report->value.ds4.report_id = DS4_USB_HID_IN_REPORT_ID;
+          report->length = DS4_USB_INTERRUPT_PACKET_SIZE;
+          ret = serial_send_async(i, report, HEADER_SIZE+report->length);
+        }
 #ifndef WIN32
-          else if(adapter->bdaddr_dst)
-          {
-            ret = btds4_send_interrupt(i, &report->value.ds4, adapter->send_command);
-          }
+        else if(adapter->bdaddr_dst)
+        {
+          ret = btds4_send_interrupt(i, &report->value.ds4, adapter->send_command);
+        }
 #endif
-          break;
-        case C_TYPE_T300RS_PS4:
-          if(adapter->portname)
+        break;
+      case C_TYPE_T300RS_PS4:
+        if(adapter->portname)
+        {
+          report->length = DS4_USB_INTERRUPT_PACKET_SIZE;
+          ret = serial_send_async(i, report, HEADER_SIZE+report->length);
+        }
+        break;
+      case C_TYPE_GPP:
+        ret = gpp_send(i, adapter->type, adapter->axis);
+        break;
+      case C_TYPE_XONE_PAD:
+        if(adapter->status)
+        {
+          ret = serial_send_async(i, report, HEADER_SIZE+report->length);
+        }
+        break;
+      default:
+        if(adapter->portname)
+        {
+          if(adapter->type != C_TYPE_PS2_PAD)
           {
-            report->length = DS4_USB_INTERRUPT_PACKET_SIZE;
-            ret = serial_send(i, report, HEADER_SIZE+report->length);
+            ret = serial_send_async(i, report, HEADER_SIZE+report->length);
           }
-          break;
-        case C_TYPE_GPP:
-          ret = gpp_send(i, adapter->type, adapter->axis);
-          break;
-        case C_TYPE_XONE_PAD:
-          if(adapter->status)
+          else
           {
-            ret = serial_send(i, report, HEADER_SIZE+report->length);
+            ret = serial_send_async(i, &report->value.ds2, report->length);
           }
-          break;
-        default:
-          if(adapter->portname)
-          {
-            if(adapter->type != C_TYPE_PS2_PAD)
-            {
-              ret = serial_send(i, report, HEADER_SIZE+report->length);
-            }
-            else
-            {
-              ret = serial_send(i, &report->value.ds2, report->length);
-            }
-          }
-          break;
         }
+        break;
       }
+    }
 
-      if(gimx_params.curses)
+    if(adapter->input_timestamp)
+    {
+      if(gimx_params.latency)
       {
-        stats_update(i);
+        latency_record(i, adapter->input_timestamp);
       }
+      adapter->input_timestamp = 0;
+    }
 
-      if (adapter->send_command)
+    if(gimx_params.curses)
+    {
+      stats_update(i);
+    }
+
+    if (adapter->send_command)
+    {
+      if(gimx_params.status)
       {
-        if(gimx_params.status)
-        {
-          adapter_dump_state(i);
+        adapter_dump_state(i);
 #ifdef WIN32
-          //There is no setlinebuf(stdout) in windows.
-          fflush(stdout);
+        //There is no setlinebuf(stdout) in windows.
+        fflush(stdout);
 #endif
-        }
-        if(gimx_params.curses)
-        {
-          display_run(adapter_get(0)->type, adapter_get(0)->axis);
-        }
-
-        adapter->send_command = 0;
       }
+      if(gimx_params.curses)
+      {
+        display_run(adapter_get(0)->type, adapter_get(0)->axis);
+      }
+
+      adapter_clear_send_command(i);
     }
   }
   return ret;
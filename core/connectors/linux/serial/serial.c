@@ -25,6 +25,7 @@
 #include <errno.h>
 
 #include <adapter.h>
+#include <GE.h>
 
 /*
  * The baud rate in bps.
@@ -194,6 +195,39 @@ int serial_send(int id, void* pdata, unsigned int size)
   return ret;
 }
 
+/*
+ * \brief Send data to the serial port, without waiting for the write to complete.
+ *        The write is performed by the next GE_PumpEvents call (see GE_WriteAsync).
+ *        If asynchronous writes are not available, the data is sent right away.
+ *        If the write queue is full, the data is dropped, as sending it right away
+ *        would reorder the reports. The next report carries the latest state.
+ *
+ * \param id     the serial port instance
+ * \param pdata  a pointer to the data to send
+ * \param size   the size in bytes of the data to send
+ *
+ * \return the number of bytes to be written (0 if the data is dropped),
+ *         or -1 in case of an error, including the failure of a previous write
+ */
+int serial_send_async(int id, void* pdata, unsigned int size)
+{
+  if(!GE_WriteAsync(serials[id].fd, pdata, size))
+  {
+    return size;
+  }
+
+  if(errno == EAGAIN)
+  {
+    return 0;
+  }
+  else if(errno == ENOTSUP)
+  {
+    return serial_send(id, pdata, size);
+  }
+
+  return -1;
+}
+
 /*
  * \brief This function tries to read 'size' bytes of data.
  *
@@ -255,6 +289,7 @@ int serial_close(int id)
 {
   if(serials[id].fd >= 0)
   {
+    GE_RemoveSource(serials[id].fd);//this also drops the pending asynchronous writes
     usleep(10000);//sleep 10ms to leave enough time for the last packet to be sent
     close(serials[id].fd);
     serials[id].fd = -1;
@@ -257,7 +257,7 @@ void ds42event(int adapter_id, s_report* current, s_report* previous,
       // remember to send a report if the touchpad status changed
       if(send_command)
       {
-        adapter->send_command = 1;
+        adapter_set_send_command(adapter_id);
       }
     }
   }
@@ -557,7 +557,7 @@ static int read_control(int sixaxis_number)
     {
       fprintf(stderr, "sixaxis shutdown\n");
       ret = 1;
-      adapter_get(sixaxis_number)->send_command = 1;
+      adapter_set_send_command(sixaxis_number);
     }
   }
 
@@ -576,7 +576,7 @@ static int close_control(int sixaxis_number)
   }
 
   state->sys.shutdown = 1;
-  adapter_get(sixaxis_number)->send_command = 1;
+  adapter_set_send_command(sixaxis_number);
 
   return 1;
 }
@@ -616,7 +616,7 @@ static int close_interrupt(int sixaxis_number)
   }
 
   state->sys.shutdown = 1;
-  adapter_get(sixaxis_number)->send_command = 1;
+  adapter_set_send_command(sixaxis_number);
 
   return 1;
 }
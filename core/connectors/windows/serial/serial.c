@@ -172,6 +172,20 @@ int serial_send(int id, void* pdata, unsigned int size)
   return dwBytesWritten;
 }
 
+/*
+ * \brief Send data to the serial port. Asynchronous writes are not available in Windows.
+ *
+ * \param id     the serial port instance
+ * \param pdata  a pointer to the data to send
+ * \param size   the size in bytes of the data to send
+ *
+ * \return the number of bytes actually written, or -1 in case of an error
+ */
+int serial_send_async(int id, void* pdata, unsigned int size)
+{
+  return serial_send(id, pdata, size);
+}
+
 /*
  * \brief This function tries to read 'size' bytes of data.
  *
@@ -33,6 +33,8 @@
 #include "args.h"
 #include <adapter.h>
 #include <stats.h>
+#include <latency.h>
+#include <scheduler.h>
 #include <pcprog.h>
 #include "../directories.h"
 
@@ -53,6 +55,22 @@ s_gimx_params gimx_params =
   .subpositions = 0,
   .window_events = 0,
   .btstack = 0,
+  .latency = 0,
+  .catch_up = 0,
+  .late_sampling = 0,
+  .input_thread = 0,
+  .io_uring = 0,
+  .hotplug = 0,
+  .coalesce_axes = 0,
+  .no_event_filter = 0,
+  .recursive_filter = 0,
+  .response_tables = 0,
+  .response_check = 0,
+  .fixed_point = 0,
+  .event_queue = 0,
+  .realtime = 0,
+  .cpus = NULL,
+  .io_cpus = NULL,
 };
 
 #ifdef WIN32
@@ -83,52 +101,25 @@ void terminate(int sig)
   set_done();
 }
 
-int ignore_event(GE_Event* event)
-{
-  return 0;
-}
-
-int process_event(GE_Event* event)
+/*
+ * Report the input devices that get connected or disconnected (--hotplug).
+ */
+static void hotplug_callback(GE_DeviceType type, int id, int connected)
 {
-  switch (event->type)
-  {
-    case GE_MOUSEMOTION:
-      cfg_process_motion_event(event);
-      break;
-    case GE_JOYRUMBLE:
-      cfg_process_rumble_event(event);
-      break;
-    default:
-      if (!cal_skip_event(event))
-      {
-        cfg_process_event(event);
-      }
-      break;
-  }
-
-  //make sure to process the event before these two lines
-  cfg_trigger_lookup(event);
-  cfg_intensity_lookup(event);
+  const char* state = connected ? _("connected") : _("disconnected");
 
-  switch (event->type)
+  switch(type)
   {
-    case GE_MOUSEBUTTONDOWN:
-      cal_button(event->button.which, event->button.button);
+    case GE_DEVICE_KEYBOARD:
+      gprintf(_("keyboard %s: %s %d\n"), state, GE_KeyboardName(id), GE_KeyboardVirtualId(id));
       break;
-    case GE_KEYDOWN:
-      cal_key(event->key.which, event->key.keysym, 1);
+    case GE_DEVICE_MOUSE:
+      gprintf(_("mouse %s: %s %d\n"), state, GE_MouseName(id), GE_MouseVirtualId(id));
       break;
-    case GE_KEYUP:
-      cal_key(event->key.which, event->key.keysym, 0);
+    case GE_DEVICE_JOYSTICK:
+      gprintf(_("joystick %s: %s %d\n"), state, GE_JoystickName(id), GE_JoystickVirtualId(id));
       break;
   }
-
-  if(event->type != GE_MOUSEMOTION)
-  {
-    macro_lookup(event);
-  }
-
-  return 0;
 }
 
 int main(int argc, char *argv[])
@@ -193,26 +184,29 @@ int main(int argc, char *argv[])
     bt_abs_value = E_BT_ABS_BTSTACK;
   }
 
+  /*
+   * This has to be done before the connectors add their sources.
+   */
+  if(gimx_params.io_uring && GE_SetIOUring() < 0)
+  {
+    fprintf(stderr, _("io_uring is not available, using epoll\n"));
+  }
+
   if(connector_init() < 0)
   {
     fprintf(stderr, _("connector_init failed\n"));
     goto QUIT;
   }
 
-  if(gimx_params.refresh_period == -1)
-  {
-    /*
-     * TODO MLA: per controller refresh period?
-     */
-    gimx_params.refresh_period = controller_get_default_refresh_period(adapter_get(0)->type);
-    gimx_params.postpone_count = 3 * DEFAULT_REFRESH_PERIOD / gimx_params.refresh_period;
-    printf(_("using default refresh period: %.02fms\n"), (double)gimx_params.refresh_period/1000);
-  }
-  else if(gimx_params.refresh_period < controller_get_min_refresh_period(adapter_get(0)->type))
+  /*
+   * The main loop runs at the greatest common divisor of the controller refresh periods.
+   */
+  gimx_params.refresh_period = scheduler_set_periods();
+  if(gimx_params.refresh_period < 0)
   {
-    fprintf(stderr, "Refresh period should be at least %.02fms\n", (double)controller_get_min_refresh_period(adapter_get(0)->type)/1000);
     goto QUIT;
   }
+  gimx_params.postpone_count = 3 * DEFAULT_REFRESH_PERIOD / gimx_params.refresh_period;
 
   if(gimx_params.curses)
   {
@@ -220,6 +214,10 @@ int main(int argc, char *argv[])
     stats_init(0);
   }
 
+  /*
+   * This is the frequency scale of the main loop period.
+   * The motion of each mouse is scaled with the refresh period of its controller (see cfg_process_motion).
+   */
   gimx_params.frequency_scale = (double) DEFAULT_REFRESH_PERIOD / gimx_params.refresh_period;
 
   /*
@@ -231,7 +229,7 @@ int main(int argc, char *argv[])
   {
     if(adapter_get(controller)->event)
     {
-      adapter_get(controller)->send_command = 1;
+      adapter_set_send_command(controller);
       event = 1;
     }
   }
@@ -241,6 +239,11 @@ int main(int argc, char *argv[])
     goto QUIT;
   }
 
+  if(gimx_params.input_thread && GE_SetInputThread() < 0)
+  {
+    fprintf(stderr, _("the input thread is not available\n"));
+  }
+
   unsigned char src = GE_MKB_SOURCE_PHYSICAL;
 
   if(gimx_params.window_events)
@@ -248,6 +251,21 @@ int main(int argc, char *argv[])
     src = GE_MKB_SOURCE_WINDOW_SYSTEM;
   }
 
+  if(gimx_params.event_queue && GE_SetEventQueue(gimx_params.event_queue, 0) < 0)
+  {
+    goto QUIT;
+  }
+
+  if(gimx_params.hotplug && GE_SetHotplug(hotplug_callback) < 0)
+  {
+    fprintf(stderr, _("hotplug is not available\n"));
+  }
+
+  if(gimx_params.coalesce_axes && GE_SetAxisCoalescing() < 0)
+  {
+    goto QUIT;
+  }
+
   //TODO MLA: if there is no config file:
   // - there's no need to read macros
   // - there's no need to read inputs
@@ -288,12 +306,25 @@ int main(int argc, char *argv[])
     }
 
     cfg_read_calibration();
+
+    cfg_memory_report();
   }
 
   GE_release_unused();
 
   macros_init();
 
+  /*
+   * The input devices drop the events that are not used by the configuration or by the macros.
+   */
+  if(gimx_params.config_file && !gimx_params.no_event_filter)
+  {
+    cfg_filter_events();
+    cal_filter_events();
+    macros_filter_events();
+    GE_SetEventFilter(1);
+  }
+
   if(gimx_params.keygen)
   {
     kgevent.key.keysym = GE_KeyId(gimx_params.keygen);
@@ -312,6 +343,11 @@ int main(int argc, char *argv[])
 
   mainloop();
 
+  if(gimx_params.latency)
+  {
+    latency_print();
+  }
+
   gprintf(_("Exiting\n"));
 
   QUIT:
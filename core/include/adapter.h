@@ -38,14 +38,25 @@ typedef struct
   int axis[AXIS_MAX];
   int change;
   int send_command;
+  int refresh_period; //in microseconds, -1 means default
+  uint64_t input_timestamp; //the time of the oldest input that is not sent yet
   int ts_axis[AXIS_MAX][2]; //issue 15
   s_report_packet report[2]; //the xbox one guide button needs a dedicated report
+  int report_index; //the index of the last built report, -1 if none
+  int report_axis[AXIS_MAX]; //the axes of the last built report
   int status;
 } s_adapter;
 
 void adapter_init();
 inline s_adapter* adapter_get(unsigned char index);
 int adapter_set_port(unsigned char index, char* portname);
+int adapter_has_output(int id);
+void adapter_update_active();
+unsigned int adapter_get_active();
+void adapter_set_send_command(int id);
+void adapter_clear_send_command(int id);
+unsigned int adapter_get_dirty();
+unsigned int adapter_build_report(int id);
 
 void adapter_dump_state(int id);
 
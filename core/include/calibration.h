@@ -35,6 +35,7 @@ inline s_mouse_cal* cal_get_mouse(int mouse, int conf);
 inline void cal_set_mouse(s_config_entry* entry);
 int cal_skip_event(GE_Event*);
 void cal_init();
+void cal_filter_events();
 inline int cal_get_controller(int);
 inline void cal_set_controller(int, int);
 void calibration_test();
@@ -41,6 +41,19 @@ typedef enum
     E_SHAPE_RECTANGLE
 }e_shape;
 
+/*
+ * The motion state of the fixed point path, in 16.16 fixed point (see --fixed-point).
+ */
+typedef struct
+{
+  int64_t merge_x[MAX_BUFFERSIZE];
+  int64_t merge_y[MAX_BUFFERSIZE];
+  int64_t x;
+  int64_t y;
+  int64_t residue_x;
+  int64_t residue_y;
+}s_mouse_fixed;
+
 typedef struct
 {
   int change;
@@ -53,6 +66,25 @@ typedef struct
   double residue_x;
   double residue_y;
   int postpone[GE_MOUSE_BUTTONS_MAX];
+  uint64_t timestamp; //the time of the first motion event since the last period
+  int32_t scale; //the DPI scaling factor (16.16 fixed point), 0 means no scaling
+  int32_t scale_residue_x; //the scaled motion that is below a count (16.16 fixed point)
+  int32_t scale_residue_y;
+  int active; //the mouse is in the list of the mice that are processed each period
+  unsigned int idle; //the number of periods without motion
+  unsigned int ticks; //the number of main loop periods the motion is accumulated over, 0 until the first processing
+  double frequency_scale; //the frequency scale of the refresh period of the controller
+  int64_t fixed_frequency_scale; //the same in 16.16 fixed point
+  struct
+  {
+    unsigned int size; //the number of motions in the window, 0 if the sums have to be recomputed
+    double ratio; //the weight of a motion relatively to the next one
+    double divider; //the sum of the weights
+    double ratio_size; //ratio^size
+    double past_x; //the weighted sum of the previous motions in the window
+    double past_y;
+  } filter; //the state of the recursive filter
+  s_mouse_fixed* fixed; //only allocated for the fixed point path
 }s_mouse_control;
 
 typedef struct
@@ -60,6 +92,7 @@ typedef struct
   unsigned int buffer_size;
   double filter;
   e_mouse_mode mode;
+  int32_t fixed_filter; //filter, in 16.16 fixed point (see --fixed-point)
 }s_mouse_options;
 
 typedef struct
@@ -88,6 +121,8 @@ typedef struct
   unsigned int dead_zone;
 
   s_axis_props axis_props;
+
+  struct response* response; //the cached response curve of a mouse axis binding, see --response-tables
 }s_mapper;
 
 typedef struct
@@ -135,6 +170,7 @@ typedef struct
   double step;
   double value;
   double max_value;
+  int64_t fixed_value; //value, in 16.16 fixed point (see --fixed-point)
 }s_intensity;
 
 void cfg_trigger_init();
@@ -143,6 +179,7 @@ void cfg_config_activation();
 void cfg_intensity_lookup(GE_Event*);
 void cfg_process_event(GE_Event*);
 inline s_mouse_control* cfg_get_mouse_control(int);
+void cfg_set_mouse_motion(s_mouse_control* mc, int x, int y);
 inline void cfg_process_rumble_event(GE_Event* event);
 void cfg_process_rumble();
 int cfg_is_joystick_used(int);
@@ -150,11 +187,16 @@ void cfg_process_motion_event(GE_Event*);
 void cfg_process_motion();
 inline void cfg_set_trigger(s_config_entry* entry);
 inline void cfg_set_controller_dpi(int controller, unsigned int dpi);
+void cfg_set_mouse_dpi(int mouse, int controller, unsigned int dpi);
 inline void cfg_set_axis_intensity(s_config_entry* entry, int axis, s_intensity* intensity);
 void cfg_intensity_init();
 int cfg_add_binding(s_config_entry* entry);
 inline s_mapper_table* cfg_get_mouse_axes(int, int, int);
 void cfg_clean();
+void cfg_filter_events();
 void cfg_read_calibration();
+unsigned int cfg_prefault();
+void cfg_memory_report();
+void cfg_response_report();
 
 #endif /* CONFIG_H_ */
@@ -9,6 +9,7 @@
 void serial_init();
 int serial_open(int id, char* portname);
 int serial_send(int id, void* pdata, unsigned int size);
+int serial_send_async(int id, void* pdata, unsigned int size);
 int serial_recv(int id, void* pdata, unsigned int size);
 int serial_close(int id);
 
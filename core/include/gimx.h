@@ -19,6 +19,12 @@
 
 #define DEFAULT_REFRESH_PERIOD 11250 //=11.25ms
 
+/*
+ * The maximum number of missed periods that are processed back to back (see --catch-up).
+ * The other missed periods are skipped, e.g. after a long stall.
+ */
+#define MAX_CATCH_UP 4
+
 typedef struct
 {
   char* homedir;
@@ -35,6 +41,22 @@ typedef struct
   int window_events;
   int network_input;
   int btstack;
+  int latency;
+  int catch_up;
+  int late_sampling; //the initial margin (microseconds), 0 means disabled
+  int input_thread;
+  int io_uring;
+  int hotplug;
+  int coalesce_axes;
+  int no_event_filter;
+  int recursive_filter;
+  int response_tables;
+  int response_check;
+  int fixed_point;
+  int event_queue; //the capacity of the event queue, 0 means default
+  int realtime; //the SCHED_FIFO priority, 0 means disabled
+  char* cpus;
+  char* io_cpus;
 } s_gimx_params;
 
 extern s_gimx_params gimx_params;
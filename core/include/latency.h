@@ -0,0 +1,24 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau
+ License: GPLv3
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+  unsigned long long count; // total number of samples
+  unsigned int nb; // number of samples the percentiles are computed from
+  uint32_t p50; // nanoseconds
+  uint32_t p99; // nanoseconds
+  uint32_t max; // nanoseconds (all samples)
+} s_latency_stats;
+
+void latency_record(int id, uint64_t input_timestamp);
+int latency_get_stats(int id, s_latency_stats* stats);
+void latency_print();
+
+#endif /* LATENCY_H_ */
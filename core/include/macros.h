@@ -13,5 +13,6 @@ unsigned int macro_process();
 
 void macros_init();
 void macros_clean();
+void macros_filter_events();
 
 #endif
@@ -9,5 +9,6 @@
 #define PRIO_H_
 
 int set_prio();
+int set_realtime(int priority, const char* cpus, const char* io_cpus);
 
 #endif /* PRIO_H_ */
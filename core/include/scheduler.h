@@ -0,0 +1,15 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+int scheduler_set_periods();
+void scheduler_start();
+void scheduler_tick();
+int scheduler_is_due(int id);
+unsigned int scheduler_get_ticks(int id);
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,116 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau
+ License: GPLv3
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GE.h>
+#include <adapter.h>
+#include <latency.h>
+
+/*
+ * Number of samples kept per controller to compute the percentiles.
+ * It has to be a power of two.
+ */
+#define LATENCY_SAMPLES 4096
+
+/*
+ * The samples are written by the main thread only.
+ * The write index is published after the sample is stored,
+ * so that a reader never sees an index pointing to a sample that is not written yet.
+ */
+static struct
+{
+  uint32_t samples[LATENCY_SAMPLES];
+  unsigned long long count;
+  uint32_t max;
+} latency[MAX_CONTROLLERS] = {};
+
+/*
+ * \brief Record the delay between an input and the emission of the report it modified.
+ *        This function does not allocate memory and does not perform any system call.
+ *
+ * \param id               the controller index
+ * \param input_timestamp  the time the input was read from its source (see GE_GetTime)
+ */
+void latency_record(int id, uint64_t input_timestamp)
+{
+  uint64_t delta = GE_GetTime() - input_timestamp;
+
+  if(delta > UINT32_MAX)
+  {
+    delta = UINT32_MAX;
+  }
+
+  unsigned long long count = latency[id].count;
+
+  latency[id].samples[count & (LATENCY_SAMPLES - 1)] = delta;
+
+  if(delta > latency[id].max)
+  {
+    latency[id].max = delta;
+  }
+
+  __atomic_store_n(&latency[id].count, count + 1, __ATOMIC_RELEASE);
+}
+
+static int compare_samples(const void* s1, const void* s2)
+{
+  uint32_t v1 = *(const uint32_t*)s1;
+  uint32_t v2 = *(const uint32_t*)s2;
+  return (v1 > v2) - (v1 < v2);
+}
+
+/*
+ * \brief Compute the latency statistics of a controller from the last recorded samples.
+ *
+ * \param id     the controller index
+ * \param stats  where to store the statistics
+ *
+ * \return -1 if there is no sample, 0 otherwise
+ */
+int latency_get_stats(int id, s_latency_stats* stats)
+{
+  static uint32_t sorted[LATENCY_SAMPLES];
+
+  unsigned long long count = __atomic_load_n(&latency[id].count, __ATOMIC_ACQUIRE);
+
+  if(!count)
+  {
+    return -1;
+  }
+
+  unsigned int nb = count < LATENCY_SAMPLES ? count : LATENCY_SAMPLES;
+
+  memcpy(sorted, latency[id].samples, nb * sizeof(*sorted));
+  qsort(sorted, nb, sizeof(*sorted), compare_samples);
+
+  stats->count = count;
+  stats->nb = nb;
+  stats->p50 = sorted[(nb - 1) * 50 / 100];
+  stats->p99 = sorted[(nb - 1) * 99 / 100];
+  stats->max = latency[id].max;
+
+  return 0;
+}
+
+/*
+ * \brief Print the latency statistics of all controllers.
+ */
+void latency_print()
+{
+  int i;
+  s_latency_stats stats;
+
+  for(i = 0; i < MAX_CONTROLLERS; ++i)
+  {
+    if(latency_get_stats(i, &stats) < 0)
+    {
+      continue;
+    }
+    printf("controller %d input-to-report latency: p50 %.03fms p99 %.03fms max %.03fms (%llu samples, last %u)\n",
+        i, (double)stats.p50 / 1000000, (double)stats.p99 / 1000000, (double)stats.max / 1000000, stats.count, stats.nb);
+  }
+}
@@ -1151,6 +1151,41 @@ static void macros_read()
   }
 }
 
+static void allow_event(GE_Event* event)
+{
+  switch(event->type)
+  {
+    case GE_KEYDOWN:
+    case GE_KEYUP:
+      GE_AllowEvent(GE_KEYDOWN, -1, event->key.keysym);
+      break;
+    case GE_MOUSEBUTTONDOWN:
+    case GE_MOUSEBUTTONUP:
+      GE_AllowEvent(GE_MOUSEBUTTONDOWN, -1, event->button.button);
+      break;
+    case GE_JOYBUTTONDOWN:
+    case GE_JOYBUTTONUP:
+      GE_AllowEvent(GE_JOYBUTTONDOWN, -1, event->jbutton.button);
+      break;
+    case GE_JOYAXISMOTION:
+      GE_AllowEvent(GE_JOYAXISMOTION, -1, event->jaxis.axis);
+      break;
+  }
+}
+
+/*
+ * Allow the events that start macros or enable them, for all devices.
+ */
+void macros_filter_events()
+{
+  int i;
+  for(i = 0; i < macros_nb; ++i)
+  {
+    allow_event(&macros[i].id.event);
+    allow_event(&macros[i].trigger.event);
+  }
+}
+
 /*
  * Initializes macro_table and reads macros from macro files.
  */
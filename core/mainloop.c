@@ -9,9 +9,12 @@
 #include "connectors/connector.h"
 #include "macros.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <adapter.h>
 #include <connectors/usb_con.h>
 #include <report2event/report2event.h>
+#include <scheduler.h>
+#include <prio.h>
 
 static volatile int done = 0;
 
@@ -20,18 +23,160 @@ void set_done()
   done = 1;
 }
 
+int ignore_event(GE_Event* event)
+{
+  return 0;
+}
+
+int process_event(GE_Event* event)
+{
+  switch (event->type)
+  {
+    case GE_MOUSEMOTION:
+      cfg_process_motion_event(event);
+      break;
+    case GE_JOYRUMBLE:
+      cfg_process_rumble_event(event);
+      break;
+    default:
+      if (!cal_skip_event(event))
+      {
+        cfg_process_event(event);
+      }
+      break;
+  }
+
+  //make sure to process the event before these two lines
+  cfg_trigger_lookup(event);
+  cfg_intensity_lookup(event);
+
+  switch (event->type)
+  {
+    case GE_MOUSEBUTTONDOWN:
+      cal_button(event->button.which, event->button.button);
+      break;
+    case GE_KEYDOWN:
+      cal_key(event->key.which, event->key.keysym, 1);
+      break;
+    case GE_KEYUP:
+      cal_key(event->key.which, event->key.keysym, 0);
+      break;
+  }
+
+  if(event->type != GE_MOUSEMOTION)
+  {
+    macro_lookup(event);
+  }
+
+  return 0;
+}
+
+/*
+ * In late sampling mode, the timer expires a margin before each period boundary.
+ * Pending inputs are drained, and reports are sent right away.
+ * The margin tracks the time between the timer expiration and the end of the sending
+ * (wake-up lateness + processing time), using its smoothed mean and mean deviation.
+ * The period boundaries are the ones of the timer grid, which is not synchronized with
+ * the adapter or the console: this shifts the phase of the refreshes, and it doesn't
+ * reduce the delay between an input and its report, as inputs are applied as they arrive.
+ * All values are in microseconds.
+ */
+#define LATE_SAMPLING_MIN_MARGIN 100
+#define LATE_SAMPLING_HYSTERESIS 50
+
+static struct
+{
+  int enabled;
+  int margin;
+  int mean;
+  int deviation;
+} late_sampling = {};
+
+static int late_sampling_clamp(int margin)
+{
+  if(margin < LATE_SAMPLING_MIN_MARGIN)
+  {
+    return LATE_SAMPLING_MIN_MARGIN;
+  }
+  if(margin > gimx_params.refresh_period / 2)
+  {
+    return gimx_params.refresh_period / 2;
+  }
+  return margin;
+}
+
+static void late_sampling_start()
+{
+  if(!gimx_params.late_sampling)
+  {
+    return;
+  }
+
+  late_sampling.margin = late_sampling_clamp(gimx_params.late_sampling);
+  late_sampling.mean = late_sampling.margin;
+  late_sampling.deviation = 0;
+
+  if(GE_TimerSetOffset(late_sampling.margin) < 0)
+  {
+    fprintf(stderr, _("late sampling is not available\n"));
+    return;
+  }
+
+  late_sampling.enabled = 1;
+}
+
+/*
+ * Update the margin with the time elapsed since the wake-up.
+ * Periods following a scheduling delay are not taken into account.
+ */
+static void late_sampling_update(uint64_t wakeup)
+{
+  GE_TimerStats stats;
+
+  if(GE_TimerGetStats(&stats) < 0 || stats.last_missed)
+  {
+    return;
+  }
+
+  int sample = stats.last_lateness + (GE_GetTime() - wakeup) / 1000;
+  int error = sample - late_sampling.mean;
+
+  late_sampling.mean += error / 8;
+  late_sampling.deviation += (abs(error) - late_sampling.deviation) / 4;
+
+  int margin = late_sampling_clamp(late_sampling.mean + 4 * late_sampling.deviation);
+
+  if(abs(margin - late_sampling.margin) > LATE_SAMPLING_HYSTERESIS && !GE_TimerSetOffset(margin))
+  {
+    late_sampling.margin = margin;
+  }
+}
+
 void mainloop()
 {
   GE_Event events[EVENT_BUFFER_SIZE];
   int num_evt;
   GE_Event* event;
   unsigned int running_macros;
+  GE_TimerStats timer_stats;
+  GE_InputStats input_stats;
+  GE_EvdevStats evdev_stats;
+  GE_AxisStats axis_stats;
+  GE_FilterStats filter_stats;
+  int i;
+  GE_QueueStats queue_stats;
+  unsigned int catch_up = 0;
+  unsigned long long skipped = 0;
+  uint64_t wakeup = 0;
 
   if(!adapter_get(0)->bdaddr_dst || adapter_get(0)->type == C_TYPE_DS4)
   {
     GE_TimerStart(gimx_params.refresh_period);
+    scheduler_start();
   }
 
+  late_sampling_start();
+
   /*
    * Non-generated events are ignored if the --keygen argument is used.
    */
@@ -46,12 +191,58 @@ void mainloop()
 
   report2event_set_callback(process_event);
 
+  /*
+   * This is done once all threads are started (the input thread is started by GE_SetCallback).
+   */
+  if(gimx_params.realtime)
+  {
+    set_realtime(gimx_params.realtime, gimx_params.cpus, gimx_params.io_cpus);
+  }
+
   while(!done)
   {
-    /*
-     * GE_PumpEvents should always be executed as it drives the period.
-     */
-    GE_PumpEvents();
+    if(catch_up)
+    {
+      /*
+       * Run the missed periods back to back, so that reports, macros
+       * and delayed profile switches keep their timing.
+       */
+      --catch_up;
+      wakeup = 0;
+
+      /*
+       * Don't stop processing the inputs while catching up.
+       */
+      GE_PumpPendingEvents();
+    }
+    else
+    {
+      /*
+       * GE_PumpEvents should always be executed as it drives the period.
+       */
+      GE_PumpEvents();
+
+      if(late_sampling.enabled)
+      {
+        /*
+         * Drain the inputs that arrived while the timer was read.
+         */
+        wakeup = GE_GetTime();
+        GE_PumpPendingEvents();
+      }
+
+      if(gimx_params.catch_up && !GE_TimerGetStats(&timer_stats))
+      {
+        catch_up = timer_stats.last_missed;
+        if(catch_up > MAX_CATCH_UP)
+        {
+          skipped += catch_up - MAX_CATCH_UP;
+          catch_up = MAX_CATCH_UP;
+        }
+      }
+    }
+
+    scheduler_tick();
 
     cfg_process_motion();
 
@@ -62,6 +253,11 @@ void mainloop()
       done = 1;
     }
 
+    if(wakeup)
+    {
+      late_sampling_update(wakeup);
+    }
+
     cfg_process_rumble();
     
     usb_poll_interrupts();
@@ -84,11 +280,9 @@ void mainloop()
 
     num_evt = GE_PeepEvents(events, sizeof(events) / sizeof(events[0]));
 
-    if (num_evt == EVENT_BUFFER_SIZE)
-    {
-      printf("buffer too small!!!\n");
-    }
-    
+    /*
+     * If the buffer is full, the remaining events stay in the queue until the next period.
+     */
     for (event = events; event < events + num_evt; ++event)
     {
       process_event(event);
@@ -103,6 +297,56 @@ void mainloop()
       done = 1;
     }
   }
+
+  if(!GE_TimerGetStats(&timer_stats) && (timer_stats.missed || timer_stats.late))
+  {
+    printf(_("timer: %llu periods, %llu missed, %llu late, max lateness: %.03fms\n"),
+        timer_stats.ticks, timer_stats.missed, timer_stats.late, (double)timer_stats.max_lateness / 1000);
+    if(gimx_params.catch_up)
+    {
+      printf(_("catch-up: %llu missed periods skipped\n"), skipped);
+    }
+  }
+
+  if(!GE_GetInputStats(&input_stats) && input_stats.overflows)
+  {
+    printf(_("input thread: %llu events, %llu dropped (ring full)\n"), input_stats.events, input_stats.overflows);
+  }
+
+  if(!GE_GetEventQueueStats(&queue_stats) && (gimx_params.status || queue_stats.dropped))
+  {
+    printf(_("event queue: %llu events, %llu dropped (queue full), high water mark: %u/%u\n"),
+        queue_stats.pushed, queue_stats.dropped, queue_stats.high_water, queue_stats.capacity);
+  }
+
+  if(!GE_GetEvdevStats(&evdev_stats) && (gimx_params.status || evdev_stats.resyncs))
+  {
+    printf(_("evdev: %llu frames, %llu merged motions, %llu resyncs (events dropped by the kernel)\n"),
+        evdev_stats.frames, evdev_stats.merged, evdev_stats.resyncs);
+  }
+
+  if(!GE_GetFilterStats(&filter_stats) && gimx_params.status && (filter_stats.passed || filter_stats.dropped))
+  {
+    printf(_("event filter: %llu events passed, %llu dropped\n"), filter_stats.passed, filter_stats.dropped);
+  }
+
+  for(i = 0; i < MAX_DEVICES; ++i)
+  {
+    if(GE_JoystickName(i) && !GE_GetAxisStats(i, &axis_stats) && axis_stats.received)
+    {
+      printf(_("joystick %s %d: %llu axis motions, %llu processed (%.1f%% merged)\n"),
+          GE_JoystickName(i), GE_JoystickVirtualId(i), axis_stats.received, axis_stats.emitted,
+          100.0 * (axis_stats.received - axis_stats.emitted) / axis_stats.received);
+    }
+  }
+
+  cfg_response_report();
+
+  if(late_sampling.enabled)
+  {
+    printf(_("late sampling: margin: %.03fms, processing time: %.03fms (deviation: %.03fms)\n"),
+        (double)late_sampling.margin / 1000, (double)late_sampling.mean / 1000, (double)late_sampling.deviation / 1000);
+  }
     
   GE_TimerClose();
 }
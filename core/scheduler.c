@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#include <stdio.h>
+#include "gimx.h"
+#include <adapter.h>
+#include <scheduler.h>
+
+/*
+ * The main loop can't run faster than this (microseconds).
+ */
+#define MIN_BASE_PERIOD 1000
+
+/*
+ * Each controller is refreshed every 'ticks' periods of the main loop.
+ * A controller that is not scheduled (ticks = 0) is refreshed at each iteration.
+ */
+static struct
+{
+  unsigned int ticks;
+  unsigned int countdown;
+  int due;
+} schedule[MAX_CONTROLLERS] = {};
+
+static int started = 0;
+
+static int gcd(int a, int b)
+{
+  while(b)
+  {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/*
+ * \brief Set the refresh period of each controller, and compute the period of the main loop,
+ *        which is the greatest common divisor of the controller refresh periods.
+ *
+ * \return the period of the main loop (microseconds), or -1 in case of error.
+ */
+int scheduler_set_periods()
+{
+  int i;
+  int base = 0;
+  int min = 0;
+  s_adapter* adapter;
+
+  for(i = 0; i < MAX_CONTROLLERS; ++i)
+  {
+    adapter = adapter_get(i);
+
+    if(i && !adapter_has_output(i))
+    {
+      continue;
+    }
+
+    if(adapter->refresh_period == -1)
+    {
+      adapter->refresh_period = controller_get_default_refresh_period(adapter->type);
+      printf(_("controller %d: using default refresh period: %.02fms\n"), i, (double)adapter->refresh_period/1000);
+    }
+    else if(adapter->refresh_period < controller_get_min_refresh_period(adapter->type))
+    {
+      fprintf(stderr, _("controller %d: refresh period should be at least %.02fms\n"), i, (double)controller_get_min_refresh_period(adapter->type)/1000);
+      return -1;
+    }
+
+    base = gcd(base, adapter->refresh_period);
+    if(!min || adapter->refresh_period < min)
+    {
+      min = adapter->refresh_period;
+    }
+  }
+
+  if(base < MIN_BASE_PERIOD)
+  {
+    /*
+     * The periods have no usable common divisor:
+     * round them to multiples of the shortest one.
+     */
+    base = min;
+    printf(_("refresh periods are rounded to multiples of %.02fms\n"), (double)base/1000);
+  }
+
+  for(i = 0; i < MAX_CONTROLLERS; ++i)
+  {
+    adapter = adapter_get(i);
+
+    if(adapter->refresh_period > 0)
+    {
+      schedule[i].ticks = (adapter->refresh_period + base / 2) / base;
+      if(!schedule[i].ticks)
+      {
+        schedule[i].ticks = 1;
+      }
+    }
+  }
+
+  return base;
+}
+
+/*
+ * \brief Start the schedule. All controllers are refreshed at the first period.
+ *        Sixaxis controllers connected over bluetooth are not scheduled,
+ *        as they are refreshed each time the console polls them.
+ */
+void scheduler_start()
+{
+  int i;
+  s_adapter* adapter;
+
+  for(i = 0; i < MAX_CONTROLLERS; ++i)
+  {
+    adapter = adapter_get(i);
+
+    if(adapter->bdaddr_dst && adapter->type != C_TYPE_DS4)
+    {
+      schedule[i].ticks = 0;
+    }
+    schedule[i].countdown = 1;
+    schedule[i].due = 0;
+  }
+
+  started = 1;
+}
+
+/*
+ * \brief Advance the schedule by one period of the main loop.
+ */
+void scheduler_tick()
+{
+  int i;
+
+  for(i = 0; i < MAX_CONTROLLERS; ++i)
+  {
+    if(schedule[i].ticks)
+    {
+      schedule[i].due = !--schedule[i].countdown;
+      if(schedule[i].due)
+      {
+        schedule[i].countdown = schedule[i].ticks;
+      }
+    }
+  }
+}
+
+/*
+ * \brief Get the number of periods of the main loop between two refreshes of a controller.
+ *        It is 1 for a controller that is refreshed at each iteration.
+ */
+unsigned int scheduler_get_ticks(int id)
+{
+  return (started && schedule[id].ticks) ? schedule[id].ticks : 1;
+}
+
+/*
+ * \brief Tell if a controller has to be refreshed in the current period.
+ *        All controllers are refreshed at each iteration if the schedule is not started.
+ */
+int scheduler_is_due(int id)
+{
+  return !started || !schedule[id].ticks || schedule[id].due;
+}
@@ -3,8 +3,18 @@
  License: GPLv3
  */
 
+#define _GNU_SOURCE
 #include <sched.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "gimx.h"
+#include "config.h"
 
 int set_prio()
 {
@@ -21,3 +31,193 @@ int set_prio()
   }
   return 0;
 }
+
+/*
+ * Parse a CPU list, e.g. "2" or "0,2-3".
+ */
+static int parse_cpus(const char* list, cpu_set_t* set)
+{
+  const char* cur = list;
+  char* end;
+  long first, last;
+
+  CPU_ZERO(set);
+
+  while(*cur)
+  {
+    first = strtol(cur, &end, 10);
+    if(end == cur || first < 0)
+    {
+      return -1;
+    }
+    last = first;
+    cur = end;
+    if(*cur == '-')
+    {
+      ++cur;
+      last = strtol(cur, &end, 10);
+      if(end == cur || last < first)
+      {
+        return -1;
+      }
+      cur = end;
+    }
+    if(last >= CPU_SETSIZE)
+    {
+      return -1;
+    }
+    for(; first <= last; ++first)
+    {
+      CPU_SET(first, set);
+    }
+    if(*cur == ',')
+    {
+      ++cur;
+    }
+    else if(*cur)
+    {
+      return -1;
+    }
+  }
+
+  return CPU_COUNT(set) ? 0 : -1;
+}
+
+static void get_thread_name(pid_t tid, char* name, size_t size)
+{
+  char path[64];
+  FILE* fp;
+
+  snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+  name[0] = '\0';
+  fp = fopen(path, "r");
+  if(fp)
+  {
+    if(fgets(name, size, fp))
+    {
+      name[strcspn(name, "\n")] = '\0';
+    }
+    fclose(fp);
+  }
+}
+
+/*
+ * Apply a real-time profile to all the threads of the process:
+ * - set the SCHED_FIFO policy with the given priority,
+ * - pin the main thread to the 'cpus' list, and the other (I/O) threads to the 'io_cpus' list,
+ * - pre-fault the configuration tables,
+ * - lock the memory.
+ * Each step is reported, and the function returns -1 if any of them failed.
+ */
+int set_realtime(int priority, const char* cpus, const char* io_cpus)
+{
+  int ret = 0;
+  cpu_set_t main_set, io_set;
+  int main_pinning = 0, io_pinning = 0;
+  struct sched_param p = { .sched_priority = priority };
+  pid_t pid = getpid();
+  DIR* dir;
+  struct dirent* entry;
+
+  printf(_("realtime profile:\n"));
+
+  if(cpus)
+  {
+    if(parse_cpus(cpus, &main_set) < 0)
+    {
+      printf(_("  bad CPU list: %s\n"), cpus);
+      ret = -1;
+    }
+    else
+    {
+      main_pinning = 1;
+    }
+  }
+
+  if(io_cpus)
+  {
+    if(parse_cpus(io_cpus, &io_set) < 0)
+    {
+      printf(_("  bad CPU list: %s\n"), io_cpus);
+      ret = -1;
+    }
+    else
+    {
+      io_pinning = 1;
+    }
+  }
+
+  dir = opendir("/proc/self/task");
+  if(!dir)
+  {
+    printf(_("  can't list the threads: %s\n"), strerror(errno));
+    ret = -1;
+  }
+  else
+  {
+    while((entry = readdir(dir)))
+    {
+      if(entry->d_name[0] == '.')
+      {
+        continue;
+      }
+
+      pid_t tid = atoi(entry->d_name);
+      int is_main = (tid == pid);
+      char name[32];
+
+      get_thread_name(tid, name, sizeof(name));
+
+      if(!strcmp(name, "GE hotplug"))
+      {
+        // Probing the new devices is not time critical.
+        printf(_("  hotplug thread %d: not changed\n"), tid);
+        continue;
+      }
+
+      printf(_("  %s thread %d (%s):"), is_main ? _("main") : _("I/O"), tid, name);
+
+      if(sched_setscheduler(tid, SCHED_FIFO, &p) < 0)
+      {
+        printf(_(" SCHED_FIFO priority %d: failed (%s),"), priority, strerror(errno));
+        ret = -1;
+      }
+      else
+      {
+        printf(_(" SCHED_FIFO priority %d: ok,"), priority);
+      }
+
+      if(is_main ? main_pinning : io_pinning)
+      {
+        if(sched_setaffinity(tid, sizeof(cpu_set_t), is_main ? &main_set : &io_set) < 0)
+        {
+          printf(_(" CPUs %s: failed (%s)\n"), is_main ? cpus : io_cpus, strerror(errno));
+          ret = -1;
+        }
+        else
+        {
+          printf(_(" CPUs %s: ok\n"), is_main ? cpus : io_cpus);
+        }
+      }
+      else
+      {
+        printf(_(" CPUs: not pinned\n"));
+      }
+    }
+    closedir(dir);
+  }
+
+  printf(_("  pre-faulted configuration tables: %u kB\n"), cfg_prefault() / 1024);
+
+  if(mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+  {
+    printf(_("  mlockall: failed (%s)\n"), strerror(errno));
+    ret = -1;
+  }
+  else
+  {
+    printf(_("  mlockall: ok\n"));
+  }
+
+  return ret;
+}
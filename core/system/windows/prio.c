@@ -20,3 +20,12 @@ int set_prio()
   }
   return 0;
 }
+
+/*
+ * Not implemented.
+ */
+int set_realtime(int priority, const char* cpus, const char* io_cpus)
+{
+  fprintf(stderr, "The realtime profile is not available.\n");
+  return -1;
+}
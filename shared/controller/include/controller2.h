@@ -39,6 +39,7 @@ void controller_register_axis_names(e_controller_type type, int nb, s_axis_name_
 void controller_gpp_set_params(e_controller_type type);
 int controller_get_min_refresh_period(e_controller_type type);
 int controller_get_default_refresh_period(e_controller_type type);
+int controller_has_stateful_report(e_controller_type type);
 
 inline int controller_get_max_signed(e_controller_type, int);
 inline int controller_get_max_unsigned(e_controller_type, int);
@@ -34,6 +34,7 @@ typedef struct
   int min_refresh_period;
   int default_refresh_period;
   int* max_unsigned_axis_value;
+  int stateful_report; //the report changes at each build (e.g. it holds a counter), so it can't be reused
 } s_controller_params;
 
 typedef enum
@@ -99,6 +99,11 @@ int controller_get_default_refresh_period(e_controller_type type)
   return controller_params[type]->default_refresh_period;
 }
 
+int controller_has_stateful_report(e_controller_type type)
+{
+  return controller_params[type]->stateful_report;
+}
+
 inline int controller_get_max_unsigned(e_controller_type type, int axis)
 {
   return controller_params[type]->max_unsigned_axis_value[axis];
@@ -131,7 +131,8 @@ static s_controller_params ds4_params =
 {
     .min_refresh_period = 1000,
     .default_refresh_period = 10000,
-    .max_unsigned_axis_value = ds4_max_unsigned_axis_value
+    .max_unsigned_axis_value = ds4_max_unsigned_axis_value,
+    .stateful_report = 1
 };
 
 static s_report_ds4 init_report_ds4 =
@@ -99,7 +99,8 @@ static s_controller_params xone_params =
 {
     .min_refresh_period = 1000,
     .default_refresh_period = 4000,
-    .max_unsigned_axis_value = xone_max_unsigned_axis_value
+    .max_unsigned_axis_value = xone_max_unsigned_axis_value,
+    .stateful_report = 1
 };
 
 static inline void axis2button(int axis[AXIS_MAX], e_xone_axis_index index,
@@ -356,19 +356,25 @@ typedef struct GE_JoyRumbleEvent {
   uint16_t strong;  /**< Strong motor */
 } GE_JoyRumbleEvent;
 
-typedef union GE_Event {
-  struct
+typedef struct GE_Event {
+  union
   {
-    uint8_t type;
-    uint8_t which;
+    struct
+    {
+      uint8_t type;
+      uint8_t which;
+    };
+    GE_KeyboardEvent key;
+    GE_MouseMotionEvent motion;
+    GE_MouseButtonEvent button;
+    GE_JoyAxisEvent jaxis;
+    GE_JoyHatEvent jhat;
+    GE_JoyButtonEvent jbutton;
+    GE_JoyRumbleEvent jrumble;
   };
-  GE_KeyboardEvent key;
-  GE_MouseMotionEvent motion;
-  GE_MouseButtonEvent button;
-  GE_JoyAxisEvent jaxis;
-  GE_JoyHatEvent jhat;
-  GE_JoyButtonEvent jbutton;
-  GE_JoyRumbleEvent jrumble;
+  uint64_t timestamp; /**< The time of the event (see GE_GetTime), 0 if unknown.
+                          In Linux, this is the kernel timestamp for the evdev and joystick devices,
+                          and the time the event was read for the other sources. */
 } GE_Event;
 
 typedef enum
@@ -386,6 +392,71 @@ typedef enum
   GE_JS_XONEPAD,
 } GE_JS_Type;
 
+typedef enum
+{
+  GE_DEVICE_KEYBOARD,
+  GE_DEVICE_MOUSE,
+  GE_DEVICE_JOYSTICK,
+} GE_DeviceType;
+
+typedef struct
+{
+  unsigned long long ticks; /**< The number of serviced periods */
+  unsigned long long missed; /**< The number of periods that elapsed without being serviced */
+  unsigned long long late; /**< The number of periods serviced more than half a period after their deadline */
+  unsigned int last_missed; /**< The number of periods missed right before the last serviced one */
+  unsigned int last_lateness; /**< The lateness of the last serviced period (microseconds) */
+  unsigned int max_lateness; /**< The highest lateness (microseconds) */
+} GE_TimerStats;
+
+/**
+ * \brief Input thread statistics, see GE_GetInputStats.
+ */
+typedef struct
+{
+  unsigned long long events; /**< The number of events read by the input thread */
+  unsigned long long overflows; /**< The number of events dropped because the ring was full */
+} GE_InputStats;
+
+/**
+ * \brief Event queue statistics, see GE_GetEventQueueStats.
+ */
+typedef struct
+{
+  unsigned int capacity; /**< The number of events the queue can hold */
+  unsigned int high_water; /**< The highest number of queued events */
+  unsigned long long pushed; /**< The number of queued events */
+  unsigned long long dropped; /**< The number of events dropped because the queue was full */
+} GE_QueueStats;
+
+/**
+ * \brief Mouse and keyboard (evdev) statistics, see GE_GetEvdevStats.
+ */
+typedef struct
+{
+  unsigned long long frames; /**< The number of frames (SYN_REPORT) */
+  unsigned long long merged; /**< The number of relative motions merged into the motion event of their frame */
+  unsigned long long resyncs; /**< The number of resyncs after the kernel dropped events (SYN_DROPPED) */
+} GE_EvdevStats;
+
+/**
+ * \brief Joystick axis coalescing statistics, see GE_GetAxisStats.
+ */
+typedef struct
+{
+  unsigned long long received; /**< The number of axis motions read from the joystick */
+  unsigned long long emitted; /**< The number of axis motions processed after coalescing */
+} GE_AxisStats;
+
+/**
+ * \brief Event filter statistics, see GE_GetFilterStats.
+ */
+typedef struct
+{
+  unsigned long long passed; /**< The number of filtered events that were allowed */
+  unsigned long long dropped; /**< The number of events dropped by the sources */
+} GE_FilterStats;
+
 #define EVENT_BUFFER_SIZE 256
 
 #define AXIS_X 0
@@ -415,6 +486,8 @@ int GE_JoystickVirtualId(int);
 void GE_SetJoystickUsed(int);
 GE_JS_Type GE_GetJSType(int id);
 int GE_RegisterJoystick(const char* name, int (*rumble_cb)(int, unsigned short, unsigned short));
+int GE_SetHotplug(void (*callback)(GE_DeviceType type, int id, int connected));
+int GE_ReserveDevice(GE_DeviceType type, const char* name, int virtualIndex);
 
 const char* GE_MouseButtonName(int);
 int GE_MouseButtonId(const char*);
@@ -427,11 +500,29 @@ void GE_SetMKMode(GE_MK_Mode);
 int GE_JoystickHasRumble(int id);
 int GE_JoystickSetRumble(int id, unsigned short weak, unsigned short strong);
 
+uint64_t GE_GetTime();
+
 void GE_TimerStart(int usec);
 void GE_TimerClose();
+int GE_TimerGetStats(GE_TimerStats* stats);
+int GE_TimerSetOffset(int usec);
 void GE_PumpEvents();
+void GE_PumpPendingEvents();
+int GE_SetInputThread();
+int GE_GetInputStats(GE_InputStats* stats);
+int GE_GetEvdevStats(GE_EvdevStats* stats);
+int GE_SetAxisCoalescing();
+int GE_GetAxisStats(int joystick, GE_AxisStats* stats);
+int GE_AllowEvent(unsigned char type, int device, int code);
+void GE_SetEventFilter(int enabled);
+int GE_GetFilterStats(GE_FilterStats* stats);
+int GE_SetIOUring();
+int GE_WriteAsync(int fd, const void* buf, unsigned int count);
 int GE_PeepEvents(GE_Event*, int);
 int GE_PushEvent(GE_Event*);
+int GE_PushEvents(GE_Event*, int);
+int GE_SetEventQueue(unsigned int capacity, int multi_producer);
+int GE_GetEventQueueStats(GE_QueueStats* stats);
 void GE_SetCallback(int(*)(GE_Event*));
 
 void GE_AddSource(int fd, int id, int (*fp_read)(int), int (*fp_write)(int), int (*fp_cleanup)(int));
@@ -6,12 +6,15 @@
 #include <GE.h>
 #include <events.h>
 #include <queue.h>
+#include <coalesce.h>
+#include <filter.h>
 #include <conversion.h>
 #include <string.h>
 #include <stdlib.h>
 #include <iconv.h>
 #include <timer.h>
 #include <stdio.h>
+#include <errno.h>
 #ifndef WIN32
 #include <poll.h>
 #else
@@ -44,6 +47,7 @@ static struct
 {
   char* name;
   int virtualIndex;
+  unsigned char connected;
   unsigned char isUsed;
   GE_JS_Type type;
 } joysticks[GE_MAX_DEVICES] = {};
@@ -52,14 +56,28 @@ static struct
 {
   char* name;
   int virtualIndex;
+  unsigned char connected;
 } mice[GE_MAX_DEVICES] = {};
 
 static struct
 {
   char* name;
   int virtualIndex;
+  unsigned char connected;
 } keyboards[GE_MAX_DEVICES] = {};
 
+/*
+ * With hotplug, a device that is disconnected keeps its entry (and its index),
+ * so that it gets the same index when it is connected again.
+ * Entries can also be reserved for devices that are not connected yet.
+ */
+static struct
+{
+  int enabled;
+  int released; //GE_release_unused was called: new joysticks are not used
+  void (*callback)(GE_DeviceType type, int id, int connected);
+} hotplug = {};
+
 static int grab = GE_GRAB_OFF;
 
 static GE_MK_Mode mk_mode = GE_MK_MODE_MULTIPLE_INPUTS;
@@ -84,6 +102,59 @@ static const char* _8BIT_to_UTF8(const char* _8bit)
   return output;
 }
 
+/*
+ * Get the type of a joystick given its name (UTF-8).
+ */
+static GE_JS_Type joystick_type(const char* name)
+{
+  int i;
+  for (i = 0; i < sizeof(js_types) / sizeof(*js_types); ++i)
+  {
+    if (!strcmp(name, js_types[i].name))
+    {
+      return js_types[i].type;
+    }
+  }
+  return GE_JS_OTHER;
+}
+
+/*
+ * Convert a joystick name as reported by the system to the name exposed by the library (UTF-8),
+ * and get the joystick type.
+ * The returned string is hold in a statically allocated buffer that is modified at each call.
+ */
+static const char* joystick_name(const char* name, GE_JS_Type* type)
+{
+  *type = GE_JS_OTHER; //default value
+
+  if (!strncmp(name, BT_SIXAXIS_NAME, sizeof(BT_SIXAXIS_NAME) - 1))
+  {
+    // Rename QtSixA devices.
+    name = "Sony PLAYSTATION(R)3 Controller";
+    *type = GE_JS_SIXAXIS;
+  }
+#ifdef WIN32
+  if (!strncmp(name, XONE_PAD_NAME, sizeof(XONE_PAD_NAME) - 1))
+  {
+    // In Windows, rename joysticks that are named XONE_PAD_NAME.
+    // Such controllers are registered using GE_RegisterJoystick().
+    // It's currently not possible to distinguish Xbox One controllers
+    // from Xbox 360 controllers, as Xinput does not provide controller names.
+    name = "X360 Controller";
+    *type = GE_JS_XONEPAD;
+  }
+#endif
+
+  name = _8BIT_to_UTF8(name);
+
+  if (*type == GE_JS_OTHER)
+  {
+    *type = joystick_type(name);
+  }
+
+  return name;
+}
+
 /*
  * \bried Initializes the GE library.
  *
@@ -107,27 +178,8 @@ int GE_initialize(unsigned char mkb_src)
   i = 0;
   while (i < GE_MAX_DEVICES && (name = ev_joystick_name(i)))
   {
-    joysticks[i].type = GE_JS_OTHER; //default value
-
-    if (!strncmp(name, BT_SIXAXIS_NAME, sizeof(BT_SIXAXIS_NAME) - 1))
-    {
-      // Rename QtSixA devices.
-      name = "Sony PLAYSTATION(R)3 Controller";
-      joysticks[i].type = GE_JS_SIXAXIS;
-    }
-#ifdef WIN32
-    if (!strncmp(name, XONE_PAD_NAME, sizeof(XONE_PAD_NAME) - 1))
-    {
-      // In Windows, rename joysticks that are named XONE_PAD_NAME.
-      // Such controllers are registered using GE_RegisterJoystick().
-      // It's currently not possible to distinguish Xbox One controllers
-      // from Xbox 360 controllers, as Xinput does not provide controller names.
-      name = "X360 Controller";
-      joysticks[i].type = GE_JS_XONEPAD;
-    }
-#endif
-
-    joysticks[i].name = strdup(_8BIT_to_UTF8(name));
+    joysticks[i].name = strdup(joystick_name(name, &joysticks[i].type));
+    joysticks[i].connected = 1;
 
     // Go backward and look for a joystick with the same name.
     for (j = i - 1; j >= 0; --j)
@@ -144,24 +196,13 @@ int GE_initialize(unsigned char mkb_src)
       // Not found => the virtual index is 0.
       joysticks[i].virtualIndex = 0;
     }
-    if(joysticks[i].type == GE_JS_OTHER)
-    {
-      // Determine if the joystick type.
-      for (j = 0; j < sizeof(js_types) / sizeof(*js_types); ++j)
-      {
-        if (!strcmp(joysticks[i].name, js_types[j].name))
-        {
-          joysticks[i].type = js_types[j].type;
-          break;
-        }
-      }
-    }
     i++;
   }
   i = 0;
   while (i < GE_MAX_DEVICES && (name = ev_mouse_name(i)))
   {
     mice[i].name = strdup(_8BIT_to_UTF8(name));
+    mice[i].connected = 1;
 
     // Go backward and look for a mouse with the same name.
     for (j = i - 1; j >= 0; --j)
@@ -184,6 +225,7 @@ int GE_initialize(unsigned char mkb_src)
   while (i < GE_MAX_DEVICES && (name = ev_keyboard_name(i)))
   {
     keyboards[i].name = strdup(_8BIT_to_UTF8(name));
+    keyboards[i].connected = 1;
 
     // Go backward and look for a keyboard with the same name.
     for (j = i - 1; j >= 0; --j)
@@ -214,6 +256,7 @@ int GE_initialize(unsigned char mkb_src)
 void GE_release_unused()
 {
   int i;
+  hotplug.released = 1;
   for (i = 0; i < GE_MAX_DEVICES && joysticks[i].name; ++i)
   {
     if (!joysticks[i].isUsed)
@@ -287,6 +330,8 @@ void GE_quit()
   }
   GE_FreeMKames();
   ev_quit();
+  coalesce_quit();
+  queue_quit();
 
   initialized = 0;
 }
@@ -389,6 +434,251 @@ int GE_RegisterJoystick(const char* name, int (*rumble_cb)(int, unsigned short,
   return ev_joystick_register(name, rumble_cb);
 }
 
+#ifndef WIN32
+typedef struct
+{
+  char** name;
+  int* virtualIndex;
+  unsigned char* connected;
+} s_device_ref;
+
+static s_device_ref device_ref(GE_DeviceType type, int id)
+{
+  switch (type)
+  {
+    case GE_DEVICE_KEYBOARD:
+      return (s_device_ref) { &keyboards[id].name, &keyboards[id].virtualIndex, &keyboards[id].connected };
+    case GE_DEVICE_MOUSE:
+      return (s_device_ref) { &mice[id].name, &mice[id].virtualIndex, &mice[id].connected };
+    case GE_DEVICE_JOYSTICK:
+    default:
+      return (s_device_ref) { &joysticks[id].name, &joysticks[id].virtualIndex, &joysticks[id].connected };
+  }
+}
+
+/*
+ * Add an entry at the end of a device table.
+ * The virtual index is computed from the entries that have the same name.
+ * Returns the index of the entry, or -1 if the table is full.
+ */
+static int add_entry(GE_DeviceType type, const char* name, unsigned char connected)
+{
+  int i, j;
+
+  if (type == GE_DEVICE_JOYSTICK)
+  {
+    // Joystick indexes are allocated by the joystick layer.
+    i = ev_joystick_reserve();
+  }
+  else
+  {
+    for (i = 0; i < GE_MAX_DEVICES && *device_ref(type, i).name; ++i) ;
+  }
+  if (i < 0 || i >= GE_MAX_DEVICES)
+  {
+    return -1;
+  }
+
+  s_device_ref device = device_ref(type, i);
+  *device.name = strdup(name);
+  *device.virtualIndex = 0;
+  *device.connected = connected;
+
+  // Go backward and look for a device with the same name.
+  for (j = i - 1; j >= 0; --j)
+  {
+    s_device_ref other = device_ref(type, j);
+    if (*other.name && !strcmp(*other.name, name))
+    {
+      *device.virtualIndex = *other.virtualIndex + 1;
+      break;
+    }
+  }
+
+  if (type == GE_DEVICE_JOYSTICK)
+  {
+    joysticks[i].type = joystick_type(name);
+  }
+
+  return i;
+}
+
+/*
+ * Called by the hotplug code when a device is connected.
+ * The device gets the index of the first disconnected (or reserved) device that has the same name,
+ * so that the bindings of this device apply. Otherwise a new index is allocated.
+ * Returns the index of the device, or -1 if the device has to be ignored.
+ */
+int ge_hotplug_add(GE_DeviceType type, const char* name)
+{
+  GE_JS_Type js_type = GE_JS_OTHER;
+  int i;
+  int id = -1;
+
+  if (type == GE_DEVICE_JOYSTICK)
+  {
+    name = joystick_name(name, &js_type);
+  }
+  else
+  {
+    name = _8BIT_to_UTF8(name);
+  }
+
+  for (i = 0; i < GE_MAX_DEVICES && id < 0; ++i)
+  {
+    s_device_ref device = device_ref(type, i);
+    if (*device.name && !*device.connected && !strcmp(*device.name, name))
+    {
+      id = i;
+    }
+  }
+
+  if (id < 0)
+  {
+    if (type == GE_DEVICE_JOYSTICK && hotplug.released)
+    {
+      // The bindings are already resolved: the joystick is unused.
+      return -1;
+    }
+    id = add_entry(type, name, 1);
+    if (id < 0)
+    {
+      return -1;
+    }
+  }
+
+  *device_ref(type, id).connected = 1;
+
+  if (type == GE_DEVICE_JOYSTICK)
+  {
+    joysticks[id].type = js_type;
+  }
+
+  if (hotplug.callback)
+  {
+    hotplug.callback(type, id, 1);
+  }
+
+  return id;
+}
+
+/*
+ * Called by the hotplug code when a device is disconnected.
+ * The entry is kept, so that the device gets the same index when it is connected again.
+ */
+void ge_hotplug_remove(GE_DeviceType type, int id)
+{
+  if (id >= 0 && id < GE_MAX_DEVICES)
+  {
+    *device_ref(type, id).connected = 0;
+
+    if (hotplug.callback)
+    {
+      hotplug.callback(type, id, 0);
+    }
+  }
+}
+#endif
+
+/*
+ * \brief Add and remove the input devices while running.
+ *        A device that is disconnected keeps its index, and gets it back when it is connected again,
+ *        so that its bindings still apply. Joysticks that are connected after the call to GE_release_unused
+ *        are ignored, except the ones that were connected before or that were reserved (see GE_ReserveDevice).
+ *
+ * \remark This function has to be called before calling GE_initialize.
+ *         The callback is called from the main thread, even if the input thread is enabled (see GE_SetInputThread).
+ *
+ * \param callback  called each time a device is connected or disconnected (can be NULL)
+ *
+ * \return 0 in case of success, -1 if the library was already initialized,
+ *         or if hotplug is not available (Windows).
+ */
+int GE_SetHotplug(void (*callback)(GE_DeviceType type, int id, int connected))
+{
+  if(initialized)
+  {
+    fprintf(stderr, "GE_SetHotplug has to be called before GE_initialize.\n");
+    return -1;
+  }
+
+#ifndef WIN32
+  if (ev_set_hotplug() < 0)
+  {
+    return -1;
+  }
+  hotplug.enabled = 1;
+  hotplug.callback = callback;
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Reserve an index for a device that is not connected yet.
+ *        The device gets this index when it gets connected.
+ *        If the device is a joystick, it is marked as used (see GE_SetJoystickUsed).
+ *
+ * \remark Hotplug has to be enabled (see GE_SetHotplug).
+ *
+ * \param type          the device type
+ * \param name          the device name (UTF-8)
+ * \param virtualIndex  the virtual index of the device
+ *
+ * \return the device index, or -1 if hotplug is not enabled or if there is no room.
+ */
+int GE_ReserveDevice(GE_DeviceType type, const char* name, int virtualIndex)
+{
+#ifndef WIN32
+  int i;
+  int id = -1;
+  int nb = 0;
+
+  if (!hotplug.enabled || virtualIndex < 0)
+  {
+    return -1;
+  }
+
+  for (i = 0; i < GE_MAX_DEVICES; ++i)
+  {
+    s_device_ref device = device_ref(type, i);
+    if (*device.name && !strcmp(*device.name, name))
+    {
+      if (*device.virtualIndex == virtualIndex)
+      {
+        id = i;
+        break;
+      }
+      ++nb;
+    }
+  }
+
+  // Reserve all the missing virtual indexes up to the requested one.
+  while (id < 0 && nb <= virtualIndex)
+  {
+    if ((i = add_entry(type, name, 0)) < 0)
+    {
+      return -1;
+    }
+    if (nb == virtualIndex)
+    {
+      id = i;
+    }
+    ++nb;
+  }
+
+  if (type == GE_DEVICE_JOYSTICK)
+  {
+    GE_SetJoystickUsed(id);
+  }
+
+  return id;
+#else
+  return -1;
+#endif
+}
+
 /*
  * \brief Get the mouse virtual id for a given index.
  * 
@@ -501,13 +791,61 @@ int GE_GetDeviceId(GE_Event* e)
  * 
  * \param event  the event
  *
- * \return 0 in case of success, -1 in case of error.
+ * \return 0 in case of success, -1 in case of error (the queue is full).
  */
 int GE_PushEvent(GE_Event *event)
 {
   return queue_push_event(event);
 }
 
+/*
+ * \brief Push events into the event queue.
+ *        The events that don't fit are dropped (see GE_GetEventQueueStats).
+ *
+ * \param events     the events
+ * \param numevents  the number of events
+ *
+ * \return the number of pushed events.
+ */
+int GE_PushEvents(GE_Event *events, int numevents)
+{
+  return queue_push_events(events, numevents);
+}
+
+/*
+ * \brief Set the capacity of the event queue.
+ *
+ * \remark This function has to be called before calling GE_initialize.
+ *
+ * \param capacity        the number of events the queue can hold (rounded up to a power of two)
+ * \param multi_producer  allow calling GE_PushEvent and GE_PushEvents from several threads
+ *
+ * \return 0 in case of success, -1 in case of error.
+ */
+int GE_SetEventQueue(unsigned int capacity, int multi_producer)
+{
+  if(initialized)
+  {
+    fprintf(stderr, "GE_SetEventQueue has to be called before GE_initialize.\n");
+    return -1;
+  }
+
+  return queue_configure(capacity, multi_producer);
+}
+
+/*
+ * \brief Get the event queue statistics.
+ *
+ * \param stats  where to store the statistics
+ *
+ * \return 0.
+ */
+int GE_GetEventQueueStats(GE_QueueStats* stats)
+{
+  queue_get_stats(stats);
+  return 0;
+}
+
 /*
  * \brief Set a callback function for processing events.
  *
@@ -515,6 +853,11 @@ int GE_PushEvent(GE_Event *event)
  */
 void GE_SetCallback(int(*fp)(GE_Event*))
 {
+  if(coalesce_enabled() && fp != GE_PushEvent)
+  {
+    coalesce_set_callback(fp);
+    fp = coalesce_process_event;
+  }
   ev_set_callback(fp);
 }
 
@@ -551,6 +894,18 @@ void GE_RemoveSource(int fd)
   ev_remove_source(fd);
 }
 
+/*
+ * \brief Get the current time of a monotonic clock.
+ *        This is the time base of the timestamp field of the events,
+ *        including the kernel timestamps of the input devices.
+ *
+ * \return the time in nanoseconds.
+ */
+uint64_t GE_GetTime()
+{
+  return timer_now();
+}
+
 /*
  * \brief Start a timer to make GE_PumpEvents return periodically.
  * 
@@ -586,6 +941,32 @@ void GE_TimerClose()
   timer_close(0);
 }
 
+/*
+ * \brief Get the timer statistics. This allows the caller to detect missed periods,
+ *        and to decide whether to catch up or to skip them.
+ *
+ * \param stats  where to store the statistics
+ *
+ * \return 0 in case of success, -1 if the timer is not started or if statistics are not available.
+ */
+int GE_TimerGetStats(GE_TimerStats* stats)
+{
+  return timer_get_stats(stats);
+}
+
+/*
+ * \brief Make the timer expire before each period boundary, without moving the boundaries.
+ *        This allows the caller to wake up a bit before a deadline.
+ *
+ * \param usec  the offset (microseconds), lower than the period
+ *
+ * \return 0 in case of success, -1 if the timer is not started or if offsets are not supported.
+ */
+int GE_TimerSetOffset(int usec)
+{
+  return timer_set_offset(usec);
+}
+
 /*
  * \brief Tell if a joystick has rumble capabilities.
  * 
@@ -631,6 +1012,212 @@ int GE_JoystickSetRumble(int id, unsigned short weak, unsigned short strong)
 void GE_PumpEvents()
 {
   ev_pump_events();
+  coalesce_flush();
+}
+
+/*
+ * \brief Process the events that are already pending, without blocking.
+ *        The timer is not read, so that its next expiration still makes GE_PumpEvents return.
+ *        In Windows, this function does nothing.
+ */
+void GE_PumpPendingEvents()
+{
+#ifndef WIN32
+  ev_pump_pending_events();
+  coalesce_flush();
+#endif
+}
+
+/*
+ * \brief Coalesce the joystick axis motions until the end of each GE_PumpEvents
+ *        or GE_PumpPendingEvents call: only the latest motion of each axis is processed.
+ *        A joystick button or hat event first processes the pending motions of its joystick.
+ *        This has no effect if the events are queued (GE_PushEvent callback).
+ *
+ * \remark This function has to be called before calling GE_initialize.
+ *
+ * \return 0 in case of success, -1 if the library was already initialized.
+ */
+int GE_SetAxisCoalescing()
+{
+  if(initialized)
+  {
+    fprintf(stderr, "GE_SetAxisCoalescing has to be called before GE_initialize.\n");
+    return -1;
+  }
+
+  coalesce_enable();
+  return 0;
+}
+
+/*
+ * \brief Get the axis coalescing statistics of a joystick.
+ *
+ * \param joystick  the joystick index
+ * \param stats     where to store the statistics
+ *
+ * \return 0 in case of success, -1 if axis coalescing is disabled or the index is invalid.
+ */
+int GE_GetAxisStats(int joystick, GE_AxisStats* stats)
+{
+  return coalesce_get_stats(joystick, stats);
+}
+
+/*
+ * \brief Allow an event to pass the event filter (see GE_SetEventFilter).
+ *
+ * \param type    the event type (GE_KEYDOWN, GE_MOUSEBUTTONDOWN, GE_JOYBUTTONDOWN or GE_JOYAXISMOTION),
+ *                the corresponding release events are also allowed
+ * \param device  the device index (as returned by GE_GetDeviceId), or -1 for all devices of the type
+ * \param code    the key, the button or the axis
+ *
+ * \return 0 in case of success, -1 if the event type can't be filtered or if the code is out of range.
+ */
+int GE_AllowEvent(unsigned char type, int device, int code)
+{
+  return filter_allow(type, device, code);
+}
+
+/*
+ * \brief Enable or disable the event filter.
+ *        If enabled, the input devices drop the key, button and joystick axis events
+ *        that were not allowed with GE_AllowEvent. Mouse motions are never dropped.
+ *        In Windows, the filter has no effect.
+ *
+ * \param enabled  the filter is enabled if not 0
+ */
+void GE_SetEventFilter(int enabled)
+{
+  filter_enable(enabled);
+}
+
+/*
+ * \brief Get the event filter statistics.
+ *
+ * \param stats  where to store the statistics
+ *
+ * \return 0 in case of success, -1 if the filter is not available (Windows).
+ */
+int GE_GetFilterStats(GE_FilterStats* stats)
+{
+#ifndef WIN32
+  filter_get_stats(stats);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Read the input devices from a dedicated thread.
+ *        The events are handed over to the thread that calls GE_PumpEvents,
+ *        when the timer expires, or as soon as they are read if there is no timer.
+ *
+ * \remark This function has to be called before calling GE_initialize.
+ *
+ * \return 0 in case of success, -1 if the library was already initialized,
+ *         or if this mode is not available (Windows).
+ */
+int GE_SetInputThread()
+{
+  if(initialized)
+  {
+    fprintf(stderr, "GE_SetInputThread has to be called before GE_initialize.\n");
+    return -1;
+  }
+
+#ifndef WIN32
+  return ev_set_input_thread();
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Get the input thread statistics.
+ *
+ * \param stats  where to store the statistics
+ *
+ * \return 0 in case of success, -1 if the input thread is not running.
+ */
+int GE_GetInputStats(GE_InputStats* stats)
+{
+#ifndef WIN32
+  return ev_get_input_stats(stats);
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Get the mouse and keyboard statistics.
+ *        The relative motions of a mouse are merged into a single motion event per frame.
+ *
+ * \param stats  where to store the statistics
+ *
+ * \return 0 in case of success, -1 if the inputs are not read from the evdev devices
+ *         (window system source, or Windows).
+ */
+int GE_GetEvdevStats(GE_EvdevStats* stats)
+{
+#ifndef WIN32
+  return ev_get_evdev_stats(stats);
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Wait for the sources and perform the asynchronous writes with io_uring instead of epoll.
+ *        The input thread, if enabled, still uses epoll.
+ *
+ * \remark This function has to be called before calling GE_initialize,
+ *         and before any source is added.
+ *
+ * \return 0 in case of success, -1 if the library was already initialized,
+ *         or if io_uring is not available (old kernel, Windows).
+ */
+int GE_SetIOUring()
+{
+  if(initialized)
+  {
+    fprintf(stderr, "GE_SetIOUring has to be called before GE_initialize.\n");
+    return -1;
+  }
+
+#ifndef WIN32
+  return ev_set_io_uring();
+#else
+  return -1;
+#endif
+}
+
+/*
+ * \brief Write data asynchronously. The data is copied, and the write is submitted
+ *        by the next GE_PumpEvents call, along with the wait for the sources.
+ *        Writes to a given file descriptor are performed in order.
+ *
+ * \param fd     the file descriptor to write to
+ * \param buf    the data to write
+ * \param count  the number of bytes to write
+ *
+ * \return 0 in case of success, -1 otherwise, with errno set to:
+ *         - ENOTSUP if the io_uring backend is not enabled (see GE_SetIOUring),
+ *           or if the write can't be queued; the caller has to perform the write,
+ *         - EAGAIN if the write can't be queued and writes are pending for fd;
+ *           a synchronous write would be performed before them,
+ *         - the error of a previous write to fd, which is reported only once.
+ *
+ *         The pending writes are dropped when fd is removed (see GE_RemoveSource).
+ */
+int GE_WriteAsync(int fd, const void* buf, unsigned int count)
+{
+#ifndef WIN32
+  return ev_write_async(fd, buf, count);
+#else
+  errno = ENOTSUP;
+  return -1;
+#endif
 }
 
 /*
@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#include <coalesce.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The joystick axis motions are coalesced until the end of the tick:
+ * only the latest motion of each (joystick, axis) is emitted, when the events have been pumped,
+ * with the timestamp of the first coalesced motion.
+ * A button or hat event of a joystick first emits the pending motions of this joystick,
+ * so that the order of the buttons relatively to the axes is preserved.
+ */
+
+#define COALESCE_MAX_AXES 64 //the axes beyond are not coalesced
+
+typedef struct
+{
+  uint64_t pending; //a bit per axis
+  GE_Event events[COALESCE_MAX_AXES]; //the latest value of each axis, with the timestamp of the first motion
+  unsigned long long received;
+  unsigned long long emitted;
+} s_joystick_axes;
+
+static struct
+{
+  int enabled;
+  int (*callback)(GE_Event*);
+  s_joystick_axes* joysticks[GE_MAX_DEVICES]; //allocated on the first motion
+  unsigned char pending[GE_MAX_DEVICES]; //the joysticks that have pending motions
+  unsigned int nb_pending;
+} coalesce = {};
+
+void coalesce_enable()
+{
+  coalesce.enabled = 1;
+}
+
+int coalesce_enabled()
+{
+  return coalesce.enabled;
+}
+
+void coalesce_set_callback(int (*fp)(GE_Event*))
+{
+  coalesce.callback = fp;
+}
+
+static void flush_joystick(s_joystick_axes* joystick)
+{
+  uint64_t pending = joystick->pending;
+
+  joystick->pending = 0;
+
+  while(pending)
+  {
+    int axis = __builtin_ctzll(pending);
+    pending &= pending - 1;
+    ++joystick->emitted;
+    coalesce.callback(joystick->events + axis);
+  }
+}
+
+/*
+ * Emit the pending motions of a joystick, before one of its other events.
+ */
+static void flush_pending(int which)
+{
+  s_joystick_axes* joystick = coalesce.joysticks[which];
+  unsigned int i;
+
+  if(!joystick || !joystick->pending)
+  {
+    return;
+  }
+
+  for(i = 0; i < coalesce.nb_pending; ++i)
+  {
+    if(coalesce.pending[i] == which)
+    {
+      coalesce.pending[i] = coalesce.pending[--coalesce.nb_pending];
+      break;
+    }
+  }
+
+  flush_joystick(joystick);
+}
+
+/*
+ * This is the event callback if coalescing is enabled.
+ */
+int coalesce_process_event(GE_Event* event)
+{
+  s_joystick_axes* joystick;
+
+  switch(event->type)
+  {
+    case GE_JOYAXISMOTION:
+      if(event->jaxis.axis >= COALESCE_MAX_AXES)
+      {
+        flush_pending(event->jaxis.which);
+        break;
+      }
+      joystick = coalesce.joysticks[event->jaxis.which];
+      if(!joystick)
+      {
+        joystick = coalesce.joysticks[event->jaxis.which] = calloc(1, sizeof(*joystick));
+        if(!joystick)
+        {
+          break;
+        }
+      }
+      ++joystick->received;
+      if(!joystick->pending)
+      {
+        coalesce.pending[coalesce.nb_pending++] = event->jaxis.which;
+      }
+      if(joystick->pending & (1ULL << event->jaxis.axis))
+      {
+        // Keep the timestamp of the first motion, for the latency to be measured from it.
+        joystick->events[event->jaxis.axis].jaxis.value = event->jaxis.value;
+      }
+      else
+      {
+        joystick->pending |= 1ULL << event->jaxis.axis;
+        joystick->events[event->jaxis.axis] = *event;
+      }
+      return 0;
+    case GE_JOYBUTTONDOWN:
+    case GE_JOYBUTTONUP:
+      flush_pending(event->jbutton.which);
+      break;
+    case GE_JOYHATMOTION:
+      flush_pending(event->jhat.which);
+      break;
+    default:
+      break;
+  }
+
+  return coalesce.callback(event);
+}
+
+/*
+ * Emit all the pending motions.
+ */
+void coalesce_flush()
+{
+  while(coalesce.nb_pending)
+  {
+    flush_joystick(coalesce.joysticks[coalesce.pending[--coalesce.nb_pending]]);
+  }
+}
+
+int coalesce_get_stats(int joystick, GE_AxisStats* stats)
+{
+  if(!coalesce.enabled || joystick < 0 || joystick >= GE_MAX_DEVICES)
+  {
+    return -1;
+  }
+
+  memset(stats, 0x00, sizeof(*stats));
+
+  if(coalesce.joysticks[joystick])
+  {
+    stats->received = coalesce.joysticks[joystick]->received;
+    stats->emitted = coalesce.joysticks[joystick]->emitted;
+  }
+
+  return 0;
+}
+
+void coalesce_quit()
+{
+  int i;
+
+  for(i = 0; i < GE_MAX_DEVICES; ++i)
+  {
+    free(coalesce.joysticks[i]);
+    coalesce.joysticks[i] = NULL;
+  }
+  coalesce.nb_pending = 0;
+}
@@ -0,0 +1,19 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef COALESCE_H_
+#define COALESCE_H_
+
+#include <GE.h>
+
+void coalesce_enable();
+int coalesce_enabled();
+void coalesce_set_callback(int (*fp)(GE_Event*));
+int coalesce_process_event(GE_Event* event);
+void coalesce_flush();
+int coalesce_get_stats(int joystick, GE_AxisStats* stats);
+void coalesce_quit();
+
+#endif /* COALESCE_H_ */
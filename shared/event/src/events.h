@@ -23,6 +23,24 @@ int ev_joystick_set_ff_rumble(int joystick, unsigned short weak, unsigned short
 void ev_grab_input(int);
 void ev_set_callback(int (*)(GE_Event*));
 void ev_pump_events();
+#ifndef WIN32
+void ev_pump_pending_events();
+int ev_set_input_thread();
+int ev_get_input_stats(GE_InputStats* stats);
+int ev_get_evdev_stats(GE_EvdevStats* stats);
+void ev_register_input_source(int fd, int id, int (*fp_read)(int), int (*fp_cleanup)(int));
+void ev_push_deferred_event(GE_Event* event);
+int ev_set_io_uring();
+int ev_write_async(int fd, const void* buf, unsigned int count);
+int ev_set_hotplug();
+int ev_joystick_reserve();
+
+/*
+ * Implemented in GE.c, called when a device is connected or disconnected (see GE_SetHotplug).
+ */
+int ge_hotplug_add(GE_DeviceType type, const char* name);
+void ge_hotplug_remove(GE_DeviceType type, int id);
+#endif
 
 void ev_register_source(int fd, int id, int (*fp_read)(int), int (*fp_write)(int), int (*fp_cleanup)(int));
 #ifdef WIN32
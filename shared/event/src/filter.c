@@ -0,0 +1,146 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#include <filter.h>
+#include <stddef.h>
+
+/*
+ * The events that are not allowed are dropped by the sources, before being turned into GE events.
+ * Only the keys, the mouse buttons, the joystick buttons and the joystick axes are filtered:
+ * the mouse motions always pass.
+ * The filter is a bitset per event type and per device. The row at index ANY_DEVICE
+ * holds the events that are allowed for all devices of a type (e.g. macro triggers).
+ */
+
+#define LONG_BITS (sizeof(long) * 8)
+#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
+
+#define MAX_KEYS 1024
+#define MAX_CODES 256 //mouse buttons, joystick buttons and joystick axes are 8-bit
+
+#define ANY_DEVICE GE_MAX_DEVICES
+
+static struct
+{
+  int enabled;
+  unsigned long keys[GE_MAX_DEVICES + 1][NLONGS(MAX_KEYS)];
+  unsigned long mouse_buttons[GE_MAX_DEVICES + 1][NLONGS(MAX_CODES)];
+  unsigned long joystick_buttons[GE_MAX_DEVICES + 1][NLONGS(MAX_CODES)];
+  unsigned long joystick_axes[GE_MAX_DEVICES + 1][NLONGS(MAX_CODES)];
+  unsigned long long passed;
+  unsigned long long dropped;
+} filter = {};
+
+static inline void stats_inc(unsigned long long* counter)
+{
+  __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Get the bitset of a type of event for a device.
+ * The keyboards and the mice are merged into device 0 in single input mode (see GE_GetDeviceId).
+ */
+static unsigned long* get_bits(unsigned char type, int device, int* size)
+{
+  switch(type)
+  {
+    case GE_KEYDOWN:
+    case GE_KEYUP:
+      if(device != ANY_DEVICE && GE_GetMKMode() == GE_MK_MODE_SINGLE_INPUT)
+      {
+        device = 0;
+      }
+      *size = MAX_KEYS;
+      return filter.keys[device];
+    case GE_MOUSEBUTTONDOWN:
+    case GE_MOUSEBUTTONUP:
+      if(device != ANY_DEVICE && GE_GetMKMode() == GE_MK_MODE_SINGLE_INPUT)
+      {
+        device = 0;
+      }
+      *size = MAX_CODES;
+      return filter.mouse_buttons[device];
+    case GE_JOYBUTTONDOWN:
+    case GE_JOYBUTTONUP:
+      *size = MAX_CODES;
+      return filter.joystick_buttons[device];
+    case GE_JOYAXISMOTION:
+      *size = MAX_CODES;
+      return filter.joystick_axes[device];
+    default:
+      return NULL;
+  }
+}
+
+static inline int test_bit(const unsigned long* bits, int code)
+{
+  return (bits[code / LONG_BITS] >> (code % LONG_BITS)) & 1;
+}
+
+void filter_enable(int enabled)
+{
+  filter.enabled = enabled;
+}
+
+/*
+ * Allow an event. A negative device allows the event for all devices of the type.
+ * Returns 0 in case of success, -1 if the event type can't be filtered, or if the code is out of range.
+ */
+int filter_allow(unsigned char type, int device, int code)
+{
+  unsigned long* bits;
+  int size;
+
+  if(device >= GE_MAX_DEVICES)
+  {
+    return -1;
+  }
+
+  bits = get_bits(type, device < 0 ? ANY_DEVICE : device, &size);
+  if(!bits || code < 0 || code >= size)
+  {
+    return -1;
+  }
+
+  bits[code / LONG_BITS] |= 1UL << (code % LONG_BITS);
+
+  return 0;
+}
+
+/*
+ * Tell if a source has to emit an event.
+ * This is called by the sources, possibly from the input thread.
+ */
+int filter_pass(unsigned char type, int device, int code)
+{
+  unsigned long* bits;
+  int size;
+
+  if(!filter.enabled)
+  {
+    return 1;
+  }
+
+  bits = get_bits(type, device, &size);
+  if(!bits || code < 0 || code >= size)
+  {
+    return 1;
+  }
+
+  if(test_bit(bits, code) || test_bit(get_bits(type, ANY_DEVICE, &size), code))
+  {
+    stats_inc(&filter.passed);
+    return 1;
+  }
+
+  stats_inc(&filter.dropped);
+  return 0;
+}
+
+void filter_get_stats(GE_FilterStats* stats)
+{
+  stats->passed = __atomic_load_n(&filter.passed, __ATOMIC_RELAXED);
+  stats->dropped = __atomic_load_n(&filter.dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,16 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <GE.h>
+
+void filter_enable(int enabled);
+int filter_allow(unsigned char type, int device, int code);
+int filter_pass(unsigned char type, int device, int code);
+void filter_get_stats(GE_FilterStats* stats);
+
+#endif /* FILTER_H_ */
@@ -3,13 +3,14 @@
  License: GPLv3
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <termios.h>
-#include <poll.h>
+#include <sys/epoll.h>
 #include "events.h"
 #include <timer.h>
 #include <sys/signalfd.h>
@@ -20,53 +21,555 @@
 #include "js.h"
 #include "xinput.h"
 #include <queue.h>
+#include <ring.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <X11/Xlib.h>
+#include "uring.h"
+#include "hotplug.h"
 
-static struct
+/*
+ * Sources are registered once in an epoll instance, and the epoll events point to the source entries.
+ */
+typedef struct
 {
+  int fd;
   int id;
   int (*fp_read)(int);
   int (*fp_write)(int);
   int (*fp_cleanup)(int);
-  short int event;
-} sources[FD_SETSIZE] = {};
+  unsigned int event;
+  int input; //the source is read by the input thread, if enabled
+} s_source;
+
+static s_source sources[FD_SETSIZE] = {};
 
-static int max_source = 0;
+/*
+ * The maximum number of events per epoll_wait call.
+ */
+#define MAX_EPOLL_EVENTS 64
 
 static unsigned char mkb_source;
 
-void ev_register_source(int fd, int id, int (*fp_read)(int), int (*fp_write)(int), int (*fp_cleanup)(int))
+static int hotplug_enabled = 0;
+
+/*
+ * The source table is shared with the input thread, if enabled.
+ */
+static pthread_mutex_t sources_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * In threaded mode, the input devices are read by a dedicated thread,
+ * which pushes the events into a ring. The ring is drained by the main thread,
+ * at each timer expiration, or each time the input thread signals it if there is no timer.
+ */
+static struct
+{
+  int enabled;
+  int started;
+  pthread_t thread;
+  int epfd; //the input sources
+  int notify_fd; //signaled by the input thread after each read, if the main thread polls it
+  int notify_registered; //the notification is polled by the main thread (there is no timer)
+  int stop_fd; //signaled by the main thread to stop the input thread
+  s_ring ring;
+} input_thread = { .epfd = -1, .notify_fd = -1, .stop_fd = -1 };
+
+/*
+ * The epoll instance of the main thread.
+ * It is created on first use, as sources may be registered before ev_init.
+ */
+static int main_epfd = -1;
+
+/*
+ * These markers identify the input thread notifications in epoll events.
+ */
+static char notify_marker;
+static char stop_marker;
+
+static int get_epfd(int input)
+{
+  if(input && input_thread.enabled)
+  {
+    if(input_thread.epfd < 0)
+    {
+      input_thread.epfd = epoll_create1(EPOLL_CLOEXEC);
+      if(input_thread.epfd < 0)
+      {
+        perror("epoll_create1");
+      }
+    }
+    return input_thread.epfd;
+  }
+  if(main_epfd < 0)
+  {
+    main_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(main_epfd < 0)
+    {
+      perror("epoll_create1");
+    }
+  }
+  return main_epfd;
+}
+
+/*
+ * Add a file descriptor to an epoll instance.
+ * The ptr value is returned with the events.
+ */
+static int epoll_add(int epfd, int fd, unsigned int events, void* ptr)
+{
+  struct epoll_event ev = { .events = events, .data.ptr = ptr };
+
+  if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    if(errno != EEXIST || epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+    {
+      perror("epoll_ctl");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * The io_uring backend (see ev_set_io_uring) replaces the epoll instance of the main thread.
+ * Each source has a poll request in the ring. Poll requests are one-shot, and they are re-armed
+ * once the source was processed, so that a source that still has data is reported again.
+ * Re-arm requests are submitted by the next wait, in the same system call.
+ * The timer expires at each period, so it uses a multishot poll request if the kernel supports it.
+ * Completions are identified by a tag, and for polls, by the fd and a generation number,
+ * so that the completions of a removed source are ignored.
+ */
+#define URING_ENTRIES 256
+
+#define URING_TAG_POLL   0
+#define URING_TAG_WRITE  1
+#define URING_TAG_NOTIFY 2
+#define URING_TAG_IGNORE 3
+#define URING_TAG_BITS   2
+#define URING_TAG_MASK   ((1 << URING_TAG_BITS) - 1)
+
+#define URING_WRITE_SLOTS 64
+#define URING_WRITE_SIZE 1024
+
+typedef struct
+{
+  int fd; //-1 if the slot is free
+  unsigned int count;
+  int next; //index + 1 of the next write to the same fd, 0 if none
+  int cancelled; //1 if the fd was removed while the write was in flight
+  unsigned char buf[URING_WRITE_SIZE];
+} s_write_slot;
+
+static struct
+{
+  int enabled;
+  int multishot; //0 if the kernel rejected a multishot poll request
+  s_uring ring;
+  struct
+  {
+    unsigned int generation;
+    int armed;
+    int multishot;
+  } polls[FD_SETSIZE];
+  /*
+   * Writes to a given fd are performed in order, with a single write in flight.
+   */
+  struct
+  {
+    int head; //index + 1 of the write in flight, 0 if none
+    int tail;
+    int error; //errno of the last failed write, reported by the next ev_write_async call
+  } writes[FD_SETSIZE];
+  s_write_slot slots[URING_WRITE_SLOTS];
+} uring_backend = { .multishot = 1 };
+
+static __u64 uring_poll_data(int fd)
+{
+  return ((__u64)uring_backend.polls[fd].generation << 32) | ((__u64)fd << URING_TAG_BITS) | URING_TAG_POLL;
+}
+
+static int uring_poll_add(int fd, unsigned int events, __u64 data, int multishot)
+{
+  struct io_uring_sqe* sqe = uring_get_sqe(&uring_backend.ring);
+
+  if(!sqe)
+  {
+    fprintf(stderr, "%s: can't get a submission entry\n", __FUNCTION__);
+    return -1;
+  }
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  if(multishot)
+  {
+    sqe->len = IORING_POLL_ADD_MULTI;
+  }
+  sqe->user_data = data;
+
+  return 0;
+}
+
+static void uring_poll_remove(__u64 data)
+{
+  struct io_uring_sqe* sqe = uring_get_sqe(&uring_backend.ring);
+
+  if(!sqe)
+  {
+    fprintf(stderr, "%s: can't get a submission entry\n", __FUNCTION__);
+    return;
+  }
+
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = data;
+  sqe->user_data = URING_TAG_IGNORE;
+}
+
+static void uring_arm_source(int fd)
+{
+  if(!uring_poll_add(fd, sources[fd].event, uring_poll_data(fd), uring_backend.polls[fd].multishot))
+  {
+    uring_backend.polls[fd].armed = 1;
+  }
+}
+
+static void uring_remove_source(int fd)
+{
+  if(uring_backend.polls[fd].armed)
+  {
+    uring_poll_remove(uring_poll_data(fd));
+    uring_backend.polls[fd].armed = 0;
+  }
+  // The completions of the previous poll request, if any, will be ignored.
+  ++uring_backend.polls[fd].generation;
+}
+
+static void uring_add_source(int fd)
+{
+  uring_remove_source(fd);
+  uring_backend.polls[fd].multishot = (uring_backend.multishot && fd == timer_get());
+  uring_arm_source(fd);
+}
+
+/*
+ * Add a source to the main thread, using the selected backend.
+ */
+static void main_add_source(int fd)
+{
+  if(uring_backend.enabled)
+  {
+    uring_add_source(fd);
+  }
+  else
+  {
+    epoll_add(get_epfd(0), fd, sources[fd].event, sources + fd);
+  }
+}
+
+static void register_source(int fd, int id, int (*fp_read)(int), int (*fp_write)(int), int (*fp_cleanup)(int), int input)
 {
   if(!fp_cleanup)
   {
     fprintf(stderr, "%s: the cleanup function is mandatory.", __FUNCTION__);
     return;
   }
-  if(fd < FD_SETSIZE)
+  if(fd >= 0 && fd < FD_SETSIZE)
   {
+    pthread_mutex_lock(&sources_mutex);
+    sources[fd].fd = fd;
     sources[fd].id = id;
     if(fp_read)
     {
-      sources[fd].event |= POLLIN;
+      sources[fd].event |= EPOLLIN;
       sources[fd].fp_read = fp_read;
     }
     if(fp_write)
     {
-      sources[fd].event |= POLLOUT;
+      sources[fd].event |= EPOLLOUT;
       sources[fd].fp_write = fp_write;
     }
     sources[fd].fp_cleanup = fp_cleanup;
-    if(fd > max_source)
+    sources[fd].input = input;
+    if(input && input_thread.enabled)
     {
-      max_source = fd;
+      epoll_add(get_epfd(input), fd, sources[fd].event, sources + fd);
     }
+    else
+    {
+      main_add_source(fd);
+    }
+    pthread_mutex_unlock(&sources_mutex);
   }
 }
 
+void ev_register_source(int fd, int id, int (*fp_read)(int), int (*fp_write)(int), int (*fp_cleanup)(int))
+{
+  register_source(fd, id, fp_read, fp_write, fp_cleanup, 0);
+}
+
+/*
+ * Register a source that produces input events (a mouse, a keyboard or a joystick).
+ */
+void ev_register_input_source(int fd, int id, int (*fp_read)(int), int (*fp_cleanup)(int))
+{
+  register_source(fd, id, fp_read, NULL, fp_cleanup, 1);
+}
+
+static void uring_cancel_writes(int fd);
+
 void ev_remove_source(int fd)
 {
-  if(fd < FD_SETSIZE)
+  if(fd >= 0 && fd < FD_SETSIZE)
   {
+    pthread_mutex_lock(&sources_mutex);
+    // Asynchronous writes are only performed from the main thread.
+    if(uring_backend.enabled && !(sources[fd].input && input_thread.enabled))
+    {
+      uring_cancel_writes(fd);
+    }
+    if(sources[fd].event && uring_backend.enabled && !(sources[fd].input && input_thread.enabled))
+    {
+      uring_remove_source(fd);
+    }
+    else if(sources[fd].event)
+    {
+      int epfd = get_epfd(sources[fd].input);
+      // The file descriptor may already be closed, in which case it was removed from the epoll instance.
+      if(epfd >= 0 && epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) < 0 && errno != EBADF && errno != ENOENT)
+      {
+        perror("epoll_ctl");
+      }
+    }
     memset(sources+fd, 0x00, sizeof(*sources));
+    pthread_mutex_unlock(&sources_mutex);
+  }
+}
+
+/*
+ * Enable the input thread. This has to be done before ev_init.
+ */
+int ev_set_input_thread()
+{
+  input_thread.enabled = 1;
+  return 0;
+}
+
+/*
+ * Watch for input devices being connected. This has to be done before ev_init.
+ */
+int ev_set_hotplug()
+{
+  hotplug_enabled = 1;
+  return 0;
+}
+
+/*
+ * Use io_uring instead of epoll in the main thread. This has to be done before any source is registered.
+ * Returns -1 if io_uring is not available.
+ */
+int ev_set_io_uring()
+{
+  int i;
+
+  if(uring_init(&uring_backend.ring, URING_ENTRIES) < 0)
+  {
+    return -1;
+  }
+  for(i = 0; i < URING_WRITE_SLOTS; ++i)
+  {
+    uring_backend.slots[i].fd = -1;
+  }
+  uring_backend.enabled = 1;
+  return 0;
+}
+
+static void uring_write_submit(int index)
+{
+  s_write_slot* slot = uring_backend.slots + index;
+  struct io_uring_sqe* sqe = uring_get_sqe(&uring_backend.ring);
+
+  if(!sqe)
+  {
+    fprintf(stderr, "%s: can't get a submission entry\n", __FUNCTION__);
+    return;
+  }
+
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = slot->fd;
+  sqe->addr = (unsigned long) slot->buf;
+  sqe->len = slot->count;
+  sqe->off = -1; //use the file position, for non-seekable files
+  sqe->user_data = ((__u64)index << URING_TAG_BITS) | URING_TAG_WRITE;
+}
+
+/*
+ * Write data asynchronously. The data is copied, and the write is submitted by the next wait.
+ * Writes to a given fd are performed in the order they were requested.
+ * Returns 0 on success, or -1 with errno set to:
+ * - ENOTSUP if the io_uring backend is not enabled, if count is too large,
+ *   or if there is no free write slot and no write is pending for fd,
+ * - EAGAIN if there is no free write slot and writes are pending for fd,
+ * - the errno of a previous write to fd that failed.
+ */
+int ev_write_async(int fd, const void* buf, unsigned int count)
+{
+  int i;
+
+  if(!uring_backend.enabled || fd < 0 || fd >= FD_SETSIZE || count > URING_WRITE_SIZE)
+  {
+    errno = ENOTSUP;
+    return -1;
+  }
+
+  if(uring_backend.writes[fd].error)
+  {
+    errno = uring_backend.writes[fd].error;
+    uring_backend.writes[fd].error = 0;
+    return -1;
+  }
+
+  for(i = 0; i < URING_WRITE_SLOTS; ++i)
+  {
+    if(uring_backend.slots[i].fd < 0)
+    {
+      break;
+    }
+  }
+  if(i == URING_WRITE_SLOTS)
+  {
+    // A synchronous write would be performed before the pending ones.
+    errno = uring_backend.writes[fd].head ? EAGAIN : ENOTSUP;
+    return -1;
+  }
+
+  s_write_slot* slot = uring_backend.slots + i;
+  slot->fd = fd;
+  slot->count = count;
+  slot->next = 0;
+  slot->cancelled = 0;
+  memcpy(slot->buf, buf, count);
+
+  if(uring_backend.writes[fd].head)
+  {
+    uring_backend.slots[uring_backend.writes[fd].tail - 1].next = i + 1;
+    uring_backend.writes[fd].tail = i + 1;
+  }
+  else
+  {
+    uring_backend.writes[fd].head = i + 1;
+    uring_backend.writes[fd].tail = i + 1;
+    uring_write_submit(i);
+  }
+
+  return 0;
+}
+
+static void uring_write_complete(int index, int res)
+{
+  s_write_slot* slot = uring_backend.slots + index;
+  int fd = slot->fd;
+
+  if(slot->cancelled)
+  {
+    // The fd may have been reused, and its writes don't follow this one.
+    slot->fd = -1;
+    return;
+  }
+
+  if(res < 0)
+  {
+    fprintf(stderr, "write: %s\n", strerror(-res));
+    uring_backend.writes[fd].error = -res;
+  }
+  else if((unsigned int)res < slot->count)
+  {
+    fprintf(stderr, "%s: short write (%d/%u)\n", __FUNCTION__, res, slot->count);
+    uring_backend.writes[fd].error = EIO;
+  }
+
+  uring_backend.writes[fd].head = slot->next;
+  if(!slot->next)
+  {
+    uring_backend.writes[fd].tail = 0;
+  }
+  slot->fd = -1;
+
+  if(uring_backend.writes[fd].head)
+  {
+    uring_write_submit(uring_backend.writes[fd].head - 1);
+  }
+}
+
+/*
+ * Drop the writes that are queued for an fd that is about to be closed.
+ * The write in flight can't be recalled: its completion is ignored.
+ */
+static void uring_cancel_writes(int fd)
+{
+  int index = uring_backend.writes[fd].head;
+
+  if(index)
+  {
+    uring_backend.slots[index - 1].cancelled = 1;
+    index = uring_backend.slots[index - 1].next;
+    while(index)
+    {
+      s_write_slot* slot = uring_backend.slots + index - 1;
+      index = slot->next;
+      slot->fd = -1;
+    }
+  }
+
+  uring_backend.writes[fd].head = 0;
+  uring_backend.writes[fd].tail = 0;
+  uring_backend.writes[fd].error = 0;
+}
+
+/*
+ * Wait for the completion of the pending writes. Other completions are discarded.
+ */
+static void uring_flush_writes()
+{
+  struct io_uring_cqe* cqe;
+  struct io_uring_cqe copy;
+  int i;
+
+  while(1)
+  {
+    for(i = 0; i < URING_WRITE_SLOTS; ++i)
+    {
+      if(uring_backend.slots[i].fd >= 0)
+      {
+        break;
+      }
+    }
+    if(i == URING_WRITE_SLOTS)
+    {
+      break;
+    }
+
+    if(uring_enter(&uring_backend.ring, 1) < 0)
+    {
+      if(errno != EINTR)
+      {
+        perror("io_uring_enter");
+        break;
+      }
+      continue;
+    }
+
+    while((cqe = uring_peek_cqe(&uring_backend.ring)))
+    {
+      copy = *cqe;
+      uring_cqe_seen(&uring_backend.ring);
+
+      if((copy.user_data & URING_TAG_MASK) == URING_TAG_WRITE)
+      {
+        uring_write_complete((copy.user_data & 0xffffffff) >> URING_TAG_BITS, copy.res);
+      }
+    }
   }
 }
 
@@ -76,6 +579,14 @@ int ev_init(unsigned char mkb_src)
 
   mkb_source = mkb_src;
 
+  if(input_thread.enabled && mkb_source == GE_MKB_SOURCE_WINDOW_SYSTEM)
+  {
+    /*
+     * The display connection is used by both threads.
+     */
+    XInitThreads();
+  }
+
   if(mkb_source == GE_MKB_SOURCE_PHYSICAL)
   {
     ret = mkb_init();
@@ -105,6 +616,11 @@ int ev_init(unsigned char mkb_src)
     return 0;
   }
 
+  if(hotplug_enabled && hotplug_init(mkb_source == GE_MKB_SOURCE_PHYSICAL) < 0)
+  {
+    fprintf(stderr, "hotplug_init failed, input devices can't be added while running.\n");
+  }
+
   queue_init();
 
   return 1;
@@ -120,6 +636,11 @@ void ev_joystick_close(int id)
   js_close(id);
 }
 
+int ev_joystick_reserve()
+{
+  return js_reserve();
+}
+
 void ev_grab_input(int mode)
 {
   if(mkb_source == GE_MKB_SOURCE_PHYSICAL)
@@ -132,8 +653,13 @@ void ev_grab_input(int mode)
   }
 }
 
+static void input_thread_stop();
+
 void ev_quit(void)
 {
+  hotplug_quit();
+  input_thread_stop();
+
   if(mkb_source == GE_MKB_SOURCE_PHYSICAL)
   {
     mkb_quit();
@@ -143,6 +669,14 @@ void ev_quit(void)
     xinput_quit();
   }
   js_quit();
+
+  if(uring_backend.enabled)
+  {
+    uring_flush_writes();
+    // Later writes are performed synchronously by the callers.
+    uring_backend.enabled = 0;
+    uring_close(&uring_backend.ring);
+  }
 }
 
 const char* ev_joystick_name(int index)
@@ -188,50 +722,509 @@ int ev_joystick_set_ff_rumble(int joystick, unsigned short weak, unsigned short
 
 static int (*event_callback)(GE_Event*) = NULL;
 
-void ev_set_callback(int (*fp)(GE_Event*))
+/*
+ * This is the event callback of the input devices in threaded mode.
+ */
+static int input_thread_push_event(GE_Event* event)
 {
-  event_callback = fp;
-  if(mkb_source == GE_MKB_SOURCE_PHYSICAL)
+  ring_push(&input_thread.ring, event, 0);
+  return 0;
+}
+
+/*
+ * Queue an event that has to be processed after the events of the current read
+ * (e.g. a wheel button release).
+ */
+void ev_push_deferred_event(GE_Event* event)
+{
+  if(input_thread.enabled)
   {
-    mkb_set_callback(fp);
+    ring_push(&input_thread.ring, event, 1);
+  }
+  else
+  {
+    queue_push_event(event);
+  }
+}
+
+static int input_thread_start();
+static void input_thread_fallback();
+
+void ev_set_callback(int (*fp)(GE_Event*))
+{
+  event_callback = fp;
+
+  if(input_thread.enabled)
+  {
+    if(input_thread.started)
+    {
+      return;
+    }
+    fp = input_thread_push_event;
+  }
+
+  if(mkb_source == GE_MKB_SOURCE_PHYSICAL)
+  {
+    mkb_set_callback(fp);
   }
   else if(mkb_source == GE_MKB_SOURCE_WINDOW_SYSTEM)
   {
     xinput_set_callback(fp);
   }
   js_set_callback(fp);
+
+  if(input_thread.enabled && input_thread_start() < 0)
+  {
+    fprintf(stderr, "failed to start the input thread, reading inputs from the main thread\n");
+    input_thread_fallback();
+    ev_set_callback(event_callback);
+  }
+}
+
+/*
+ * Process the events pushed by the input thread.
+ */
+static void input_thread_drain()
+{
+  s_ring_entry entry;
+
+  while(ring_pop(&input_thread.ring, &entry))
+  {
+    if(entry.deferred)
+    {
+      queue_push_event(&entry.event);
+    }
+    else
+    {
+      event_callback(&entry.event);
+    }
+  }
 }
 
-static unsigned int fill_fds(nfds_t nfds, struct pollfd fds[nfds])
+/*
+ * Dispatch an epoll event to its source.
+ * Returns the value returned by the source callback.
+ */
+static int dispatch(struct epoll_event* ev)
 {
-  unsigned int pos = 0;
+  s_source* source = ev->data.ptr;
+  int res;
 
+  if(!source->event)
+  {
+    // The source was removed while processing a previous event.
+    return 0;
+  }
+  if(ev->events & (EPOLLERR | EPOLLHUP))
+  {
+    /*
+     * Remove the source before the cleanup function closes the file descriptor,
+     * as the number may be reused right away by a device added by another thread (hotplug).
+     */
+    int id = source->id;
+    int (*fp_cleanup)(int) = source->fp_cleanup;
+    ev_remove_source(source->fd);
+    return fp_cleanup(id);
+  }
+  if((ev->events & EPOLLIN) && source->fp_read)
+  {
+    res = source->fp_read(source->id);
+    if(res)
+    {
+      return res;
+    }
+  }
+  if((ev->events & EPOLLOUT) && source->fp_write)
+  {
+    return source->fp_write(source->id);
+  }
+  return 0;
+}
+
+static void* input_thread_loop(void* unused)
+{
   int i;
-  for(i=0; i<nfds; ++i)
+  int nfds;
+  uint64_t value = 1;
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+
+  while(1)
+  {
+    nfds = epoll_wait(input_thread.epfd, events, MAX_EPOLL_EVENTS, -1);
+
+    if(nfds < 0)
+    {
+      if(errno != EINTR)
+      {
+        perror("epoll_wait");
+        break;
+      }
+      continue;
+    }
+
+    for(i=0; i<nfds; ++i)
+    {
+      if(events[i].data.ptr == &stop_marker)
+      {
+        return NULL;
+      }
+      dispatch(events + i);
+    }
+
+    /*
+     * If there's a timer, the main thread drains the ring at each expiration: don't wake it up.
+     */
+    if(__atomic_load_n(&input_thread.notify_registered, __ATOMIC_ACQUIRE)
+        && write(input_thread.notify_fd, &value, sizeof(value)) < 0)
+    {
+      perror("write");
+    }
+  }
+
+  return NULL;
+}
+
+static int input_thread_start()
+{
+  input_thread.notify_fd = eventfd(0, EFD_NONBLOCK);
+  input_thread.stop_fd = eventfd(0, 0);
+
+  if(input_thread.notify_fd < 0 || input_thread.stop_fd < 0)
+  {
+    perror("eventfd");
+  }
+  else if(get_epfd(1) < 0 || epoll_add(input_thread.epfd, input_thread.stop_fd, EPOLLIN | EPOLLET, &stop_marker) < 0)
+  {
+    fprintf(stderr, "can't poll the input sources\n");
+  }
+  else if(pthread_create(&input_thread.thread, NULL, input_thread_loop, NULL))
+  {
+    fprintf(stderr, "pthread_create failed\n");
+  }
+  else
+  {
+    pthread_setname_np(input_thread.thread, "GE input");
+    input_thread.started = 1;
+    return 0;
+  }
+
+  if(input_thread.notify_fd >= 0)
+  {
+    close(input_thread.notify_fd);
+    input_thread.notify_fd = -1;
+  }
+  if(input_thread.stop_fd >= 0)
+  {
+    close(input_thread.stop_fd);
+    input_thread.stop_fd = -1;
+  }
+  return -1;
+}
+
+/*
+ * Move the input sources to the main thread.
+ */
+static void input_thread_fallback()
+{
+  int fd;
+
+  pthread_mutex_lock(&sources_mutex);
+  input_thread.enabled = 0;
+  for(fd = 0; fd < FD_SETSIZE; ++fd)
+  {
+    if(sources[fd].event && sources[fd].input)
+    {
+      main_add_source(fd);
+    }
+  }
+  pthread_mutex_unlock(&sources_mutex);
+
+  if(input_thread.epfd >= 0)
+  {
+    close(input_thread.epfd);
+    input_thread.epfd = -1;
+  }
+}
+
+static void input_thread_remove_notification();
+
+static void input_thread_stop()
+{
+  uint64_t value = 1;
+
+  if(!input_thread.started)
+  {
+    return;
+  }
+
+  if(write(input_thread.stop_fd, &value, sizeof(value)) < 0)
+  {
+    perror("write");
+  }
+  pthread_join(input_thread.thread, NULL);
+
+  if(input_thread.notify_registered)
+  {
+    input_thread_remove_notification();
+  }
+
+  close(input_thread.notify_fd);
+  close(input_thread.stop_fd);
+  input_thread.notify_fd = -1;
+  input_thread.stop_fd = -1;
+  input_thread.started = 0;
+}
+
+int ev_get_evdev_stats(GE_EvdevStats* stats)
+{
+  if(mkb_source != GE_MKB_SOURCE_PHYSICAL)
+  {
+    return -1;
+  }
+  return mkb_get_stats(stats);
+}
+
+int ev_get_input_stats(GE_InputStats* stats)
+{
+  if(!input_thread.started)
+  {
+    return -1;
+  }
+  stats->events = __atomic_load_n(&input_thread.ring.producer.events, __ATOMIC_RELAXED);
+  stats->overflows = __atomic_load_n(&input_thread.ring.producer.overflows, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/*
+ * Clear the notification of the input thread.
+ */
+static void input_thread_read_notification()
+{
+  uint64_t value;
+
+  if(read(input_thread.notify_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+  {
+    perror("read");
+  }
+}
+
+static void input_thread_add_notification()
+{
+  int ret;
+
+  if(uring_backend.enabled)
+  {
+    ret = uring_poll_add(input_thread.notify_fd, EPOLLIN, URING_TAG_NOTIFY, 0);
+  }
+  else
   {
-    if(sources[i].event)
+    ret = epoll_add(get_epfd(0), input_thread.notify_fd, EPOLLIN | EPOLLET, &notify_marker);
+  }
+  if(!ret)
+  {
+    __atomic_store_n(&input_thread.notify_registered, 1, __ATOMIC_RELEASE);
+    /*
+     * The events that were pushed before the registration were not signaled.
+     */
+    uint64_t value = 1;
+    if(write(input_thread.notify_fd, &value, sizeof(value)) < 0)
     {
-      fds[pos].fd = i;
-      fds[pos].events = sources[i].event;
-      ++pos;
+      perror("write");
     }
   }
+}
+
+static void input_thread_remove_notification()
+{
+  if(uring_backend.enabled)
+  {
+    uring_poll_remove(URING_TAG_NOTIFY);
+  }
+  else
+  {
+    epoll_ctl(main_epfd, EPOLL_CTL_DEL, input_thread.notify_fd, NULL);
+  }
+  __atomic_store_n(&input_thread.notify_registered, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Poll the input thread notification from the main thread only if there is no timer.
+ */
+static void input_thread_update_notification()
+{
+  int needed = (timer_get() < 0);
+
+  if(needed == input_thread.notify_registered)
+  {
+    return;
+  }
 
-  return pos;
+  if(needed)
+  {
+    input_thread_add_notification();
+  }
+  else
+  {
+    input_thread_remove_notification();
+  }
+}
+
+/*
+ * Process an io_uring completion.
+ * Returns the value returned by the source callback, or 1 for an input thread notification.
+ */
+static int uring_complete(struct io_uring_cqe* cqe)
+{
+  __u64 data = cqe->user_data;
+  struct epoll_event ev;
+  unsigned int generation;
+  int fd;
+  int res;
+
+  switch(data & URING_TAG_MASK)
+  {
+    case URING_TAG_WRITE:
+      uring_write_complete((data & 0xffffffff) >> URING_TAG_BITS, cqe->res);
+      return 0;
+    case URING_TAG_NOTIFY:
+      if(!input_thread.notify_registered || cqe->res < 0)
+      {
+        return 0;
+      }
+      input_thread_read_notification();
+      input_thread_drain();
+      uring_poll_add(input_thread.notify_fd, EPOLLIN, URING_TAG_NOTIFY, 0);
+      return 1;
+    case URING_TAG_IGNORE:
+      return 0;
+  }
+
+  fd = (data & 0xffffffff) >> URING_TAG_BITS;
+  generation = data >> 32;
+
+  if(fd >= FD_SETSIZE || generation != uring_backend.polls[fd].generation || !sources[fd].event)
+  {
+    // The source was removed.
+    return 0;
+  }
+
+  if(!(cqe->flags & IORING_CQE_F_MORE))
+  {
+    uring_backend.polls[fd].armed = 0;
+  }
+
+  if(cqe->res < 0)
+  {
+    if(cqe->res == -EINVAL && uring_backend.polls[fd].multishot)
+    {
+      // Multishot poll requests are not supported by this kernel.
+      uring_backend.multishot = 0;
+      uring_backend.polls[fd].multishot = 0;
+      uring_arm_source(fd);
+      return 0;
+    }
+    fprintf(stderr, "poll: %s\n", strerror(-cqe->res));
+    ev.events = EPOLLERR;
+  }
+  else
+  {
+    ev.events = cqe->res;
+  }
+  ev.data.ptr = sources + fd;
+
+  res = dispatch(&ev);
+
+  if(sources[fd].event && generation == uring_backend.polls[fd].generation && !uring_backend.polls[fd].armed)
+  {
+    uring_arm_source(fd);
+  }
+
+  return res;
+}
+
+static void uring_pump_events()
+{
+  struct io_uring_cqe* cqe;
+  struct io_uring_cqe copy;
+
+  while(1)
+  {
+    // Submit the re-arm and write requests, and wait for a completion.
+    if(uring_enter(&uring_backend.ring, 1) < 0)
+    {
+      if(errno != EINTR)
+      {
+        perror("io_uring_enter");
+        return;
+      }
+      continue;
+    }
+
+    while((cqe = uring_peek_cqe(&uring_backend.ring)))
+    {
+      copy = *cqe;
+      uring_cqe_seen(&uring_backend.ring);
+
+      if(uring_complete(&copy))
+      {
+        if(input_thread.started)
+        {
+          input_thread_drain();
+        }
+        return;
+      }
+    }
+  }
+}
+
+/*
+ * The completions are processed up to the timer one, which is left in the ring
+ * so that the next ev_pump_events call returns.
+ */
+static void uring_pump_pending_events()
+{
+  struct io_uring_cqe* cqe;
+  struct io_uring_cqe copy;
+  int tfd = timer_get();
+
+  if(uring_enter(&uring_backend.ring, 0) < 0 && errno != EINTR)
+  {
+    perror("io_uring_enter");
+    return;
+  }
+
+  while((cqe = uring_peek_cqe(&uring_backend.ring)))
+  {
+    __u64 data = cqe->user_data;
+
+    if((data & URING_TAG_MASK) == URING_TAG_NOTIFY
+        || ((data & URING_TAG_MASK) == URING_TAG_POLL && tfd >= 0 && (int)((data & 0xffffffff) >> URING_TAG_BITS) == tfd))
+    {
+      break;
+    }
+
+    copy = *cqe;
+    uring_cqe_seen(&uring_backend.ring);
+
+    uring_complete(&copy);
+  }
 }
 
 /*
  * If a timer wasn't set (tfd < 0):
  * - this function blocks until an event is received
  * - it only reads a single event and returns
+ *   (in threaded mode, it processes the events of a read of the input thread)
  * If a timer was set (tfd > 0):
  * - this function processes each received event
+ *   (in threaded mode, the events are processed when the timer expires)
  * - it returns as soon as the timer expires
  */
 void ev_pump_events(void)
 {
   int i;
-  int res;
+  int nfds;
+  struct epoll_event events[MAX_EPOLL_EVENTS];
 
   if(event_callback == NULL)
   {
@@ -239,42 +1232,102 @@ void ev_pump_events(void)
     return;
   }
 
+  if(input_thread.started)
+  {
+    input_thread_update_notification();
+  }
+
+  if(uring_backend.enabled)
+  {
+    uring_pump_events();
+    return;
+  }
+
   while(1)
   {
-    struct pollfd fds[max_source+1];
+    nfds = epoll_wait(get_epfd(0), events, MAX_EPOLL_EVENTS, -1);
 
-    nfds_t nfds = fill_fds(max_source+1, fds);
+    if(nfds < 0)
+    {
+      if(errno != EINTR)
+      {
+        perror("epoll_wait");
+        return;
+      }
+      continue;
+    }
 
-    if(poll(fds, nfds, -1) > 0)
+    for(i=0; i<nfds; ++i)
     {
-      for(i=0; i<nfds; ++i)
+      if(events[i].data.ptr == &notify_marker)
       {
-        if(fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
-        {
-          res = sources[fds[i].fd].fp_cleanup(sources[fds[i].fd].id);
-          ev_remove_source(fds[i].fd);
-          if(res)
-          {
-            return;
-          }
-          continue;
-        }
-        if(fds[i].revents & POLLIN)
-        {
-          if(sources[fds[i].fd].fp_read(sources[fds[i].fd].id))
-		  		{
-            return;
-          }
-        }
-        if(fds[i].revents & POLLOUT)
+        input_thread_read_notification();
+        input_thread_drain();
+        return;
+      }
+      if(dispatch(events + i))
+      {
+        if(input_thread.started)
         {
-          if(sources[fds[i].fd].fp_write(sources[fds[i].fd].id))
-          {
-            return;
-          }
+          input_thread_drain();
         }
+        return;
       }
     }
   }
+}
+
+/*
+ * Process the input of each source that is ready, without blocking.
+ * The timer is skipped, as reading it would consume its next expiration
+ * (it is level-triggered, so that it is reported again by the next ev_pump_events call).
+ */
+void ev_pump_pending_events(void)
+{
+  int i;
+  int nfds;
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  int tfd = timer_get();
+
+  if(event_callback == NULL)
+  {
+    fprintf(stderr, "ev_set_callback should be called first!\n");
+    return;
+  }
 
+  if(input_thread.started)
+  {
+    input_thread_drain();
+  }
+
+  if(uring_backend.enabled)
+  {
+    uring_pump_pending_events();
+    return;
+  }
+
+  nfds = epoll_wait(get_epfd(0), events, MAX_EPOLL_EVENTS, 0);
+
+  for(i=0; i<nfds; ++i)
+  {
+    if(events[i].data.ptr == &notify_marker)
+    {
+      continue;
+    }
+    s_source* source = events[i].data.ptr;
+    if(source->fd == tfd && source->event)
+    {
+      continue;
+    }
+    if(events[i].events & (EPOLLERR | EPOLLHUP))
+    {
+      dispatch(events + i);
+      continue;
+    }
+    if(events[i].events & EPOLLIN)
+    {
+      events[i].events = EPOLLIN;
+      dispatch(events + i);
+    }
+  }
 }
@@ -0,0 +1,359 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#define _GNU_SOURCE
+#include <GE.h>
+#include <events.h>
+#include "hotplug.h"
+#include "mkb.h"
+#include "js.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#define DEV_INPUT "/dev/input"
+#define EVENT_DEV_NAME "event"
+
+/*
+ * The maximum number of probed devices waiting to be added by the main thread.
+ */
+#define MAX_PENDING 16
+
+typedef struct
+{
+  int is_js;
+  union
+  {
+    s_mkb_probe mkb;
+    s_js_probe js;
+  };
+} s_pending;
+
+/*
+ * The /dev/input directory is watched by a dedicated thread, which also probes the new devices,
+ * as opening a device and querying its properties (name, capabilities, rumble effects) can take a while.
+ * The probed devices are added by the main thread, which is signaled through an eventfd.
+ * The disconnected devices are removed by the main thread as well, as they may be detected
+ * by the input thread: the device tables of GE are only modified by the main thread,
+ * and a device is closed when the main thread doesn't use it anymore (e.g. to play rumble).
+ */
+static struct
+{
+  int mkb; //the event devices are probed as mice and keyboards
+  int started;
+  pthread_t thread;
+  int inotify_fd;
+  int notify_fd; //signaled by the hotplug thread when devices are pending
+  int stop_fd; //signaled by the main thread to stop the hotplug thread
+  pthread_mutex_t mutex;
+  s_pending pending[MAX_PENDING];
+  unsigned int nb_pending;
+  int removed[2][GE_MAX_DEVICES]; //the disconnected mice/keyboards and joysticks, by index
+  unsigned int nb_removed[2];
+} hotplug = { .inotify_fd = -1, .notify_fd = -1, .stop_fd = -1, .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static void close_pending(s_pending* pending)
+{
+  close(pending->is_js ? pending->js.fd : pending->mkb.fd);
+}
+
+/*
+ * Hand a probed device over to the main thread.
+ */
+static void push_pending(const char* node, s_pending* pending)
+{
+  uint64_t value = 1;
+  int pushed = 0;
+
+  pthread_mutex_lock(&hotplug.mutex);
+  if(hotplug.nb_pending < MAX_PENDING)
+  {
+    hotplug.pending[hotplug.nb_pending++] = *pending;
+    pushed = 1;
+  }
+  pthread_mutex_unlock(&hotplug.mutex);
+
+  if(!pushed)
+  {
+    fprintf(stderr, "%s: too many pending devices, ignoring %s/%s\n", __func__, DEV_INPUT, node);
+    close_pending(pending);
+  }
+  else if(write(hotplug.notify_fd, &value, sizeof(value)) < 0)
+  {
+    perror("write");
+  }
+}
+
+/*
+ * Hand a disconnected device over to the main thread, which removes it with mkb_remove_device or js_remove_device.
+ * This is called by the cleanup callback of the device, possibly from the input thread.
+ * Returns 0 in case of success, -1 if hotplug is not started, in which case the caller has to remove the device.
+ */
+int hotplug_remove(int is_js, int index)
+{
+  uint64_t value = 1;
+  int ret = -1;
+
+  pthread_mutex_lock(&hotplug.mutex);
+  if(hotplug.started && hotplug.nb_removed[is_js] < GE_MAX_DEVICES)
+  {
+    hotplug.removed[is_js][hotplug.nb_removed[is_js]++] = index;
+    ret = 0;
+  }
+  pthread_mutex_unlock(&hotplug.mutex);
+
+  if(ret == 0 && write(hotplug.notify_fd, &value, sizeof(value)) < 0)
+  {
+    perror("write");
+  }
+
+  return ret;
+}
+
+/*
+ * Probe an event device that was created or whose permissions changed.
+ * It can be both a mouse/keyboard and a joystick, in which case it is opened twice.
+ * Devices that are not supported, or that are not accessible yet (udev may change the permissions
+ * after the node is created) are ignored.
+ * This is called by the hotplug thread.
+ */
+static void probe(const char* node)
+{
+  static s_pending pending;
+
+  if(strncmp(node, EVENT_DEV_NAME, sizeof(EVENT_DEV_NAME) - 1))
+  {
+    return;
+  }
+
+  if(hotplug.mkb)
+  {
+    pending.is_js = 0;
+    if(mkb_probe(node, &pending.mkb) == 0)
+    {
+      push_pending(node, &pending);
+    }
+  }
+
+  pending.is_js = 1;
+  if(js_probe(node, &pending.js) == 0)
+  {
+    push_pending(node, &pending);
+  }
+}
+
+static void* hotplug_loop(void* unused)
+{
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  struct pollfd fds[] =
+  {
+    { .fd = hotplug.inotify_fd, .events = POLLIN },
+    { .fd = hotplug.stop_fd, .events = POLLIN },
+  };
+  const struct inotify_event* event;
+  ssize_t len;
+  char* ptr;
+
+  while(1)
+  {
+    if(poll(fds, sizeof(fds) / sizeof(*fds), -1) < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      perror("poll");
+      break;
+    }
+
+    if(fds[1].revents)
+    {
+      break;
+    }
+
+    if(fds[0].revents & POLLIN)
+    {
+      len = read(hotplug.inotify_fd, buf, sizeof(buf));
+      if(len < 0)
+      {
+        if(errno == EINTR || errno == EAGAIN)
+        {
+          continue;
+        }
+        perror("read");
+        break;
+      }
+      for(ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len)
+      {
+        event = (const struct inotify_event*) ptr;
+        if(event->len && !(event->mask & IN_ISDIR))
+        {
+          probe(event->name);
+        }
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Remove the disconnected devices, and add the probed devices. This is called by the main thread.
+ * The removals are processed first, so that a device that is connected again gets its index back.
+ */
+static int hotplug_read(int unused)
+{
+  static s_pending pending[MAX_PENDING];
+  static int removed[2][GE_MAX_DEVICES];
+  unsigned int nb_removed[2];
+  unsigned int nb;
+  unsigned int i;
+  uint64_t value;
+
+  if(read(hotplug.notify_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+  {
+    perror("read");
+  }
+
+  pthread_mutex_lock(&hotplug.mutex);
+  nb = hotplug.nb_pending;
+  memcpy(pending, hotplug.pending, nb * sizeof(*pending));
+  hotplug.nb_pending = 0;
+  for(i = 0; i < 2; ++i)
+  {
+    nb_removed[i] = hotplug.nb_removed[i];
+    memcpy(removed[i], hotplug.removed[i], nb_removed[i] * sizeof(*removed[i]));
+    hotplug.nb_removed[i] = 0;
+  }
+  pthread_mutex_unlock(&hotplug.mutex);
+
+  for(i = 0; i < nb_removed[0]; ++i)
+  {
+    mkb_remove_device(removed[0][i]);
+  }
+  for(i = 0; i < nb_removed[1]; ++i)
+  {
+    js_remove_device(removed[1][i]);
+  }
+
+  for(i = 0; i < nb; ++i)
+  {
+    if(pending[i].is_js)
+    {
+      js_add_device(&pending[i].js);
+    }
+    else
+    {
+      mkb_add_device(&pending[i].mkb);
+    }
+  }
+
+  return 0;
+}
+
+static int hotplug_close(int unused)
+{
+  return 0;
+}
+
+static void close_fds()
+{
+  if(hotplug.inotify_fd >= 0)
+  {
+    close(hotplug.inotify_fd);
+    hotplug.inotify_fd = -1;
+  }
+  if(hotplug.notify_fd >= 0)
+  {
+    close(hotplug.notify_fd);
+    hotplug.notify_fd = -1;
+  }
+  if(hotplug.stop_fd >= 0)
+  {
+    close(hotplug.stop_fd);
+    hotplug.stop_fd = -1;
+  }
+}
+
+/*
+ * Start watching /dev/input. This has to be called after the initial device scan.
+ * The devices that were already opened and that are probed again (e.g. after a permission change)
+ * are ignored by mkb_add_device and js_add_device.
+ *
+ * \param mkb  if not 0, the event devices are probed as mice and keyboards
+ *
+ * Returns 0 in case of success, -1 otherwise.
+ */
+int hotplug_init(int mkb)
+{
+  hotplug.mkb = mkb;
+
+  hotplug.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  hotplug.notify_fd = eventfd(0, EFD_NONBLOCK);
+  hotplug.stop_fd = eventfd(0, 0);
+
+  if(hotplug.inotify_fd < 0 || hotplug.notify_fd < 0 || hotplug.stop_fd < 0)
+  {
+    perror("hotplug_init");
+  }
+  else if(inotify_add_watch(hotplug.inotify_fd, DEV_INPUT, IN_CREATE | IN_ATTRIB | IN_MOVED_TO) < 0)
+  {
+    fprintf(stderr, "can't watch %s: %s\n", DEV_INPUT, strerror(errno));
+  }
+  else if(pthread_create(&hotplug.thread, NULL, hotplug_loop, NULL))
+  {
+    fprintf(stderr, "pthread_create failed\n");
+  }
+  else
+  {
+    pthread_setname_np(hotplug.thread, "GE hotplug");
+    pthread_mutex_lock(&hotplug.mutex);
+    hotplug.started = 1;
+    pthread_mutex_unlock(&hotplug.mutex);
+    ev_register_source(hotplug.notify_fd, 0, &hotplug_read, NULL, &hotplug_close);
+    return 0;
+  }
+
+  close_fds();
+  return -1;
+}
+
+void hotplug_quit()
+{
+  uint64_t value = 1;
+  unsigned int i;
+
+  if(!hotplug.started)
+  {
+    return;
+  }
+
+  if(write(hotplug.stop_fd, &value, sizeof(value)) < 0)
+  {
+    perror("write");
+  }
+  pthread_join(hotplug.thread, NULL);
+
+  ev_remove_source(hotplug.notify_fd);
+
+  pthread_mutex_lock(&hotplug.mutex);
+  for(i = 0; i < hotplug.nb_pending; ++i)
+  {
+    close_pending(hotplug.pending + i);
+  }
+  hotplug.nb_pending = 0;
+  // The disconnected devices that were not removed yet are closed by mkb_quit and js_quit.
+  hotplug.nb_removed[0] = 0;
+  hotplug.nb_removed[1] = 0;
+  hotplug.started = 0;
+  pthread_mutex_unlock(&hotplug.mutex);
+
+  close_fds();
+}
@@ -0,0 +1,13 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef HOTPLUG_H_
+#define HOTPLUG_H_
+
+int hotplug_init(int mkb);
+void hotplug_quit();
+int hotplug_remove(int is_js, int index);
+
+#endif /* HOTPLUG_H_ */
@@ -5,38 +5,61 @@
 
 #include <GE.h>
 #include <events.h>
+#include <filter.h>
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <stdio.h>
-#include <linux/joystick.h>
+#include <linux/input.h>
 #include <poll.h>
 #include "js.h"
+#include "hotplug.h"
 #include <timer.h>
 #include <string.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
 
 #define eprintf(...) if(debug) printf(__VA_ARGS__)
 
 static int debug = 0;
 
-#define AXMAP_SIZE (ABS_MAX + 1)
+#define LONG_BITS (sizeof(long) * 8)
+#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
 
+#define HAT_NB (ABS_HAT3Y - ABS_HAT0X + 1)
+
+/*
+ * The joysticks are read from their event devices.
+ * The buttons, the axes and the hats are numbered the same way as with the legacy joystick interface (jsX).
+ */
 static struct
 {
-  int fd; // the opened joystick, or -1 in case the joystick was created using the js_register() function
+  int fd; // the opened event device, or -1 in case the joystick was created using the js_register() function
+  dev_t rdev; // allows to ignore an already opened joystick when it is probed again
   char* name; // the name of the joystick
+  int kernel_time; //the events are timestamped by the kernel with the monotonic clock
+  s_js_map map;
+  int32_t values[ABS_CNT]; // the raw axis values
+  int16_t corrected[ABS_CNT]; // the last emitted axis values
+  int hat_value[HAT_NB]; // the current hat values, as hats are converted to buttons
+  unsigned long keys[NLONGS(KEY_CNT)]; //the key states, to resync after SYN_DROPPED
+  /*
+   * The axis changes are accumulated until the end of the frame (SYN_REPORT),
+   * so that a single event is emitted per axis and per frame.
+   */
   struct
   {
-    unsigned short button_nb; // the base index of the generated hat buttons equals the number of physical buttons
-    int hat_value[ABS_HAT3Y-ABS_HAT0X]; // the current hat values
-    uint8_t ax_map[AXMAP_SIZE]; // the axis map
-  } hat_info; // allows to convert hat axes to buttons
+    uint64_t pending; // the axes that changed in the current frame (a bit per axis code)
+    uint64_t timestamp; // the time of the first change of the frame
+    int dropping; //the events are dropped until the end of the frame (SYN_DROPPED)
+  } frame;
   struct
   {
-    int fd;
+    int fd; // the event device if it supports rumble, -1 otherwise
     int weak_id;
     int strong_id;
     int (*rumble_cb)(int index, unsigned short weak, unsigned short strong);
@@ -66,81 +89,309 @@ void js_set_callback(int (*fp)(GE_Event*))
   event_callback = fp;
 }
 
-static void js_process_event(int device, struct js_event* je)
+static inline int test_bit(int bit, const unsigned long* array)
+{
+  return (array[bit / LONG_BITS] >> (bit % LONG_BITS)) & 1;
+}
+
+static inline void set_key_state(unsigned long* keys, int code, int value)
+{
+  if(value)
+  {
+    keys[code / LONG_BITS] |= 1UL << (code % LONG_BITS);
+  }
+  else
+  {
+    keys[code / LONG_BITS] &= ~(1UL << (code % LONG_BITS));
+  }
+}
+
+/*
+ * Scale an axis value the same way the legacy joystick interface does,
+ * except that the computation is performed with 64-bit integers,
+ * so that no precision is lost with high-resolution axes.
+ */
+static inline int16_t js_correct(const s_js_axis* axis, int32_t value)
+{
+  int64_t corrected;
+
+  if(!axis->half_range)
+  {
+    corrected = value;
+  }
+  else if(value > axis->flat_max)
+  {
+    corrected = ((int64_t)value - axis->flat_max) * 32768 / axis->half_range;
+  }
+  else if(value < axis->flat_min)
+  {
+    corrected = ((int64_t)value - axis->flat_min) * 32768 / axis->half_range;
+  }
+  else
+  {
+    corrected = 0;
+  }
+
+  if(corrected > 32767)
+  {
+    corrected = 32767;
+  }
+  else if(corrected < -32767)
+  {
+    corrected = -32767;
+  }
+
+  return corrected;
+}
+
+static inline void js_emit(int device, GE_Event* evt)
+{
+  eprintf("event from joystick: %s\n", joystick[device].name);
+  event_callback(evt);
+}
+
+/*
+ * Process a button event.
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int js_process_key(int device, int code, int value, uint64_t timestamp)
 {
-  GE_Event evt = {};
+  GE_Event evt = { .timestamp = timestamp };
+  int button;
+
+  if(value > 1 || code < BTN_MISC || code > KEY_MAX)
+  {
+    return 0;
+  }
+
+  set_key_state(joystick[device].keys, code, value);
 
-  if(je->type & JS_EVENT_INIT)
+  button = joystick[device].map.buttons[code - BTN_MISC];
+  if(!button || !filter_pass(GE_JOYBUTTONDOWN, device, button - 1))
   {
-    return;
+    return 0;
   }
 
-  if(je->type & JS_EVENT_BUTTON)
+  evt.type = value ? GE_JOYBUTTONDOWN : GE_JOYBUTTONUP;
+  evt.jbutton.which = device;
+  evt.jbutton.button = button - 1;
+  js_emit(device, &evt);
+
+  return 1;
+}
+
+/*
+ * Hats are converted to buttons.
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int js_process_hat(int device, int code, int value, uint64_t timestamp)
+{
+  GE_Event evt = { .timestamp = timestamp, .jbutton = { .which = device } };
+  int axis = code - ABS_HAT0X;
+  int previous = joystick[device].hat_value[axis];
+  int emitted = 0;
+
+  value = (value > 0) - (value < 0);
+
+  if(value == previous)
   {
-    evt.type = je->value ? GE_JOYBUTTONDOWN : GE_JOYBUTTONUP;
-    evt.jbutton.which = device;
-    evt.jbutton.button = je->number;
+    return 0;
   }
-  else if(je->type & JS_EVENT_AXIS)
+
+  joystick[device].hat_value[axis] = value;
+
+  // The hat buttons are 'up', 'right', 'down', 'left', for each hat.
+  if(previous)
   {
-    int axis = joystick[device].hat_info.ax_map[je->number];
-    if(axis >= ABS_HAT0X && axis <= ABS_HAT3Y)
+    evt.type = GE_JOYBUTTONUP;
+    evt.jbutton.button = joystick[device].map.button_nb + 4 * (axis / 2) + (axis % 2 ? previous + 1 : 2 - previous) % 4;
+    if(filter_pass(evt.type, device, evt.jbutton.button))
     {
-      // convert hat axes to buttons
-      evt.type = je->value ? GE_JOYBUTTONDOWN : GE_JOYBUTTONUP;
-      int button;
-      int value;
-      axis -= ABS_HAT0X;
-      if(!je->value)
+      js_emit(device, &evt);
+      emitted = 1;
+    }
+  }
+  if(value)
+  {
+    evt.type = GE_JOYBUTTONDOWN;
+    evt.jbutton.button = joystick[device].map.button_nb + 4 * (axis / 2) + (axis % 2 ? value + 1 : 2 - value) % 4;
+    if(filter_pass(evt.type, device, evt.jbutton.button))
+    {
+      js_emit(device, &evt);
+      emitted = 1;
+    }
+  }
+
+  return emitted;
+}
+
+/*
+ * Emit the axes that changed in the frame, if any.
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int js_flush_axes(int device)
+{
+  GE_Event evt = { .type = GE_JOYAXISMOTION, .timestamp = joystick[device].frame.timestamp };
+  uint64_t pending = joystick[device].frame.pending;
+  int emitted = 0;
+  int code;
+
+  joystick[device].frame.pending = 0;
+
+  while(pending)
+  {
+    code = __builtin_ctzll(pending);
+    pending &= pending - 1;
+
+    const s_js_axis* axis = joystick[device].map.axes + code;
+    int16_t value = js_correct(axis, joystick[device].values[code]);
+    if(value == joystick[device].corrected[code])
+    {
+      continue;
+    }
+    joystick[device].corrected[code] = value;
+
+    evt.jaxis.which = device;
+    evt.jaxis.axis = axis->index;
+    evt.jaxis.value = value;
+    /*
+     * Ugly patch for the sixaxis.
+     */
+    if(GE_GetJSType(evt.jaxis.which) == GE_JS_SIXAXIS && evt.jaxis.axis > 3 && evt.jaxis.axis < 23)
+    {
+      evt.jaxis.value = (evt.jaxis.value + 32767) / 2;
+    }
+    js_emit(device, &evt);
+    emitted = 1;
+  }
+
+  return emitted;
+}
+
+/*
+ * Process an event (except synchronization events).
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int js_process_event(int device, struct input_event* ie, uint64_t timestamp)
+{
+  if(joystick[device].frame.dropping)
+  {
+    return 0;
+  }
+
+  switch(ie->type)
+  {
+    case EV_KEY:
+      return js_process_key(device, ie->code, ie->value, timestamp);
+    case EV_ABS:
+      if(ie->code >= ABS_CNT || joystick[device].map.axes[ie->code].index < 0)
       {
-        value = joystick[device].hat_info.hat_value[axis];
-        joystick[device].hat_info.hat_value[axis] = 0;
+        return 0;
       }
-      else
+      if(ie->code >= ABS_HAT0X && ie->code <= ABS_HAT3Y)
       {
-        value = je->value/32767;
-        joystick[device].hat_info.hat_value[axis] = value;
+        return js_process_hat(device, ie->code, ie->value, timestamp);
       }
-      button = axis + value + 2*(axis/2);
-      if(button < 4*(axis/2))
+      if(!filter_pass(GE_JOYAXISMOTION, device, joystick[device].map.axes[ie->code].index))
       {
-        button += 4;
+        return 0;
       }
-      evt.jbutton.which = device;
-      evt.jbutton.button = button + joystick[device].hat_info.button_nb;
-    }
-    else
+      // The axis value is emitted at the end of the frame.
+      if(!joystick[device].frame.pending)
+      {
+        joystick[device].frame.timestamp = timestamp;
+      }
+      joystick[device].values[ie->code] = ie->value;
+      joystick[device].frame.pending |= 1ULL << ie->code;
+      break;
+    default:
+      break;
+  }
+  return 0;
+}
+
+/*
+ * After a SYN_DROPPED, the events that were dropped are replaced
+ * by the differences between the stored states and the actual ones.
+ */
+static int js_resync(int device, uint64_t timestamp)
+{
+  unsigned long keys[NLONGS(KEY_CNT)] = {};
+  struct input_absinfo info;
+  int emitted = 0;
+  int code;
+
+  if(ioctl(joystick[device].fd, EVIOCGKEY(sizeof(keys)), keys) < 0)
+  {
+    eprintf("ioctl EVIOCGKEY failed: %s\n", strerror(errno));
+  }
+  else
+  {
+    for(code = BTN_MISC; code <= KEY_MAX; ++code)
     {
-      evt.type = GE_JOYAXISMOTION;
-      evt.jaxis.which = device;
-      evt.jaxis.axis = je->number;
-      evt.jaxis.value = je->value;
-      /*
-       * Ugly patch for the sixaxis.
-       */
-      if(GE_GetJSType(evt.jaxis.which) == GE_JS_SIXAXIS && evt.jaxis.axis > 3 && evt.jaxis.axis < 23)
+      if(test_bit(code, keys) != test_bit(code, joystick[device].keys))
       {
-        evt.jaxis.value = (evt.jaxis.value + 32767) / 2;
+        emitted |= js_process_key(device, code, test_bit(code, keys), timestamp);
       }
     }
   }
 
-  /*
-   * Process evt.
-   */
-  if(evt.type != GE_NOEVENT)
+  for(code = 0; code < ABS_CNT; ++code)
   {
-    eprintf("event from joystick: %s\n", joystick[device].name);
-    eprintf("type: %d number: %d value: %d\n", je->type, je->number, je->value);
-    event_callback(&evt);
+    if(joystick[device].map.axes[code].index >= 0 && ioctl(joystick[device].fd, EVIOCGABS(code), &info) >= 0)
+    {
+      struct input_event ie = { .type = EV_ABS, .code = code, .value = info.value };
+      emitted |= js_process_event(device, &ie, timestamp);
+    }
+  }
+
+  return emitted | js_flush_axes(device);
+}
+
+/*
+ * Process a synchronization event.
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int js_process_syn(int device, struct input_event* ie, uint64_t timestamp)
+{
+  switch(ie->code)
+  {
+    case SYN_REPORT:
+      if(joystick[device].frame.dropping)
+      {
+        joystick[device].frame.dropping = 0;
+        return js_resync(device, timestamp);
+      }
+      return js_flush_axes(device);
+    case SYN_DROPPED:
+      // The kernel buffer overflowed: drop the events up to the next SYN_REPORT.
+      joystick[device].frame.pending = 0;
+      joystick[device].frame.dropping = 1;
+      break;
+    default:
+      break;
   }
+  return 0;
+}
+
+static struct input_event ie[MAX_EVENTS];
+
+/*
+ * Get the kernel timestamp of an event, in nanoseconds.
+ * It can't be later than the time the event was read.
+ */
+static inline uint64_t event_time(struct input_event* event, uint64_t now)
+{
+  uint64_t time = (uint64_t)event->input_event_sec * 1000000000 + (uint64_t)event->input_event_usec * 1000;
+
+  return time < now ? time : now;
 }
 
-static struct js_event je[MAX_EVENTS];
+static int js_disconnect(int index);
 
 static int js_process_events(int index)
 {
-  unsigned int size = sizeof(je);
+  unsigned int size = sizeof(ie);
   int j;
   int r;
 
@@ -149,27 +400,40 @@ static int js_process_events(int index)
   if(tfd < 0)
   {
     //read a single event
-    size = sizeof(*je);
+    size = sizeof(*ie);
   }
 
-  if((r = read(joystick[index].fd, je, size)) > 0)
+  if((r = read(joystick[index].fd, ie, size)) > 0)
   {
-    for(j=0; j<r/sizeof(*je); ++j)
+    uint64_t now = timer_now();
+
+    for(j=0; j<r/sizeof(*ie); ++j)
     {
-      js_process_event(index, je+j);
+      uint64_t timestamp = joystick[index].kernel_time ? event_time(ie+j, now) : now;
+      int emitted;
 
-      if(event_callback == GE_PushEvent)
+      if(ie[j].type == EV_SYN)
       {
-        return 1;
+        emitted = js_process_syn(index, ie+j, timestamp);
+      }
+      else
+      {
+        emitted = js_process_event(index, ie+j, timestamp);
       }
-    }
 
-    if(r < 0 && errno != EAGAIN)
-    {
-      js_close(index);
+      if(emitted && event_callback == GE_PushEvent)
+      {
+        return 1;
+      }
     }
   }
-  
+  else if(r < 0 && errno != EAGAIN)
+  {
+    fprintf(stderr, "%s: read failed on joystick %d: %s\n", __func__, index, strerror(errno));
+    ev_remove_source(joystick[index].fd);
+    js_disconnect(index);
+  }
+
   return 0;
 }
 
@@ -177,12 +441,6 @@ static int js_process_events(int index)
 #define JS_DEV_NAME "js"
 #define EV_DEV_NAME "event"
 
-#define BITS_PER_LONG (sizeof(long) * 8)
-#define OFF(x)  ((x)%BITS_PER_LONG)
-#define BIT(x)  (1UL<<OFF(x))
-#define LONG(x) ((x)/BITS_PER_LONG)
-#define test_bit(bit, array)    ((array[LONG(bit)] >> OFF(bit)) & 1)
-
 static int is_js_device(const struct dirent *dir) {
   return strncmp(JS_DEV_NAME, dir->d_name, sizeof(JS_DEV_NAME)-1) == 0;
 }
@@ -191,127 +449,304 @@ static int is_ev_device(const struct dirent *dir) {
   return strncmp(EV_DEV_NAME, dir->d_name, sizeof(EV_DEV_NAME)-1) == 0;
 }
 
+/*
+ * Tell if the legacy joystick interface handles an event device,
+ * i.e. if there is a jsX device in /sys/class/input/eventY/device/.
+ */
+static int has_js_sibling(const char* node)
+{
+  char dir_js[sizeof("/sys/class/input/event255/device/")];
+  struct dirent **namelist;
+  int n, i;
+
+  snprintf(dir_js, sizeof(dir_js), "/sys/class/input/%s/device/", node);
+
+  n = scandir(dir_js, &namelist, is_js_device, alphasort);
+  if (n < 0)
+  {
+    return 0;
+  }
+  for(i=0; i<n; ++i)
+  {
+    free(namelist[i]);
+  }
+  free(namelist);
+
+  return n > 0;
+}
+
+/*
+ * The rules of the legacy joystick interface, for the case it isn't loaded.
+ */
+static int is_joystick(const unsigned long* ev_bits, const unsigned long* key_bits, const unsigned long* abs_bits,
+    const unsigned long* prop_bits)
+{
+  // Avoid accelerometers, touchpads, tablets and absolute mice.
+  if(test_bit(INPUT_PROP_ACCELEROMETER, prop_bits)
+      || test_bit(BTN_TOUCH, key_bits)
+      || test_bit(BTN_TOOL_PEN, key_bits)
+      || (test_bit(BTN_LEFT, key_bits) && !test_bit(BTN_JOYSTICK, key_bits) && !test_bit(BTN_GAMEPAD, key_bits)))
+  {
+    return 0;
+  }
+
+  if(test_bit(EV_ABS, ev_bits)
+      && (test_bit(ABS_X, abs_bits) || test_bit(ABS_Z, abs_bits)
+          || test_bit(ABS_WHEEL, abs_bits) || test_bit(ABS_THROTTLE, abs_bits)))
+  {
+    return 1;
+  }
+
+  return test_bit(EV_KEY, ev_bits)
+      && (test_bit(BTN_JOYSTICK, key_bits) || test_bit(BTN_GAMEPAD, key_bits) || test_bit(BTN_TRIGGER_HAPPY, key_bits));
+}
+
+/*
+ * Number the buttons and the axes like the legacy joystick interface does:
+ * - the buttons from BTN_JOYSTICK, then the buttons from BTN_MISC to BTN_JOYSTICK,
+ * - the axes in the order of their codes, each axis being scaled with its range and flat zone.
+ */
+static int js_read_map(int fd, const unsigned long* key_bits, const unsigned long* abs_bits, s_js_probe* probe)
+{
+  struct input_absinfo info;
+  int code;
+  int nb = 0;
+
+  for(code = BTN_JOYSTICK; code <= KEY_MAX; ++code)
+  {
+    if(test_bit(code, key_bits) && nb < 255)
+    {
+      probe->map.buttons[code - BTN_MISC] = ++nb;
+    }
+  }
+  for(code = BTN_MISC; code < BTN_JOYSTICK; ++code)
+  {
+    if(test_bit(code, key_bits) && nb < 255)
+    {
+      probe->map.buttons[code - BTN_MISC] = ++nb;
+    }
+  }
+  probe->map.button_nb = nb;
+
+  nb = 0;
+  for(code = 0; code < ABS_CNT; ++code)
+  {
+    s_js_axis* axis = probe->map.axes + code;
+
+    axis->index = -1;
+
+    if(!test_bit(code, abs_bits))
+    {
+      continue;
+    }
+    if(ioctl(fd, EVIOCGABS(code), &info) < 0)
+    {
+      fprintf(stderr, "ioctl EVIOCGABS failed: %s\n", strerror(errno));
+      return -1;
+    }
+    axis->index = nb++;
+    probe->values[code] = info.value;
+    if(info.maximum != info.minimum)
+    {
+      int32_t center = ((int64_t)info.maximum + info.minimum) / 2;
+      axis->flat_min = center - info.flat;
+      axis->flat_max = center + info.flat;
+      axis->half_range = (info.maximum - info.minimum) / 2 - 2 * info.flat;
+      if(axis->half_range <= 0)
+      {
+        // Everything is in the flat zone.
+        axis->flat_min = INT32_MIN;
+        axis->flat_max = INT32_MAX;
+        axis->half_range = 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Upload a "weak" and a "strong" rumble effect.
+ */
+static void js_read_ff(int fd, s_js_probe* probe)
+{
+  unsigned long features[NLONGS(FF_CNT)] = {};
+  struct ff_effect weak =
+  {
+    .type = FF_RUMBLE,
+    .id = -1
+  };
+  struct ff_effect strong =
+  {
+    .type = FF_RUMBLE,
+    .id = -1,
+  };
+
+  if (ioctl(fd, EVIOCGBIT(EV_FF, sizeof(features)), features) == -1)
+  {
+    perror("ioctl EV_FF");
+  }
+  else if (test_bit(FF_RUMBLE, features))
+  {
+    if (ioctl(fd, EVIOCSFF, &weak) == -1 || ioctl(fd, EVIOCSFF, &strong) == -1)
+    {
+      perror("ioctl EVIOCSFF");
+    }
+    else
+    {
+      // Store the ids so that the effects can be updated and played later.
+      probe->force_feedback.enabled = 1;
+      probe->force_feedback.weak_id = weak.id;
+      probe->force_feedback.strong_id = strong.id;
+    }
+  }
+}
+
+/*
+ * Make the kernel timestamp the events with the monotonic clock, which is the time base of GE_GetTime.
+ */
+static int set_monotonic_clock(int fd)
+{
+  int clk = CLOCK_MONOTONIC;
+
+  if(ioctl(fd, EVIOCSCLOCKID, &clk) < 0)
+  {
+    eprintf("ioctl EVIOCSCLOCKID failed: %s\n", strerror(errno));
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Open an event device and check if it is a joystick. If it supports rumble, the effects are uploaded.
+ * The joystick table is not modified, so that this can be called from any thread.
+ * Returns 0 in case of success, -1 otherwise (errno is EACCES if the device is a joystick that can't be opened
+ * because of permissions).
+ */
+int js_probe(const char* node, s_js_probe* probe)
+{
+  char device[sizeof("/dev/input/event255")];
+  unsigned long ev_bits[NLONGS(EV_CNT)] = {};
+  unsigned long key_bits[NLONGS(KEY_CNT)] = {};
+  unsigned long abs_bits[NLONGS(ABS_CNT)] = {};
+  unsigned long prop_bits[NLONGS(INPUT_PROP_CNT)] = {};
+  int js_sibling = has_js_sibling(node);
+  struct stat st;
+
+  memset(probe, 0x00, sizeof(*probe));
+
+  snprintf(device, sizeof(device), "%s/%s", DEV_INPUT, node);
+
+  // The device has to be writable for rumble.
+  probe->fd = open (device, O_RDWR | O_NONBLOCK);
+  if(probe->fd < 0)
+  {
+    probe->fd = open (device, O_RDONLY | O_NONBLOCK);
+  }
+  if(probe->fd < 0)
+  {
+    if(errno == EACCES && !js_sibling)
+    {
+      // Not known to be a joystick.
+      errno = ENODEV;
+    }
+    return -1;
+  }
+
+  if (ioctl(probe->fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) < 0
+      || ioctl(probe->fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) < 0
+      || ioctl(probe->fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits) < 0)
+  {
+    fprintf(stderr, "ioctl EVIOCGBIT failed: %s\n", strerror(errno));
+    close(probe->fd);
+    errno = ENODEV;
+    return -1;
+  }
+  // Old kernels don't report the properties.
+  ioctl(probe->fd, EVIOCGPROP(sizeof(prop_bits)), prop_bits);
+
+  if ((!js_sibling && !is_joystick(ev_bits, key_bits, abs_bits, prop_bits))
+      || ioctl(probe->fd, EVIOCGNAME(sizeof(probe->name) - 1), probe->name) < 0
+      || js_read_map(probe->fd, key_bits, abs_bits, probe) < 0
+      || fstat(probe->fd, &st) < 0)
+  {
+    close(probe->fd);
+    errno = ENODEV;
+    return -1;
+  }
+
+  probe->rdev = st.st_rdev;
+  probe->kernel_time = set_monotonic_clock(probe->fd);
+
+  if (test_bit(EV_FF, ev_bits))
+  {
+    js_read_ff(probe->fd, probe);
+  }
+
+  return 0;
+}
+
+/*
+ * Install a probed joystick at a given index.
+ */
+static void js_install(int index, s_js_probe* probe)
+{
+  int code;
+
+  joystick[index].name = strdup(probe->name);
+  joystick[index].fd = probe->fd;
+  joystick[index].rdev = probe->rdev;
+  joystick[index].kernel_time = probe->kernel_time;
+  joystick[index].map = probe->map;
+  memcpy(joystick[index].values, probe->values, sizeof(joystick[index].values));
+  for(code = 0; code < ABS_CNT; ++code)
+  {
+    joystick[index].corrected[code] = js_correct(probe->map.axes + code, probe->values[code]);
+  }
+  memset(joystick[index].hat_value, 0x00, sizeof(joystick[index].hat_value));
+  memset(joystick[index].keys, 0x00, sizeof(joystick[index].keys));
+  memset(&joystick[index].frame, 0x00, sizeof(joystick[index].frame));
+  if(probe->force_feedback.enabled)
+  {
+    joystick[index].force_feedback.fd = probe->fd;
+    joystick[index].force_feedback.weak_id = probe->force_feedback.weak_id;
+    joystick[index].force_feedback.strong_id = probe->force_feedback.strong_id;
+  }
+  ev_register_input_source(joystick[index].fd, index, &js_process_events, &js_disconnect);
+}
+
 int js_init()
 {
   int ret = 0;
-  int i, j;
-  int fd_js, fd_ev;
-  char js_file[sizeof("/dev/input/js255")];
-  char dir_event[sizeof("/sys/class/input/js255/device/")];
-  char event[sizeof("/sys/class/input/js255/device/event255")];
-  char name[1024] = {0};
+  int i;
+  static s_js_probe probe;
 
-  struct dirent **namelist_js;
-  int n_js;
+  struct dirent **namelist;
+  int n;
 
-  // scan /dev/input for jsX devices
-  n_js = scandir(DEV_INPUT, &namelist_js, is_js_device, alphasort);
-  if (n_js >= 0)
+  // scan /dev/input for eventX devices
+  n = scandir(DEV_INPUT, &namelist, is_ev_device, alphasort);
+  if (n >= 0)
   {
-    for(i=0; i<n_js && !ret; ++i)
+    for(i=0; i<n; ++i)
     {
-      snprintf(js_file, sizeof(js_file), "%s/%s", DEV_INPUT, namelist_js[i]->d_name);
-
-      // open the jsX device
-      fd_js = open (js_file, O_RDONLY | O_NONBLOCK);
-      if(fd_js != -1)
+      if(!ret && j_num < GE_MAX_DEVICES)
       {
-        // get the device name
-        if (ioctl(fd_js, JSIOCGNAME(sizeof(name) - 1), name) < 0) {
-          fprintf(stderr, "ioctl EVIOCGNAME failed: %s\n", strerror(errno));
-          close(fd_js);
-          continue;
-        }
-        // get the number of buttons and the axis map, to allow converting hat axes to buttons
-        unsigned char buttons;
-        if (ioctl (fd_js, JSIOCGBUTTONS, &buttons) >= 0 && ioctl (fd_js, JSIOCGAXMAP, &joystick[j_num].hat_info.ax_map) >= 0)
+        if(js_probe(namelist[i]->d_name, &probe) == 0)
         {
-          joystick[j_num].name = strdup(name);
-          joystick[j_num].fd = fd_js;
-          joystick[j_num].hat_info.button_nb = buttons;
-          ev_register_source(joystick[j_num].fd, j_num, &js_process_events, NULL, &js_close);
-
-          struct dirent **namelist_ev;
-          int n_ev;
-
-          snprintf(dir_event, sizeof(dir_event), "/sys/class/input/%s/device/", namelist_js[i]->d_name);
-          
-          // scan /sys/class/input/jsX/device/ for eventY devices
-          n_ev = scandir(dir_event, &namelist_ev, is_ev_device, alphasort);
-          if (n_ev >= 0)
-          {
-            for(j=0; j<n_ev && !ret; ++j)
-            {
-              snprintf(event, sizeof(event), "%s/%s", DEV_INPUT, namelist_ev[j]->d_name);
-
-              // open the eventY device
-              fd_ev = open (event, O_RDWR | O_NONBLOCK);
-              if(fd_ev != -1)
-              {
-                unsigned long features[4];
-                if (ioctl(fd_ev, EVIOCGBIT(EV_FF, sizeof(features)), features) == -1)
-                {
-                  perror("ioctl EV_FF");
-                  close(fd_ev);
-                  continue;
-                }
-                if (test_bit(FF_RUMBLE, features))
-                {
-                  // Upload a "weak" effect.
-                  struct ff_effect weak =
-                  {
-                    .type = FF_RUMBLE,
-                    .id = -1
-                  };
-                  if (ioctl(fd_ev, EVIOCSFF, &weak) == -1)
-                  {
-                    perror("ioctl EVIOCSFF");
-                    close(fd_ev);
-                    continue;
-                  }
-                  // Upload a "strong" effect.
-                  struct ff_effect strong =
-                  {
-                    .type = FF_RUMBLE,
-                    .id = -1,
-                  };
-                  if (ioctl(fd_ev, EVIOCSFF, &strong) == -1)
-                  {
-                    perror("ioctl EVIOCSFF");
-                    close(fd_ev);
-                    continue;
-                  }
-                  // Store the ids so that the effects can be updated and played later.
-                  joystick[j_num].force_feedback.fd = fd_ev;
-                  joystick[j_num].force_feedback.weak_id = weak.id;
-                  joystick[j_num].force_feedback.strong_id = strong.id;
-                }
-                else
-                {
-                  close(fd_ev);
-                }
-              }
-              free(namelist_ev[j]);
-            }
-            free(namelist_ev);
-          }
-
+          js_install(j_num, &probe);
           j_num++;
         }
-        else
+        else if(errno == EACCES)
         {
-          close(fd_js);
+          fprintf(stderr, "can't open %s/%s: %s\n", DEV_INPUT, namelist[i]->d_name, strerror(EACCES));
+          ret = -1;
         }
       }
-      else if(errno == EACCES)
-      {
-        fprintf(stderr, "can't open %s: %s\n", js_file, strerror(errno));
-        ret = -1;
-      }
 
-      free(namelist_js[i]);
+      free(namelist[i]);
     }
-    free(namelist_js);
+    free(namelist);
   }
   else
   {
@@ -322,6 +757,56 @@ int js_init()
   return ret;
 }
 
+/*
+ * Allocate the index of a joystick that is not opened yet (hotplug).
+ * Returns the index, or -1 if there is no room.
+ */
+int js_reserve()
+{
+  int index = -1;
+  if(j_num < GE_MAX_DEVICES)
+  {
+    index = j_num;
+    ++j_num;
+  }
+  return index;
+}
+
+/*
+ * Add a joystick that was connected after js_init (hotplug).
+ * The joystick index is allocated by ge_hotplug_add.
+ * Returns the joystick index, or -1 if the joystick is ignored, in which case it is closed.
+ */
+int js_add_device(s_js_probe* probe)
+{
+  int i;
+  int index = -1;
+
+  for(i=0; i<j_num; ++i)
+  {
+    if(joystick[i].fd >= 0 && joystick[i].rdev == probe->rdev)
+    {
+      // Already opened (the joystick is probed again after a permission change).
+      break;
+    }
+  }
+
+  if(i == j_num)
+  {
+    index = ge_hotplug_add(GE_DEVICE_JOYSTICK, probe->name);
+  }
+
+  if(index < 0)
+  {
+    close(probe->fd);
+    return -1;
+  }
+
+  js_install(index, probe);
+
+  return index;
+}
+
 int js_has_ff_rumble(int index)
 {
   if(index < j_num)
@@ -417,16 +902,35 @@ int js_close(int index)
       close(joystick[index].fd);
       joystick[index].fd = -1;
     }
-    if(joystick[index].force_feedback.fd >= 0)
-    {
-      close(joystick[index].force_feedback.fd);
-      joystick[index].force_feedback.fd = -1;
-    }
+    // The rumble effects are played through the event device, which is closed.
+    joystick[index].force_feedback.fd = -1;
   }
 
   return 0;
 }
 
+/*
+ * This is the cleanup callback of the joysticks, called when a joystick is disconnected.
+ * The joystick is removed by the main thread (see hotplug_remove).
+ */
+static int js_disconnect(int index)
+{
+  if(hotplug_remove(1, index) < 0)
+  {
+    js_remove_device(index);
+  }
+  return 0;
+}
+
+/*
+ * Remove a disconnected joystick. Its index is kept, for when it is connected again.
+ */
+void js_remove_device(int index)
+{
+  ge_hotplug_remove(GE_DEVICE_JOYSTICK, index);
+  js_close(index);
+}
+
 void js_quit()
 {
   int i;
@@ -7,10 +7,62 @@
 #define JS_H_
 
 #include <poll.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+/*
+ * The number of key codes that can be joystick buttons (BTN_MISC to KEY_MAX).
+ */
+#define JS_KEY_NB (KEY_MAX - BTN_MISC + 1)
+
+/*
+ * An absolute axis, and the correction that scales its values to [-32767, 32767]
+ * the same way the legacy joystick interface (joydev) does.
+ */
+typedef struct
+{
+  int16_t index; // the axis index, -1 if the device doesn't have this axis
+  int32_t flat_min; // the values in [flat_min, flat_max] are corrected to 0
+  int32_t flat_max;
+  int32_t half_range; // the range on each side of the flat zone, 0 if the axis is not corrected (min == max)
+} s_js_axis;
+
+/*
+ * The button and axis numbering of a joystick, which is the numbering of the legacy joystick interface,
+ * so that the configurations remain valid.
+ */
+typedef struct
+{
+  unsigned short button_nb; // the number of buttons, which is the base index of the buttons generated from the hats
+  uint8_t buttons[JS_KEY_NB]; // the button index + 1 of each key code starting from BTN_MISC, 0 if none
+  s_js_axis axes[ABS_CNT];
+} s_js_map;
+
+/*
+ * A joystick event device that was opened and identified (see js_probe).
+ */
+typedef struct
+{
+  int fd;
+  dev_t rdev;
+  int kernel_time;
+  char name[1024];
+  s_js_map map;
+  int32_t values[ABS_CNT]; // the initial axis values
+  struct
+  {
+    int enabled;
+    int weak_id;
+    int strong_id;
+  } force_feedback;
+} s_js_probe;
 
 int js_init();
-int js_get_nfds();
-int js_fill_fds(nfds_t max, struct pollfd fds[]);
+int js_probe(const char* node, s_js_probe* probe);
+int js_reserve();
+int js_add_device(s_js_probe* probe);
+void js_remove_device(int index);
 int js_close(int id);
 void js_quit();
 const char* js_get_name(int index);
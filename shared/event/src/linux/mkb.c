@@ -5,8 +5,9 @@
 
 #include <GE.h>
 #include <events.h>
-#include <queue.h>
+#include <filter.h>
 #include "mkb.h"
+#include "hotplug.h"
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
@@ -18,6 +19,8 @@
 #include <stdlib.h>
 #include <timer.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
 
 #define eprintf(...) if(debug) printf(__VA_ARGS__)
 
@@ -29,31 +32,76 @@ static int debug = 0;
 #define DEVTYPE_MOUSE    0x02
 #define DEVTYPE_NB       2
 
+#ifndef REL_WHEEL_HI_RES
+#define REL_WHEEL_HI_RES 0x0b
+#endif
+#ifndef REL_HWHEEL_HI_RES
+#define REL_HWHEEL_HI_RES 0x0c
+#endif
+
+/*
+ * High-resolution wheels report fractions of a notch: a notch is 120 units.
+ */
+#define WHEEL_HI_RES_NOTCH 120
+
+#define LONG_BITS (sizeof(long) * 8)
+#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
+
 static struct
 {
   unsigned char type;
   int fd;
+  dev_t rdev; //allows to ignore an already opened device when it is probed again
   int id[DEVTYPE_NB];
   char* name;
+  int kernel_time; //the events are timestamped by the kernel with the monotonic clock
+  unsigned char wheel_hi_res; //a bit per high-resolution wheel (vertical, horizontal)
+  int wheel[2]; //the accumulated fractions of a notch (vertical, horizontal)
+  /*
+   * The relative motion is accumulated until the end of the frame (SYN_REPORT),
+   * so that a single motion event is emitted per frame.
+   */
+  struct
+  {
+    int xrel;
+    int yrel;
+    int pending; //there is a motion to emit at the end of the frame
+    uint64_t timestamp; //the time of the first motion of the frame
+    int dropping; //the events are dropped until the end of the frame (SYN_DROPPED)
+  } frame;
+  unsigned long keys[NLONGS(KEY_CNT)]; //the key states, to resync after SYN_DROPPED
 } devices[GE_MAX_DEVICES];
 
+/*
+ * The statistics are read by the main thread while the devices may be read by the input thread.
+ */
+static struct
+{
+  unsigned long long frames;
+  unsigned long long motions; //the number of relative motion events read
+  unsigned long long motion_events; //the number of motion events emitted
+  unsigned long long resyncs;
+} stats;
+
+static inline void stats_inc(unsigned long long* counter)
+{
+  __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
 static int k_num;
 static int m_num;
 static int max_device_id;
 
 static int grab = 0;
 
-#define LONG_BITS (sizeof(long) * 8)
-#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
-
 static inline int BitIsSet(const unsigned long *array, int bit)
 {
     return !!(array[bit / LONG_BITS] & (1LL << (bit % LONG_BITS)));
 }
 
-static int mkb_read_type(int index, int fd)
+static int mkb_read_type(int fd, s_mkb_probe* probe)
 {
-  char name[1024]                             = {0};
+  char* name = probe->name;
   unsigned long key_bitmask[NLONGS(KEY_CNT)] = {0};
   unsigned long rel_bitmask[NLONGS(REL_CNT)] = {0};
   int i, len;
@@ -61,7 +109,7 @@ static int mkb_read_type(int index, int fd)
   int has_keys = 0;
   int has_scroll = 0;
 
-  if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0) {
+  if (ioctl(fd, EVIOCGNAME(sizeof(probe->name) - 1), name) < 0) {
     fprintf(stderr, "ioctl EVIOCGNAME failed: %s\n", strerror(errno));
     return -1;
   }
@@ -85,6 +133,13 @@ static int mkb_read_type(int index, int fd)
       }
   }
 
+  if (BitIsSet(rel_bitmask, REL_WHEEL_HI_RES)) {
+      probe->wheel_hi_res |= 0x01;
+  }
+  if (BitIsSet(rel_bitmask, REL_HWHEEL_HI_RES)) {
+      probe->wheel_hi_res |= 0x02;
+  }
+
   if (has_rel_axes) {
       if (BitIsSet(rel_bitmask, REL_WHEEL) ||
           BitIsSet(rel_bitmask, REL_HWHEEL) ||
@@ -107,19 +162,13 @@ static int mkb_read_type(int index, int fd)
 
   if(has_keys)
   {
-    devices[index].type = DEVTYPE_KEYBOARD;
-    devices[index].id[0] = k_num;
-    k_num++;
+    probe->type = DEVTYPE_KEYBOARD;
   }
   if(has_rel_axes || has_scroll)
   {
-    devices[index].type |= DEVTYPE_MOUSE;
-    devices[index].id[1] = m_num;
-    m_num++;
+    probe->type |= DEVTYPE_MOUSE;
   }
 
-  devices[index].name = strdup(name);
-
   return 0;
 }
 
@@ -130,39 +179,113 @@ void mkb_set_callback(int (*fp)(GE_Event*))
   event_callback = fp;
 }
 
-static void mkb_process_event(int device, struct input_event* ie)
+static inline void set_key_state(unsigned long* keys, int code, int value)
+{
+  if(value)
+  {
+    keys[code / LONG_BITS] |= 1UL << (code % LONG_BITS);
+  }
+  else
+  {
+    keys[code / LONG_BITS] &= ~(1UL << (code % LONG_BITS));
+  }
+}
+
+/*
+ * Get the wheel button for a wheel event.
+ * For a high-resolution wheel, the fractions of a notch are accumulated (the accumulator
+ * is reset when the direction changes), and the legacy events are ignored.
+ * Returns the button, or -1 if no notch was reached.
+ */
+static int mkb_wheel_button(int device, int code, int value)
+{
+  int hi_res = (code == REL_WHEEL_HI_RES || code == REL_HWHEEL_HI_RES);
+  int horizontal = (code == REL_HWHEEL || code == REL_HWHEEL_HI_RES);
+  int* wheel = devices[device].wheel + horizontal;
+
+  if(devices[device].wheel_hi_res & (1 << horizontal))
+  {
+    if(!hi_res)
+    {
+      return -1;
+    }
+    if((*wheel < 0 && value > 0) || (*wheel > 0 && value < 0))
+    {
+      *wheel = 0;
+    }
+    *wheel += value;
+    if(abs(*wheel) < WHEEL_HI_RES_NOTCH)
+    {
+      return -1;
+    }
+    value = *wheel;
+    *wheel %= WHEEL_HI_RES_NOTCH;
+  }
+  else if(hi_res)
+  {
+    return -1;
+  }
+
+  if(horizontal)
+  {
+    return (value > 0) ? GE_BTN_WHEELRIGHT : GE_BTN_WHEELLEFT;
+  }
+  return (value > 0) ? GE_BTN_WHEELUP : GE_BTN_WHEELDOWN;
+}
+
+/*
+ * Process an event (except synchronization events).
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int mkb_process_event(int device, struct input_event* ie, uint64_t timestamp)
 {
-  GE_Event evt = {};
+  GE_Event evt = { .timestamp = timestamp };
+  int mouse_button;
+
+  if(devices[device].frame.dropping)
+  {
+    return 0;
+  }
 
   switch(ie->type)
   {
     case EV_KEY:
       if(ie->value > 1)
       {
-        return;
+        return 0;
+      }
+      if(ie->code < KEY_CNT)
+      {
+        set_key_state(devices[device].keys, ie->code, ie->value);
       }
       break;
     case EV_MSC:
       if(ie->value > 1)
       {
-        return;
+        return 0;
       }
       if(ie->value == 2)
       {
-        return;
+        return 0;
       }
       break;
     case EV_REL:
     case EV_ABS:
       break;
     default:
-      return;
+      return 0;
   }
+  /*
+   * The mouse buttons of a device that is both a keyboard and a mouse are mouse buttons only,
+   * so that each event goes through the filter once.
+   */
+  mouse_button = (devices[device].type & DEVTYPE_MOUSE) && ie->type == EV_KEY
+      && ie->code >= BTN_LEFT && ie->code <= BTN_TASK;
   if((devices[device].type & DEVTYPE_KEYBOARD))
   {
-    if(ie->type == EV_KEY)
+    if(ie->type == EV_KEY && !mouse_button)
     {
-      if(ie->code > 0 && ie->code < MAX_KEYNAMES)
+      if(ie->code > 0 && ie->code < MAX_KEYNAMES && filter_pass(GE_KEYDOWN, devices[device].id[0], ie->code))
       {
         evt.type = ie->value ? GE_KEYDOWN : GE_KEYUP;
         evt.key.which = devices[device].id[0];
@@ -174,7 +297,7 @@ static void mkb_process_event(int device, struct input_event* ie)
   {
     if(ie->type == EV_KEY)
     {
-      if(ie->code >= BTN_LEFT && ie->code <= BTN_TASK)
+      if(mouse_button && filter_pass(GE_MOUSEBUTTONDOWN, devices[device].id[1], ie->code - BTN_MOUSE))
       {
         evt.type = ie->value ? GE_MOUSEBUTTONDOWN : GE_MOUSEBUTTONUP;
         evt.button.which = devices[device].id[1];
@@ -183,29 +306,35 @@ static void mkb_process_event(int device, struct input_event* ie)
     }
     else if(ie->type == EV_REL)
     {
-      if(ie->code == REL_X)
-      {
-        evt.type = GE_MOUSEMOTION;
-        evt.motion.which = devices[device].id[1];
-        evt.motion.xrel = ie->value;
-      }
-      else if(ie->code == REL_Y)
-      {
-        evt.type = GE_MOUSEMOTION;
-        evt.motion.which = devices[device].id[1];
-        evt.motion.yrel = ie->value;
-      }
-      else if(ie->code == REL_WHEEL)
+      if(ie->code == REL_X || ie->code == REL_Y)
       {
-        evt.type = GE_MOUSEBUTTONDOWN;
-        evt.button.which = devices[device].id[1];
-        evt.button.button = (ie->value > 0) ? GE_BTN_WHEELUP : GE_BTN_WHEELDOWN;
+        // The motion is emitted at the end of the frame.
+        if(!devices[device].frame.pending)
+        {
+          devices[device].frame.pending = 1;
+          devices[device].frame.timestamp = timestamp;
+        }
+        if(ie->code == REL_X)
+        {
+          devices[device].frame.xrel += ie->value;
+        }
+        else
+        {
+          devices[device].frame.yrel += ie->value;
+        }
+        stats_inc(&stats.motions);
+        return 0;
       }
-      else if(ie->code == REL_HWHEEL)
+      else if(ie->code == REL_WHEEL || ie->code == REL_HWHEEL
+          || ie->code == REL_WHEEL_HI_RES || ie->code == REL_HWHEEL_HI_RES)
       {
-        evt.type = GE_MOUSEBUTTONDOWN;
-        evt.button.which = devices[device].id[1];
-        evt.button.button = (ie->value > 0) ? GE_BTN_WHEELRIGHT : GE_BTN_WHEELLEFT;
+        int button = mkb_wheel_button(device, ie->code, ie->value);
+        if(button >= 0 && filter_pass(GE_MOUSEBUTTONDOWN, devices[device].id[1], button))
+        {
+          evt.type = GE_MOUSEBUTTONDOWN;
+          evt.button.which = devices[device].id[1];
+          evt.button.button = button;
+        }
       }
     }
   }
@@ -220,17 +349,147 @@ static void mkb_process_event(int device, struct input_event* ie)
     event_callback(&evt);
     if(evt.type == GE_MOUSEBUTTONDOWN)
     {
-      if(ie->code == REL_WHEEL || ie->code == REL_HWHEEL)
+      if(ie->type == EV_REL)
       {
         evt.type = GE_MOUSEBUTTONUP;
-        queue_push_event(&evt);
+        ev_push_deferred_event(&evt);
       }
     }
+    return 1;
+  }
+  return 0;
+}
+
+static inline int clamp_motion(int value)
+{
+  return value > INT16_MAX ? INT16_MAX : (value < -INT16_MAX ? -INT16_MAX : value);
+}
+
+/*
+ * Emit the motion of the frame, if any.
+ * The motion of a very high resolution mouse may not fit in a single event,
+ * in which case several events are emitted, so that no motion is lost.
+ */
+static int mkb_flush_motion(int device)
+{
+  if(!devices[device].frame.pending)
+  {
+    return 0;
+  }
+
+  GE_Event evt =
+  {
+    .motion =
+    {
+      .type = GE_MOUSEMOTION,
+      .which = devices[device].id[1],
+    },
+    .timestamp = devices[device].frame.timestamp,
+  };
+
+  do
+  {
+    evt.motion.xrel = clamp_motion(devices[device].frame.xrel);
+    evt.motion.yrel = clamp_motion(devices[device].frame.yrel);
+
+    devices[device].frame.xrel -= evt.motion.xrel;
+    devices[device].frame.yrel -= evt.motion.yrel;
+
+    stats_inc(&stats.motion_events);
+
+    eprintf("motion from device: %s\n", devices[device].name);
+    eprintf("xrel: %d yrel: %d\n", evt.motion.xrel, evt.motion.yrel);
+    event_callback(&evt);
+  } while(devices[device].frame.xrel || devices[device].frame.yrel);
+
+  devices[device].frame.pending = 0;
+
+  return 1;
+}
+
+/*
+ * After a SYN_DROPPED, the key events that were dropped are replaced
+ * by the differences between the stored key states and the actual ones.
+ */
+static int mkb_resync(int device, uint64_t timestamp)
+{
+  unsigned long keys[NLONGS(KEY_CNT)] = {};
+  struct input_event ie = { .type = EV_KEY };
+  int emitted = 0;
+  int code;
+
+  if(ioctl(devices[device].fd, EVIOCGKEY(sizeof(keys)), keys) < 0)
+  {
+    eprintf("ioctl EVIOCGKEY failed: %s\n", strerror(errno));
+    return 0;
+  }
+
+  for(code = 0; code < KEY_CNT; ++code)
+  {
+    ie.value = BitIsSet(keys, code);
+    if(ie.value != BitIsSet(devices[device].keys, code))
+    {
+      ie.code = code;
+      emitted |= mkb_process_event(device, &ie, timestamp);
+    }
+  }
+
+  return emitted;
+}
+
+/*
+ * Process a synchronization event.
+ * Returns 1 if an event was emitted, 0 otherwise.
+ */
+static int mkb_process_syn(int device, struct input_event* ie, uint64_t timestamp)
+{
+  switch(ie->code)
+  {
+    case SYN_REPORT:
+      stats_inc(&stats.frames);
+      if(devices[device].frame.dropping)
+      {
+        devices[device].frame.dropping = 0;
+        return mkb_resync(device, timestamp);
+      }
+      return mkb_flush_motion(device);
+    case SYN_DROPPED:
+      // The kernel buffer overflowed: drop the events up to the next SYN_REPORT.
+      stats_inc(&stats.resyncs);
+      devices[device].frame.xrel = 0;
+      devices[device].frame.yrel = 0;
+      devices[device].frame.pending = 0;
+      devices[device].frame.dropping = 1;
+      break;
+    default:
+      break;
   }
+  return 0;
+}
+
+int mkb_get_stats(GE_EvdevStats* evdev_stats)
+{
+  evdev_stats->frames = __atomic_load_n(&stats.frames, __ATOMIC_RELAXED);
+  evdev_stats->merged = __atomic_load_n(&stats.motions, __ATOMIC_RELAXED) - __atomic_load_n(&stats.motion_events, __ATOMIC_RELAXED);
+  evdev_stats->resyncs = __atomic_load_n(&stats.resyncs, __ATOMIC_RELAXED);
+  return 0;
 }
 
 static struct input_event ie[MAX_EVENTS];
 
+/*
+ * Get the kernel timestamp of an event, in nanoseconds.
+ * It can't be later than the time the event was read.
+ */
+static inline uint64_t event_time(struct input_event* event, uint64_t now)
+{
+  uint64_t time = (uint64_t)event->input_event_sec * 1000000000 + (uint64_t)event->input_event_usec * 1000;
+
+  return time < now ? time : now;
+}
+
+static int mkb_disconnect(int index);
+
 static int mkb_process_events(int device)
 {
   unsigned int size = sizeof(ie);
@@ -247,24 +506,53 @@ static int mkb_process_events(int device)
 
   if((r = read(devices[device].fd, ie, size)) > 0)
   {
+    uint64_t now = timer_now();
+
     for(j=0; j<r/sizeof(*ie); ++j)
     {
-      mkb_process_event(device, ie+j);
+      uint64_t timestamp = devices[device].kernel_time ? event_time(ie+j, now) : now;
+      int emitted;
 
-      if(event_callback == GE_PushEvent)
+      if(ie[j].type == EV_SYN)
       {
-        return 1;
+        emitted = mkb_process_syn(device, ie+j, timestamp);
+      }
+      else
+      {
+        emitted = mkb_process_event(device, ie+j, timestamp);
       }
-    }
 
-    if(r < 0 && errno != EAGAIN)
-    {
-      mkb_close_device(device);
+      if(emitted && event_callback == GE_PushEvent)
+      {
+        return 1;
+      }
     }
   }
+  else if(r < 0 && errno != EAGAIN)
+  {
+    fprintf(stderr, "%s: read failed on %s: %s\n", __func__, devices[device].name, strerror(errno));
+    ev_remove_source(devices[device].fd);
+    mkb_disconnect(device);
+  }
   return 0;
 }
 
+/*
+ * Make the kernel timestamp the events with the monotonic clock, which is the time base of GE_GetTime.
+ * The default clock (realtime) can't be used, as it can jump.
+ */
+static int set_monotonic_clock(int fd)
+{
+  int clk = CLOCK_MONOTONIC;
+
+  if(ioctl(fd, EVIOCSCLOCKID, &clk) < 0)
+  {
+    eprintf("ioctl EVIOCSCLOCKID failed: %s\n", strerror(errno));
+    return 0;
+  }
+  return 1;
+}
+
 #define DEV_INPUT "/dev/input"
 #define EVENT_DEV_NAME "event"
 
@@ -272,12 +560,69 @@ static int is_event_device(const struct dirent *dir) {
   return strncmp(EVENT_DEV_NAME, dir->d_name, sizeof(EVENT_DEV_NAME)-1) == 0;
 }
 
+/*
+ * Open an event device and check if it is a mouse and/or a keyboard.
+ * The device table is not modified, so that this can be called from any thread.
+ * Returns 0 in case of success, -1 otherwise (errno is EACCES if the device can't be opened because of permissions).
+ */
+int mkb_probe(const char* node, s_mkb_probe* probe)
+{
+  char device[sizeof("/dev/input/event255")];
+  struct stat st;
+
+  memset(probe, 0x00, sizeof(*probe));
+
+  snprintf(device, sizeof(device), "%s/%s", DEV_INPUT, node);
+
+  probe->fd = open (device, O_RDONLY | O_NONBLOCK);
+  if(probe->fd < 0)
+  {
+    return -1;
+  }
+
+  if(mkb_read_type(probe->fd, probe) < 0 || fstat(probe->fd, &st) < 0)
+  {
+    close(probe->fd);
+    probe->fd = -1;
+    errno = ENODEV;
+    return -1;
+  }
+
+  probe->rdev = st.st_rdev;
+  probe->kernel_time = set_monotonic_clock(probe->fd);
+
+  return 0;
+}
+
+/*
+ * Install a probed device into a slot of the device table, once its ids are set.
+ */
+static void mkb_install_device(int index, s_mkb_probe* probe)
+{
+  devices[index].fd = probe->fd;
+  devices[index].rdev = probe->rdev;
+  devices[index].name = strdup(probe->name);
+  devices[index].kernel_time = probe->kernel_time;
+  devices[index].wheel_hi_res = probe->wheel_hi_res;
+  devices[index].wheel[0] = 0;
+  devices[index].wheel[1] = 0;
+  if(grab)
+  {
+    ioctl(devices[index].fd, EVIOCGRAB, (void *)1);
+  }
+  if(index > max_device_id)
+  {
+    max_device_id = index;
+  }
+  // The slot is in use once the type is set.
+  __atomic_store_n(&devices[index].type, probe->type, __ATOMIC_RELEASE);
+  ev_register_input_source(devices[index].fd, index, &mkb_process_events, &mkb_disconnect);
+}
+
 int mkb_init()
 {
   int ret = 0;
   int i, j;
-  int fd;
-  char device[sizeof("/dev/input/event255")];
 
   /*
    * Avoid the enter key from being still pressed after the process exit.
@@ -313,35 +658,28 @@ int mkb_init()
 
   struct dirent **namelist;
   int n;
+  s_mkb_probe probe;
 
   n = scandir(DEV_INPUT, &namelist, is_event_device, alphasort);
   if (n >= 0)
   {
     for(i=0; i<n && !ret; ++i)
     {
-      snprintf(device, sizeof(device), "%s/%s", DEV_INPUT, namelist[i]->d_name);
-
-      fd = open (device, O_RDONLY | O_NONBLOCK);
-      if(fd != -1)
+      if(mkb_probe(namelist[i]->d_name, &probe) == 0)
       {
-        if(mkb_read_type(i, fd) != -1)
+        if(probe.type & DEVTYPE_KEYBOARD)
         {
-          devices[i].fd = fd;
-          if(grab)
-          {
-            ioctl(devices[i].fd, EVIOCGRAB, (void *)1);
-          }
-          max_device_id = i;
-          ev_register_source(devices[i].fd, i, &mkb_process_events, NULL, &mkb_close_device);
+          devices[i].id[0] = k_num++;
         }
-        else
+        if(probe.type & DEVTYPE_MOUSE)
         {
-          close(fd);
+          devices[i].id[1] = m_num++;
         }
+        mkb_install_device(i, &probe);
       }
       else if(errno == EACCES)
       {
-        fprintf(stderr, "can't open %s: %s\n", device, strerror(errno));
+        fprintf(stderr, "can't open %s/%s: %s\n", DEV_INPUT, namelist[i]->d_name, strerror(errno));
         ret = -1;
       }
 
@@ -407,6 +745,120 @@ int mkb_close_device(int id)
   return 0;
 }
 
+/*
+ * Add a device that was connected after mkb_init (hotplug).
+ * The device ids are allocated by ge_hotplug_add.
+ * Returns the device index, or -1 if the device is ignored, in which case it is closed.
+ */
+int mkb_add_device(s_mkb_probe* probe)
+{
+  int i;
+  int index = -1;
+
+  for(i=0; i<GE_MAX_DEVICES; ++i)
+  {
+    if(devices[i].fd >= 0 && devices[i].rdev == probe->rdev)
+    {
+      // Already opened (the device is probed again after a permission change).
+      close(probe->fd);
+      return -1;
+    }
+  }
+
+  for(i=0; i<GE_MAX_DEVICES && index < 0; ++i)
+  {
+    if(devices[i].fd < 0 && !__atomic_load_n(&devices[i].type, __ATOMIC_ACQUIRE))
+    {
+      index = i;
+    }
+  }
+
+  if(index < 0)
+  {
+    close(probe->fd);
+    return -1;
+  }
+
+  if(probe->type & DEVTYPE_KEYBOARD)
+  {
+    if((devices[index].id[0] = ge_hotplug_add(GE_DEVICE_KEYBOARD, probe->name)) < 0)
+    {
+      probe->type &= ~DEVTYPE_KEYBOARD;
+    }
+  }
+  if(probe->type & DEVTYPE_MOUSE)
+  {
+    if((devices[index].id[1] = ge_hotplug_add(GE_DEVICE_MOUSE, probe->name)) < 0)
+    {
+      probe->type &= ~DEVTYPE_MOUSE;
+    }
+  }
+
+  if(!probe->type)
+  {
+    close(probe->fd);
+    return -1;
+  }
+
+  mkb_install_device(index, probe);
+
+  return index;
+}
+
+/*
+ * This is the cleanup callback of the devices, called when a device is disconnected.
+ * The keys and buttons that are still pressed are released, by the thread that reads the device,
+ * and the device is removed by the main thread (see hotplug_remove).
+ */
+static int mkb_disconnect(int index)
+{
+  struct input_event ie = { .type = EV_KEY, .value = 0 };
+  uint64_t now = timer_now();
+
+  devices[index].frame.dropping = 0;
+  for(ie.code = 0; ie.code < KEY_CNT; ++ie.code)
+  {
+    if(BitIsSet(devices[index].keys, ie.code))
+    {
+      mkb_process_event(index, &ie, now);
+    }
+  }
+
+  if(hotplug_remove(0, index) < 0)
+  {
+    mkb_remove_device(index);
+  }
+
+  return 0;
+}
+
+/*
+ * Remove a disconnected device, and free its slot.
+ */
+void mkb_remove_device(int index)
+{
+  int j;
+
+  if(devices[index].type & DEVTYPE_KEYBOARD)
+  {
+    ge_hotplug_remove(GE_DEVICE_KEYBOARD, devices[index].id[0]);
+  }
+  if(devices[index].type & DEVTYPE_MOUSE)
+  {
+    ge_hotplug_remove(GE_DEVICE_MOUSE, devices[index].id[1]);
+  }
+
+  mkb_close_device(index);
+
+  memset(&devices[index].frame, 0x00, sizeof(devices[index].frame));
+  memset(devices[index].keys, 0x00, sizeof(devices[index].keys));
+  for(j=0; j<DEVTYPE_NB; ++j)
+  {
+    devices[index].id[j] = -1;
+  }
+  __atomic_store_n(&devices[index].type, 0, __ATOMIC_RELEASE);
+}
+
 void mkb_quit()
 {
   int i;
@@ -438,6 +890,8 @@ void mkb_grab(int mode)
   {
     enable = &one;
   }
+  // The devices added later (hotplug) are grabbed as well.
+  grab = (mode == GE_GRAB_ON);
   for(i=0; i<GE_MAX_DEVICES; ++i)
   {
     if(devices[i].fd > -1)
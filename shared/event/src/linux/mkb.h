@@ -7,8 +7,25 @@
 #define MKB_H_
 
 #include <poll.h>
+#include <sys/types.h>
+
+/*
+ * An event device that was opened and identified as a mouse and/or a keyboard (see mkb_probe).
+ */
+typedef struct
+{
+  int fd;
+  dev_t rdev;
+  unsigned char type;
+  int kernel_time;
+  unsigned char wheel_hi_res; //a bit per high-resolution wheel (vertical, horizontal)
+  char name[1024];
+} s_mkb_probe;
 
 int mkb_init();
+int mkb_probe(const char* node, s_mkb_probe* probe);
+int mkb_add_device(s_mkb_probe* probe);
+void mkb_remove_device(int index);
 int mkb_close_device(int id);
 void mkb_quit();
 void mkb_grab(int mode);
@@ -17,5 +34,6 @@ int mkb_fill_fds(nfds_t max, struct pollfd fds[]);
 char* mkb_get_k_name(int index);
 char* mkb_get_m_name(int index);
 void mkb_set_callback(int (*fp)(GE_Event*));
+int mkb_get_stats(GE_EvdevStats* stats);
 
 #endif /* MKB_H_ */
@@ -4,41 +4,74 @@
  */
 
 #include <sys/timerfd.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <GE.h>
 
 static int tfd = -1;
 
+static struct
+{
+  uint64_t next; // the next deadline (ns)
+  uint64_t period; // ns
+  uint64_t offset; // the timer expires this long before each deadline (ns)
+  uint64_t pending; // the missed expirations that were read when the timer was re-armed
+  GE_TimerStats stats;
+} timer = {};
+
+/*
+ * Get the current time of the monotonic clock, in nanoseconds.
+ */
+uint64_t timer_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 inline int timer_get()
 {
   return tfd;
 }
 
+static inline struct timespec to_timespec(uint64_t ns)
+{
+  struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+  return ts;
+}
+
+/*
+ * Start a periodic timer based on the monotonic clock.
+ * Deadlines are absolute, so that they are aligned on a fixed grid
+ * that is not affected by the time needed to process each period.
+ */
 int timer_start(int usec)
 {
-  __time_t sec = usec / 1000000;
-  __time_t nsec = (usec - sec * 1000000) * 1000;
+  if(tfd != -1)
+  {
+    return tfd;
+  }
 
-  struct timespec period = {.tv_sec = sec, .tv_nsec = nsec};
+  memset(&timer, 0x00, sizeof(timer));
+  timer.period = (uint64_t)usec * 1000;
+  timer.next = timer_now() + timer.period;
 
   struct itimerspec new_value =
   {
-      .it_interval = period,
-      .it_value = period,
+      .it_interval = to_timespec(timer.period),
+      .it_value = to_timespec(timer.next),
   };
-  
-  if(tfd != -1)
-  {
-    return tfd;
-  }
 
-  tfd = timerfd_create(CLOCK_REALTIME, 0);
+  tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
   if(tfd < 0)
   {
     fprintf(stderr, "timerfd_create");
   }
-  else if(timerfd_settime(tfd, 0, &new_value, NULL))
+  else if(timerfd_settime(tfd, TFD_TIMER_ABSTIME, &new_value, NULL))
   {
     fprintf(stderr, "timerfd_settime");
     close(tfd);
@@ -58,6 +91,53 @@ int timer_close(int unused)
   return 1;
 }
 
+/*
+ * Move the expirations of the timer before the deadlines, without changing the deadlines.
+ * Re-arming the timer discards the expirations that were not read yet, so they are read first:
+ * the timer is re-armed on the last one, which makes it expire immediately,
+ * and the other ones are accounted as missed by the next timer_read call.
+ * The timer also expires immediately if the new expiration has already passed.
+ */
+int timer_set_offset(int usec)
+{
+  if(tfd < 0 || usec < 0 || (uint64_t)usec * 1000 >= timer.period)
+  {
+    return -1;
+  }
+
+  uint64_t exp;
+  if(read(tfd, &exp, sizeof(exp)) == sizeof(exp))
+  {
+    timer.pending += exp - 1;
+    timer.next += (exp - 1) * timer.period;
+  }
+
+  uint64_t offset = (uint64_t)usec * 1000;
+  uint64_t expiration = timer.next - offset;
+
+  struct itimerspec new_value =
+  {
+      .it_interval = to_timespec(timer.period),
+      .it_value = to_timespec(expiration),
+  };
+
+  if(timerfd_settime(tfd, TFD_TIMER_ABSTIME, &new_value, NULL))
+  {
+    fprintf(stderr, "timerfd_settime");
+    return -1;
+  }
+
+  timer.offset = offset;
+
+  return 0;
+}
+
+/*
+ * Read the number of expirations and update the statistics.
+ * A tick is missed if the timer expired more than once since the last read,
+ * including the expirations that were read when the timer was re-armed.
+ * A tick is late if it is serviced more than half a period after its expiration.
+ */
 int timer_read(int unused)
 {
   uint64_t exp;
@@ -66,16 +146,47 @@ int timer_read(int unused)
 
   res = read (tfd, &exp, sizeof(exp));
 
+  if (res < 0 && errno == EAGAIN) {
+    // A poll notification for an expiration that was already read.
+    return 0;
+  }
   if (res != sizeof(exp)) {
     fprintf (stderr, "Wrong timer fd read...\n");
   }
   else
   {
-    if(exp > 1)
+    uint64_t expiration = timer.next + (exp - 1) * timer.period - timer.offset;
+    uint64_t now = timer_now();
+    uint64_t lateness = now > expiration ? now - expiration : 0;
+
+    timer.next += exp * timer.period;
+
+    exp += timer.pending;
+    timer.pending = 0;
+
+    timer.stats.ticks++;
+    timer.stats.missed += exp - 1;
+    timer.stats.last_missed = exp - 1;
+    timer.stats.last_lateness = lateness / 1000;
+    if(lateness > timer.period / 2)
+    {
+      timer.stats.late++;
+    }
+    if(timer.stats.last_lateness > timer.stats.max_lateness)
     {
-      fprintf (stderr, "Timer fired several times...\n");
+      timer.stats.max_lateness = timer.stats.last_lateness;
     }
     return 1;
   }
   return 0;
 }
+
+int timer_get_stats(GE_TimerStats* stats)
+{
+  if(tfd < 0)
+  {
+    return -1;
+  }
+  *stats = timer.stats;
+  return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params* p)
+{
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/*
+ * Create a ring and map its queues.
+ * Returns -1 if io_uring is not available (old kernel, or disabled).
+ */
+int uring_init(s_uring* ring, unsigned int entries)
+{
+  struct io_uring_params p;
+
+  memset(ring, 0x00, sizeof(*ring));
+  memset(&p, 0x00, sizeof(p));
+
+  ring->fd = io_uring_setup(entries, &p);
+  if(ring->fd < 0)
+  {
+    return -1;
+  }
+
+  ring->sq.size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  ring->cq.size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if(ring->cq.size > ring->sq.size)
+    {
+      ring->sq.size = ring->cq.size;
+    }
+    ring->cq.size = ring->sq.size;
+  }
+
+  ring->sq.ptr = mmap(NULL, ring->sq.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if(ring->sq.ptr == MAP_FAILED)
+  {
+    perror("mmap");
+    close(ring->fd);
+    return -1;
+  }
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    ring->cq.ptr = ring->sq.ptr;
+  }
+  else
+  {
+    ring->cq.ptr = mmap(NULL, ring->cq.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if(ring->cq.ptr == MAP_FAILED)
+    {
+      perror("mmap");
+      munmap(ring->sq.ptr, ring->sq.size);
+      close(ring->fd);
+      return -1;
+    }
+  }
+
+  ring->sq.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq.sqes = mmap(NULL, ring->sq.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if(ring->sq.sqes == MAP_FAILED)
+  {
+    perror("mmap");
+    if(ring->cq.ptr != ring->sq.ptr)
+    {
+      munmap(ring->cq.ptr, ring->cq.size);
+    }
+    munmap(ring->sq.ptr, ring->sq.size);
+    close(ring->fd);
+    return -1;
+  }
+
+  ring->sq.head = ring->sq.ptr + p.sq_off.head;
+  ring->sq.tail = ring->sq.ptr + p.sq_off.tail;
+  ring->sq.mask = ring->sq.ptr + p.sq_off.ring_mask;
+  ring->sq.array = ring->sq.ptr + p.sq_off.array;
+
+  ring->cq.head = ring->cq.ptr + p.cq_off.head;
+  ring->cq.tail = ring->cq.ptr + p.cq_off.tail;
+  ring->cq.mask = ring->cq.ptr + p.cq_off.ring_mask;
+  ring->cq.cqes = ring->cq.ptr + p.cq_off.cqes;
+
+  return 0;
+}
+
+void uring_close(s_uring* ring)
+{
+  if(ring->fd < 0)
+  {
+    return;
+  }
+  munmap(ring->sq.sqes, ring->sq.sqes_size);
+  if(ring->cq.ptr != ring->sq.ptr)
+  {
+    munmap(ring->cq.ptr, ring->cq.size);
+  }
+  munmap(ring->sq.ptr, ring->sq.size);
+  close(ring->fd);
+  ring->fd = -1;
+}
+
+/*
+ * Get a cleared submission entry. The entry is submitted by the next uring_enter call.
+ * If the submission queue is full, the pending entries are submitted first.
+ */
+struct io_uring_sqe* uring_get_sqe(s_uring* ring)
+{
+  unsigned int head = __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE);
+  unsigned int tail = *ring->sq.tail;
+
+  if(tail - head > *ring->sq.mask)
+  {
+    if(uring_enter(ring, 0) < 0)
+    {
+      return NULL;
+    }
+    head = __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE);
+    if(tail - head > *ring->sq.mask)
+    {
+      return NULL;
+    }
+  }
+
+  unsigned int index = tail & *ring->sq.mask;
+  struct io_uring_sqe* sqe = ring->sq.sqes + index;
+
+  memset(sqe, 0x00, sizeof(*sqe));
+  ring->sq.array[index] = index;
+
+  __atomic_store_n(ring->sq.tail, tail + 1, __ATOMIC_RELEASE);
+  ++ring->sq.pending;
+
+  return sqe;
+}
+
+/*
+ * Submit the pending entries, and wait for min_complete completions.
+ * Both are done with a single system call.
+ * With min_complete == 0, this only posts the completions that are ready.
+ */
+int uring_enter(s_uring* ring, unsigned int min_complete)
+{
+  int ret;
+
+  ret = io_uring_enter(ring->fd, ring->sq.pending, min_complete, IORING_ENTER_GETEVENTS);
+  if(ret < 0)
+  {
+    return -1;
+  }
+
+  ring->sq.pending -= ret;
+
+  return 0;
+}
+
+/*
+ * Get the next completion entry, or NULL if there is none.
+ */
+struct io_uring_cqe* uring_peek_cqe(s_uring* ring)
+{
+  unsigned int head = *ring->cq.head;
+
+  if(head == __atomic_load_n(ring->cq.tail, __ATOMIC_ACQUIRE))
+  {
+    return NULL;
+  }
+
+  return ring->cq.cqes + (head & *ring->cq.mask);
+}
+
+void uring_cqe_seen(s_uring* ring)
+{
+  __atomic_store_n(ring->cq.head, *ring->cq.head + 1, __ATOMIC_RELEASE);
+}
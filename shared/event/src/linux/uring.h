@@ -0,0 +1,48 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef URING_H_
+#define URING_H_
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/*
+ * A minimal io_uring wrapper, based on the raw system calls.
+ */
+typedef struct
+{
+  int fd;
+  struct
+  {
+    unsigned int* head;
+    unsigned int* tail;
+    unsigned int* mask;
+    unsigned int* array;
+    struct io_uring_sqe* sqes;
+    unsigned int pending; //prepared but not submitted yet
+    void* ptr;
+    size_t size;
+    size_t sqes_size;
+  } sq;
+  struct
+  {
+    unsigned int* head;
+    unsigned int* tail;
+    unsigned int* mask;
+    struct io_uring_cqe* cqes;
+    void* ptr;
+    size_t size;
+  } cq;
+} s_uring;
+
+int uring_init(s_uring* ring, unsigned int entries);
+void uring_close(s_uring* ring);
+struct io_uring_sqe* uring_get_sqe(s_uring* ring);
+int uring_enter(s_uring* ring, unsigned int min_complete);
+struct io_uring_cqe* uring_peek_cqe(s_uring* ring);
+void uring_cqe_seen(s_uring* ring);
+
+#endif /* URING_H_ */
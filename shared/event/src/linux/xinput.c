@@ -5,6 +5,7 @@
 
 #include <GE.h>
 #include <events.h>
+#include <filter.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,6 +13,7 @@
 #include <unistd.h>
 #include <poll.h>
 #include "xinput.h"
+#include <timer.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/XInput2.h>
 
@@ -36,6 +38,21 @@ static int device_index[GE_MAX_DEVICES];
 
 static int (*event_callback)(GE_Event*) = NULL;
 
+/*
+ * The raw motions of a mouse are accumulated while the queued events are processed,
+ * and a single motion event is emitted per mouse once they have all been processed,
+ * or before a button event of the same mouse.
+ */
+static struct
+{
+  int pending;
+  int xrel;
+  int yrel;
+} motions[GE_MAX_DEVICES]; //indexed by the device index
+
+static unsigned char pending_motions[GE_MAX_DEVICES]; //the devices that have an accumulated motion
+static unsigned int nb_pending_motions;
+
 static struct
 {
   int x;
@@ -74,9 +91,59 @@ inline uint8_t get_button(int detail)
   }
 }
 
-static void xinput_process_event(XIRawEvent* revent)
+static inline int clamp_motion(int value)
+{
+  return value > INT16_MAX ? INT16_MAX : (value < -INT16_MAX ? -INT16_MAX : value);
+}
+
+/*
+ * Emit the accumulated motion of a device.
+ * A motion that doesn't fit in a single event is split into several events.
+ */
+static void xinput_emit_motion(int index, uint64_t timestamp)
+{
+  GE_Event evt = { .type = GE_MOUSEMOTION, .timestamp = timestamp };
+
+  evt.motion.which = devices[index].id;
+
+  motions[index].pending = 0;
+
+  do
+  {
+    evt.motion.xrel = clamp_motion(motions[index].xrel);
+    evt.motion.yrel = clamp_motion(motions[index].yrel);
+    motions[index].xrel -= evt.motion.xrel;
+    motions[index].yrel -= evt.motion.yrel;
+    event_callback(&evt);
+  } while(motions[index].xrel || motions[index].yrel);
+}
+
+static void xinput_flush_motion(int index, uint64_t timestamp)
+{
+  unsigned int i;
+
+  for(i = 0; i < nb_pending_motions; ++i)
+  {
+    if(pending_motions[i] == index)
+    {
+      pending_motions[i] = pending_motions[--nb_pending_motions];
+      xinput_emit_motion(index, timestamp);
+      break;
+    }
+  }
+}
+
+static void xinput_flush_motions(uint64_t timestamp)
+{
+  while(nb_pending_motions)
+  {
+    xinput_emit_motion(pending_motions[--nb_pending_motions], timestamp);
+  }
+}
+
+static void xinput_process_event(XIRawEvent* revent, uint64_t timestamp)
 {
-  GE_Event evt = {};
+  GE_Event evt = { .timestamp = timestamp };
   int i;
 
   //ignore events from master device
@@ -92,15 +159,20 @@ static void xinput_process_event(XIRawEvent* revent)
     case XI_RawMotion:
       if(index >= 0)
       {
-        evt.type = GE_MOUSEMOTION;
-        evt.motion.which = devices[index].id;
         i = 0;
-        evt.motion.xrel = XIMaskIsSet(revent->valuators.mask, 0) ? revent->raw_values[i++] : 0;
-        evt.motion.yrel = XIMaskIsSet(revent->valuators.mask, 1) ? revent->raw_values[i++] : 0;
+        int xrel = XIMaskIsSet(revent->valuators.mask, 0) ? revent->raw_values[i++] : 0;
+        int yrel = XIMaskIsSet(revent->valuators.mask, 1) ? revent->raw_values[i++] : 0;
+        if(!motions[index].pending)
+        {
+          motions[index].pending = 1;
+          pending_motions[nb_pending_motions++] = index;
+        }
+        motions[index].xrel += xrel;
+        motions[index].yrel += yrel;
       }
       break;
     case XI_RawButtonPress:
-      if(index >= 0)
+      if(index >= 0 && filter_pass(GE_MOUSEBUTTONDOWN, devices[index].id, get_button(revent->detail)))
       {
         evt.type = GE_MOUSEBUTTONDOWN;
         evt.button.which = devices[index].id;
@@ -108,7 +180,7 @@ static void xinput_process_event(XIRawEvent* revent)
       }
       break;
     case XI_RawButtonRelease:
-      if(index >= 0)
+      if(index >= 0 && filter_pass(GE_MOUSEBUTTONDOWN, devices[index].id, get_button(revent->detail)))
       {
         evt.type = GE_MOUSEBUTTONUP;
         evt.button.which = devices[index].id;
@@ -117,7 +189,7 @@ static void xinput_process_event(XIRawEvent* revent)
       break;
     case XI_RawKeyPress:
     {
-      if(index >= 0)
+      if(index >= 0 && filter_pass(GE_KEYDOWN, devices[index].id, revent->detail - 8))
       {
         evt.type = GE_KEYDOWN;
         evt.button.which = devices[index].id;
@@ -127,7 +199,7 @@ static void xinput_process_event(XIRawEvent* revent)
     }
     case XI_RawKeyRelease:
     {
-      if(index >= 0)
+      if(index >= 0 && filter_pass(GE_KEYDOWN, devices[index].id, revent->detail - 8))
       {
         evt.type = GE_KEYUP;
         evt.button.which = devices[index].id;
@@ -144,20 +216,29 @@ static void xinput_process_event(XIRawEvent* revent)
    */
   if(evt.type != GE_NOEVENT)
   {
+    if(evt.type == GE_MOUSEBUTTONDOWN || evt.type == GE_MOUSEBUTTONUP)
+    {
+      xinput_flush_motion(index, timestamp);
+    }
     event_callback(&evt);
   }
 }
 
+/*
+ * Process all the queued events.
+ * The connection is read (and flushed) a single time, and the events that were read are processed in a row.
+ * Events that arrive in the meantime make the connection readable again.
+ */
 static int xinput_process_events(int index)
 {
   XEvent ev;
   XGenericEventCookie *cookie = &ev.xcookie;
+  int queued;
 
-  while (XPending(dpy))
-  {
-    XFlush(dpy);
-    XPending(dpy);
+  uint64_t now = timer_now();
 
+  for (queued = XEventsQueued(dpy, QueuedAfterFlush); queued > 0; --queued)
+  {
     XNextEvent(dpy, &ev);
     if (XGetEventData(dpy, cookie))
     {
@@ -165,13 +246,15 @@ static int xinput_process_events(int index)
 
       if(cookie->type == GenericEvent && cookie->extension == xi_opcode)
       {
-        xinput_process_event(revent);
+        xinput_process_event(revent, now);
       }
 
       XFreeEventData(dpy, cookie);
     }
   }
 
+  xinput_flush_motions(now);
+
   return 0;
 }
 
@@ -216,6 +299,8 @@ int xinput_init()
 
   memset(devices, 0x00, sizeof(devices));
   nb_devices = 0;
+  memset(motions, 0x00, sizeof(motions));
+  nb_pending_motions = 0;
 
   int i;
   for(i=0; i<sizeof(device_index)/sizeof(*device_index); ++i)
@@ -277,7 +362,7 @@ int xinput_init()
 
   XIFreeDeviceInfo(xdevices);
 
-  ev_register_source(ConnectionNumber(dpy), i, &xinput_process_events, NULL, &xinput_close);
+  ev_register_input_source(ConnectionNumber(dpy), i, &xinput_process_events, &xinput_close);
 
   XEvent xevent;
 
@@ -4,80 +4,248 @@
  */
 
 #include <events.h>
+#include <queue.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static int debug = 0;
 
 #define eprintf(...) if(debug) printf(__VA_ARGS__)
 
-static GE_Event queue[MAX_EVENTS];
-static unsigned char queue_index_first = 0;
-static unsigned char queue_index_last = 0;
+#define CACHE_LINE_SIZE 64
+
+/*
+ * A bounded event queue, with a power-of-two capacity and a single consumer.
+ *
+ * Producers reserve slots by moving head (with a compare-and-swap if there are
+ * multiple producers), then publish each slot by setting its sequence number to
+ * its position + 1. The consumer only reads published slots, and frees them by
+ * moving tail. A slot is free if it is less than capacity positions ahead of tail.
+ *
+ * Events that don't fit are dropped, and counted.
+ */
+typedef struct
+{
+  unsigned int sequence;
+  GE_Event event;
+} s_queue_cell;
+
+static s_queue_cell default_cells[QUEUE_DEFAULT_CAPACITY];
+
+static struct
+{
+  struct
+  {
+    unsigned int head;
+    unsigned long long pushed;
+    unsigned long long dropped;
+    unsigned int high_water;
+  } producer __attribute__((aligned(CACHE_LINE_SIZE)));
+  struct
+  {
+    unsigned int tail;
+  } consumer __attribute__((aligned(CACHE_LINE_SIZE)));
+  unsigned int capacity;
+  unsigned int mask;
+  int multi_producer;
+  s_queue_cell* cells;
+} queue =
+{
+  .capacity = QUEUE_DEFAULT_CAPACITY,
+  .mask = QUEUE_DEFAULT_CAPACITY - 1,
+  .cells = default_cells,
+};
+
+static void queue_free()
+{
+  if(queue.cells != default_cells)
+  {
+    free(queue.cells);
+  }
+}
+
+/*
+ * Set the capacity of the queue (rounded up to a power of two),
+ * and allow pushing events from multiple threads.
+ * This has to be done before queue_init.
+ */
+int queue_configure(unsigned int capacity, int multi_producer)
+{
+  unsigned int size = 1;
+
+  if(!capacity || capacity > (1U << 24))
+  {
+    fprintf(stderr, "%s: invalid capacity: %u\n", __FUNCTION__, capacity);
+    return -1;
+  }
+
+  while(size < capacity)
+  {
+    size <<= 1;
+  }
+
+  s_queue_cell* cells = default_cells;
+
+  if(size > QUEUE_DEFAULT_CAPACITY)
+  {
+    cells = calloc(size, sizeof(*cells));
+    if(!cells)
+    {
+      fprintf(stderr, "%s: can't allocate %u events\n", __FUNCTION__, size);
+      return -1;
+    }
+  }
+
+  queue_free();
+
+  queue.cells = cells;
+  queue.capacity = size;
+  queue.mask = size - 1;
+  queue.multi_producer = multi_producer;
+
+  return 0;
+}
+
+/*
+ * Release the cells allocated by queue_configure, and restore the default capacity.
+ * No event has to be pushed after this call (the input thread has to be stopped).
+ */
+void queue_quit()
+{
+  queue_free();
+
+  queue.cells = default_cells;
+  queue.capacity = QUEUE_DEFAULT_CAPACITY;
+  queue.mask = QUEUE_DEFAULT_CAPACITY - 1;
+  queue.multi_producer = 0;
+}
 
 void queue_init()
 {
-  queue_index_first = 0;
-  queue_index_last = 0;
+  queue.producer.head = 0;
+  queue.producer.pushed = 0;
+  queue.producer.dropped = 0;
+  queue.producer.high_water = 0;
+  queue.consumer.tail = 0;
+  memset(queue.cells, 0x00, queue.capacity * sizeof(*queue.cells));
 }
 
-int queue_push_event(GE_Event* ev)
+/*
+ * Reserve up to count slots.
+ * Returns the number of reserved slots, and the position of the first one.
+ */
+static inline unsigned int reserve(unsigned int count, unsigned int* position)
 {
-  int ret = -1;
-  eprintf("first: %d last: %d\n", queue_index_first, queue_index_last);
-  if(queue_index_last >= queue_index_first)
+  unsigned int head = __atomic_load_n(&queue.producer.head, __ATOMIC_RELAXED);
+  unsigned int tail;
+  unsigned int available;
+
+  do
   {
-    queue[queue_index_last] = *ev;
-    queue_index_last++;
-    queue_index_last%=MAX_EVENTS;
-    if(queue_index_last == queue_index_first)
+    tail = __atomic_load_n(&queue.consumer.tail, __ATOMIC_ACQUIRE);
+    available = queue.capacity - (head - tail);
+    if(available < count)
+    {
+      count = available;
+    }
+    if(!count)
     {
-      queue_index_last = MAX_EVENTS-1;
+      break;
     }
-    else
+    if(!queue.multi_producer)
     {
-      ret = 0;
+      __atomic_store_n(&queue.producer.head, head + count, __ATOMIC_RELAXED);
+      break;
     }
   }
-  else if(queue_index_last+1 < queue_index_first)
+  while(!__atomic_compare_exchange_n(&queue.producer.head, &head, head + count, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  *position = head;
+
+  if(count)
   {
-    queue[queue_index_last] = *ev;
-    queue_index_last++;
-    ret = 0;
+    unsigned int level = head + count - tail;
+    unsigned int high_water = __atomic_load_n(&queue.producer.high_water, __ATOMIC_RELAXED);
+    while(level > high_water
+        && !__atomic_compare_exchange_n(&queue.producer.high_water, &high_water, level, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
   }
-  eprintf("ret: %d first: %d last: %d\n", ret, queue_index_first, queue_index_last);
-  return ret;
+
+  return count;
 }
 
-int queue_peep_events(GE_Event *events, int numevents)
+/*
+ * Push events.
+ * Returns the number of pushed events. The other ones are dropped.
+ */
+int queue_push_events(GE_Event* events, int numevents)
 {
-  int i;
-  int j = 0;
-  if(queue_index_first > queue_index_last)
+  unsigned int position;
+  unsigned int count;
+  unsigned int i;
+
+  if(numevents <= 0)
   {
-    for(i=queue_index_first; i<MAX_EVENTS; ++i)
-    {
-      eprintf("peep: %d\n", i);
-      events[j] = queue[i];
-      ++queue_index_first;
-      queue_index_first%=MAX_EVENTS;
-      ++j;
-      if(j == numevents)
-      {
-        return numevents;
-      }
-    }
+    return 0;
+  }
+
+  count = reserve(numevents, &position);
+
+  for(i = 0; i < count; ++i)
+  {
+    s_queue_cell* cell = queue.cells + ((position + i) & queue.mask);
+    cell->event = events[i];
+    __atomic_store_n(&cell->sequence, position + i + 1, __ATOMIC_RELEASE);
   }
-  for(i=queue_index_first; i<queue_index_last; ++i)
+
+  __atomic_add_fetch(&queue.producer.pushed, count, __ATOMIC_RELAXED);
+  if(count < (unsigned int)numevents)
   {
-    eprintf("peep: %d\n", i);
-    events[j] = queue[i];
-    ++queue_index_first;
-    queue_index_first%=MAX_EVENTS;
-    ++j;
-    if(j == numevents)
+    __atomic_add_fetch(&queue.producer.dropped, numevents - count, __ATOMIC_RELAXED);
+    eprintf("queue full: %u events dropped\n", numevents - count);
+  }
+
+  return count;
+}
+
+/*
+ * Push an event.
+ * Returns -1 if the queue is full, 0 otherwise.
+ */
+int queue_push_event(GE_Event* ev)
+{
+  return queue_push_events(ev, 1) ? 0 : -1;
+}
+
+/*
+ * Get the published events, in order.
+ * Returns the number of retrieved events.
+ */
+int queue_peep_events(GE_Event *events, int numevents)
+{
+  unsigned int tail = queue.consumer.tail;
+  int j;
+
+  for(j = 0; j < numevents; ++j)
+  {
+    s_queue_cell* cell = queue.cells + (tail & queue.mask);
+    if(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != tail + 1)
     {
-      return numevents;
+      break;
     }
+    events[j] = cell->event;
+    ++tail;
   }
+
+  __atomic_store_n(&queue.consumer.tail, tail, __ATOMIC_RELEASE);
+
   return j;
 }
+
+void queue_get_stats(GE_QueueStats* stats)
+{
+  stats->capacity = queue.capacity;
+  stats->high_water = __atomic_load_n(&queue.producer.high_water, __ATOMIC_RELAXED);
+  stats->pushed = __atomic_load_n(&queue.producer.pushed, __ATOMIC_RELAXED);
+  stats->dropped = __atomic_load_n(&queue.producer.dropped, __ATOMIC_RELAXED);
+}
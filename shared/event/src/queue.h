@@ -8,8 +8,14 @@
 
 #include <GE.h>
 
+#define QUEUE_DEFAULT_CAPACITY 256 //has to be a power of two
+
+int queue_configure(unsigned int capacity, int multi_producer);
 void queue_init();
+void queue_quit();
 int queue_push_event(GE_Event* ev);
+int queue_push_events(GE_Event* events, int numevents);
 int queue_peep_events(GE_Event *events, int numevents);
+void queue_get_stats(GE_QueueStats* stats);
 
 #endif
@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2016 Mathieu Laurendeau <mat.lau@laposte.net>
+ License: GPLv3
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <GE.h>
+
+/*
+ * A bounded single-producer/single-consumer event ring.
+ * The producer only writes head, the consumer only writes tail.
+ * Each index lives in its own cache line, along with a cached copy
+ * of the other index, so that the two threads don't share cache lines
+ * unless the ring looks full or empty.
+ */
+
+#define RING_SIZE 1024 //has to be a power of two
+#define RING_MASK (RING_SIZE - 1)
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct
+{
+  GE_Event event;
+  int deferred; //the event has to be queued (see GE_PushEvent) rather than processed
+} s_ring_entry;
+
+typedef struct
+{
+  struct
+  {
+    unsigned int head;
+    unsigned int tail; //cached copy
+    unsigned long long events;
+    unsigned long long overflows;
+  } producer __attribute__((aligned(CACHE_LINE_SIZE)));
+  struct
+  {
+    unsigned int tail;
+    unsigned int head; //cached copy
+  } consumer __attribute__((aligned(CACHE_LINE_SIZE)));
+  s_ring_entry entries[RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+} s_ring;
+
+/*
+ * Push an event. If the ring is full, the event is dropped and the overflow count is incremented.
+ * Returns -1 if the ring is full, 0 otherwise.
+ */
+static inline int ring_push(s_ring* ring, GE_Event* event, int deferred)
+{
+  unsigned int head = ring->producer.head;
+
+  if(head - ring->producer.tail == RING_SIZE)
+  {
+    ring->producer.tail = __atomic_load_n(&ring->consumer.tail, __ATOMIC_ACQUIRE);
+    if(head - ring->producer.tail == RING_SIZE)
+    {
+      __atomic_store_n(&ring->producer.overflows, ring->producer.overflows + 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+  }
+
+  s_ring_entry* entry = ring->entries + (head & RING_MASK);
+  entry->event = *event;
+  entry->deferred = deferred;
+
+  __atomic_store_n(&ring->producer.head, head + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->producer.events, ring->producer.events + 1, __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+/*
+ * Pop an event.
+ * Returns 0 if the ring is empty, 1 otherwise.
+ */
+static inline int ring_pop(s_ring* ring, s_ring_entry* entry)
+{
+  unsigned int tail = ring->consumer.tail;
+
+  if(tail == ring->consumer.head)
+  {
+    ring->consumer.head = __atomic_load_n(&ring->producer.head, __ATOMIC_ACQUIRE);
+    if(tail == ring->consumer.head)
+    {
+      return 0;
+    }
+  }
+
+  *entry = ring->entries[tail & RING_MASK];
+
+  __atomic_store_n(&ring->consumer.tail, tail + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+#endif /* RING_H_ */
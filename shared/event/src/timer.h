@@ -14,14 +14,20 @@
 #endif
 
 
+#include <stdint.h>
+#include <GE.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+uint64_t timer_now();
 inline TIMER timer_get();
 TIMER timer_start(int usec);
 int timer_close(int unused);
 int timer_read(int unused);
+int timer_get_stats(GE_TimerStats* stats);
+int timer_set_offset(int usec);
 
 #ifdef __cplusplus
 }
@@ -7,9 +7,26 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <GE.h>
 
 static HANDLE hTimer = NULL;
 
+/*
+ * Get the current time of the performance counter, in nanoseconds.
+ */
+uint64_t timer_now()
+{
+  static LARGE_INTEGER freq = { .QuadPart = 0 };
+  LARGE_INTEGER now;
+  if(!freq.QuadPart)
+  {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&now);
+  return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000
+      + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+}
+
 inline HANDLE timer_get()
 {
   return hTimer;
@@ -58,3 +75,19 @@ int timer_read(int unused)
 {
   return 1;
 }
+
+/*
+ * Not implemented.
+ */
+int timer_set_offset(int usec)
+{
+  return -1;
+}
+
+/*
+ * Waitable timers do not report missed periods.
+ */
+int timer_get_stats(GE_TimerStats* stats)
+{
+  return -1;
+}